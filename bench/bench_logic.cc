@@ -0,0 +1,445 @@
+#include "bench_logic.hh"
+
+#include <logic/eval.hh>
+#include <logic/native_rule.hh>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/optional.hpp>
+#include <boost/program_options.hpp>
+
+using namespace hyper::logic;
+
+namespace hyper {
+	namespace {
+		/* 
+		 * native matcher for rule pred_transitivity, as generated by
+		 * hyperc --native-rules
+		 */
+		void transitivity_matcher(const logic::rule& r, const logic::facts& fs,
+				const logic::facts::delta_type* delta, size_t delta_cond,
+				std::vector<logic::substitution>& res)
+		{
+			assert(r.symbols.size() == 3);
+			switch (delta ? delta_cond : 0) {
+				case 0: {
+					logic::native::candidates c0(fs, delta, delta_cond, 0, r.condition[0].id);
+					const logic::function_call* f0;
+					while (c0.next(f0)) {
+						const logic::expression& v0 = f0->args[0];
+						const logic::expression& v1 = f0->args[1];
+						logic::native::candidates c1(fs, delta, delta_cond, 1, r.condition[1].id, 0, v1);
+						const logic::function_call* f1;
+						while (c1.next(f1)) {
+							if (!logic::native::same(f1->args[0], v1)) continue;
+							const logic::expression& v2 = f1->args[1];
+							logic::substitution s(3);
+							s[0] = v0;
+							s[1] = v1;
+							s[2] = v2;
+							res.push_back(s);
+						}
+					}
+					break;
+				}
+				case 1: {
+					logic::native::candidates c1(fs, delta, delta_cond, 1, r.condition[1].id);
+					const logic::function_call* f1;
+					while (c1.next(f1)) {
+						const logic::expression& v1 = f1->args[0];
+						const logic::expression& v2 = f1->args[1];
+						logic::native::candidates c0(fs, delta, delta_cond, 0, r.condition[0].id, 1, v1);
+						const logic::function_call* f0;
+						while (c0.next(f0)) {
+							const logic::expression& v0 = f0->args[0];
+							if (!logic::native::same(f0->args[1], v1)) continue;
+							logic::substitution s(3);
+							s[0] = v0;
+							s[1] = v1;
+							s[2] = v2;
+							res.push_back(s);
+						}
+					}
+					break;
+				}
+			}
+		}
+	}
+}
+
+namespace {
+	/*
+	 * Build a synthetic ability with nb_types types, and nb_preds
+	 * predicates for each type. Each predicate p has a rule of depth
+	 * rule_depth :
+	 *   p(X0, X1), p(X1, X2), ..., p(Xn-1, Xn) |- p(X0, Xn)
+	 * (for a depth of 2, it is the transitivity), and an inconsistency
+	 * rule p(A, A) |- . Each predicate is then fed with a chain of nb_facts
+	 * facts p(obj0, obj1), p(obj1, obj2), ...
+	 */
+	struct synthetic_ability {
+		size_t nb_types;
+		size_t nb_preds;
+		size_t nb_facts;
+		size_t rule_depth;
+
+		synthetic_ability(size_t nb_types, size_t nb_preds, size_t nb_facts, size_t rule_depth) :
+			nb_types(nb_types), nb_preds(nb_preds), nb_facts(nb_facts), rule_depth(rule_depth) {}
+
+		std::string name() const
+		{
+			std::ostringstream oss;
+			oss << "synthetic:t" << nb_types << ":p" << nb_preds;
+			oss << ":f" << nb_facts << ":d" << rule_depth;
+			return oss.str();
+		}
+
+		std::string type(size_t t) const
+		{
+			std::ostringstream oss;
+			oss << "type" << t;
+			return oss.str();
+		}
+
+		std::string pred(size_t t, size_t i) const
+		{
+			std::ostringstream oss;
+			oss << "pred" << t << "_" << i;
+			return oss.str();
+		}
+
+		std::string object(size_t t, size_t j) const
+		{
+			std::ostringstream oss;
+			oss << "obj" << t << "_" << j;
+			return oss.str();
+		}
+
+		std::string fact(size_t t, size_t i, size_t j) const
+		{
+			return pred(t, i) + "(" + object(t, j) + ", " + object(t, j + 1) + ")";
+		}
+
+		std::string var(size_t k) const
+		{
+			std::ostringstream oss;
+			oss << "X" << k;
+			return oss.str();
+		}
+
+		function_call pattern(engine& e, const std::string& p, const std::string& x, 
+							  const std::string& y) const
+		{
+			generate_return r = generate(p + "(" + x + ", " + y + ")", e.funcs());
+			assert(r.res);
+			return r.e;
+		}
+
+		void declare(engine& e) const
+		{
+			for (size_t t = 0; t < nb_types; ++t) {
+				e.add_type(type(t));
+				for (size_t i = 0; i < nb_preds; ++i)
+					e.add_predicate(pred(t, i), 2, 
+									boost::assign::list_of(type(t))(type(t)));
+			}
+		}
+
+		/*
+		 * The native matcher is only available for the transitivity, so
+		 * for a rule depth of 2. If c is not null, it measures each call to
+		 * add_rule.
+		 */
+		void add_rules(engine& e, bool native, hyper::bench::chrono* c = 0) const
+		{
+			hyper::bench::chrono ignored;
+			if (!c)
+				c = &ignored;
+
+			for (size_t t = 0; t < nb_types; ++t)
+				for (size_t i = 0; i < nb_preds; ++i) {
+					const std::string p = pred(t, i);
+					c->start();
+					if (native) {
+						assert(rule_depth == 2);
+						e.add_rule(p + "_transitivity",
+								boost::assign::list_of(pattern(e, p, "X", "Y"))(pattern(e, p, "Y", "Z")),
+								boost::assign::list_of(pattern(e, p, "X", "Z")),
+								&hyper::transitivity_matcher);
+					} else {
+						std::vector<std::string> cond;
+						for (size_t k = 0; k < rule_depth; ++k)
+							cond.push_back(p + "(" + var(k) + ", " + var(k + 1) + ")");
+						e.add_rule<std::string>(p + "_chain", cond,
+								boost::assign::list_of<std::string>(p + "(X0, " + var(rule_depth) + ")"));
+					}
+					c->stop();
+
+					c->start();
+					e.add_rule<std::string>(p + "_false", 
+							boost::assign::list_of<std::string>(p + "(A, A)"),
+							std::vector<std::string>());
+					c->stop();
+				}
+		}
+
+		void add_facts(engine& e) const
+		{
+			for (size_t j = 0; j < nb_facts; ++j)
+				for (size_t t = 0; t < nb_types; ++t)
+					for (size_t i = 0; i < nb_preds; ++i)
+						e.add_fact(fact(t, i, j));
+		}
+
+		/*
+		 * The rule of depth n derives the paths whose length is 1 modulo
+		 * n - 1. Returns the farthest object reachable from obj0.
+		 */
+		size_t farthest() const
+		{
+			size_t step = rule_depth - 1;
+			return 1 + ((nb_facts - 1) / step) * step;
+		}
+
+		std::string goal(size_t t, size_t i) const
+		{
+			return pred(t, i) + "(" + object(t, 0) + ", " + object(t, farthest()) + ")";
+		}
+
+		/* A goal which can't be proved, but is not inconsistent */
+		std::string unknown_goal(size_t t, size_t i) const
+		{
+			return pred(t, i) + "(" + object(t, farthest()) + ", " + object(t, 0) + ")";
+		}
+
+		void record(hyper::bench::measureV& res, const std::string& strategy,
+					const std::string& operation, const hyper::bench::chrono& c) const
+		{
+			hyper::bench::measure m;
+			m.workload = name();
+			m.strategy = strategy;
+			m.operation = operation;
+			m.count = c.count();
+			m.seconds = c.seconds();
+			res.push_back(m);
+		}
+
+		/* 
+		 * Measure add_fact, infer, infer with hypothesis, is_consistent and
+		 * add_rule. Returns the number of goals checked, and the facts
+		 * derived once all the facts are added in closure. Both must be the
+		 * same for all the strategies.
+		 */
+		size_t run(chaining_strategy s, bool native, size_t nb_runs, 
+				   hyper::bench::measureV& res, std::vector<function_call>& closure) const
+		{
+			std::string strategy = hyper::bench::strategy_name(s);
+			if (native)
+				strategy += "+native";
+
+			hyper::bench::chrono c_fact, c_infer, c_infer_hyps, c_consistent, c_rule;
+			size_t checked = 0;
+
+			engine e;
+			e.set_chaining_strategy(s);
+			declare(e);
+			add_rules(e, native);
+
+			for (size_t j = 0; j < nb_facts; ++j)
+				for (size_t t = 0; t < nb_types; ++t)
+					for (size_t i = 0; i < nb_preds; ++i) {
+						c_fact.start();
+						e.add_fact(fact(t, i, j));
+						c_fact.stop();
+					}
+
+			closure = e.known_facts();
+
+			for (size_t k = 0; k < nb_runs; ++k)
+				for (size_t t = 0; t < nb_types; ++t)
+					for (size_t i = 0; i < nb_preds; ++i) {
+						c_infer.start();
+						boost::logic::tribool b = e.infer(goal(t, i));
+						c_infer.stop();
+						if (k == 0 && !boost::logic::indeterminate(b) && b)
+							checked++;
+
+						std::vector<function_call> hyps;
+						c_infer_hyps.start();
+						e.infer(unknown_goal(t, i), hyps);
+						c_infer_hyps.stop();
+					}
+
+			for (size_t k = 0; k < nb_runs; ++k) {
+				c_consistent.start();
+				bool consistent = e.is_consistent();
+				c_consistent.stop();
+				if (!consistent)
+					checked = 0;
+			}
+
+			/* add_rule, on an engine which already knows the facts */
+			engine e2;
+			e2.set_chaining_strategy(s);
+			declare(e2);
+			add_facts(e2);
+			add_rules(e2, native, &c_rule);
+			boost::logic::tribool b = e2.infer(goal(0, 0));
+			if (boost::logic::indeterminate(b) || !b)
+				checked = 0;
+
+			record(res, strategy, "add_fact", c_fact);
+			record(res, strategy, "infer", c_infer);
+			record(res, strategy, "infer_hyps", c_infer_hyps);
+			record(res, strategy, "is_consistent", c_consistent);
+			record(res, strategy, "add_rule", c_rule);
+
+			return checked;
+		}
+	};
+}
+
+namespace hyper {
+	namespace bench {
+		void dump_csv(std::ostream& oss, const measureV& v)
+		{
+			oss << "workload,strategy,operation,count,seconds,us_per_op" << std::endl;
+			for (size_t i = 0; i < v.size(); ++i) {
+				oss << v[i].workload << "," << v[i].strategy << ",";
+				oss << v[i].operation << "," << v[i].count << "," << v[i].seconds << ",";
+				if (v[i].count)
+					oss << v[i].seconds * 1e6 / v[i].count;
+				else
+					oss << 0;
+				oss << std::endl;
+			}
+		}
+
+		chaining_strategy parse_strategy(const std::string& s)
+		{
+			if (s == "naive")
+				return naive_chaining;
+			if (s == "rete")
+				return rete_chaining;
+			return semi_naive_chaining;
+		}
+
+		std::string strategy_name(chaining_strategy s)
+		{
+			switch (s) {
+				case naive_chaining:
+					return "naive";
+				case semi_naive_chaining:
+					return "semi-naive";
+				case rete_chaining:
+					return "rete";
+			}
+			return "unknown";
+		}
+	}
+}
+
+namespace po = boost::program_options;
+
+void
+usage(const po::options_description& desc)
+{
+	std::cout << "Usage: bench_logic [options]\n";
+	std::cout << desc;
+}
+
+int main(int argc, char** argv)
+{
+	try {
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help,h", "produce help message")
+		("types,t", po::value<size_t>()->default_value(1), "number of types")
+		("preds,p", po::value<size_t>()->default_value(10), "number of predicates per type")
+		("facts,f", po::value<size_t>()->default_value(10), "number of facts per predicate")
+		("depth,d", po::value<size_t>()->default_value(2), "number of conditions of the rules")
+		("runs,r", po::value<size_t>()->default_value(10), "number of runs of the queries")
+		("strategy,s", po::value<std::vector<std::string> >(), 
+		 "chaining strategy (naive, semi-naive, rete, native), all by default")
+		("replay", po::value<std::vector<std::string> >(), 
+		 "replay the trace of an engine (see logic::engine::set_trace)")
+		("no-synthetic", "only run the replayed workloads")
+		;
+
+	po::variables_map vm;
+	po::store(po::parse_command_line(argc, argv, desc), vm);
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		usage(desc);
+		return 0;
+	}
+
+	std::vector<std::string> strategies;
+	if (vm.count("strategy"))
+		strategies = vm["strategy"].as<std::vector<std::string> >();
+	else
+		strategies = boost::assign::list_of<std::string>("naive")("semi-naive")("rete")("native");
+
+	for (size_t i = 0; i < strategies.size(); ++i) {
+		if (strategies[i] != "naive" && strategies[i] != "semi-naive" &&
+			strategies[i] != "rete" && strategies[i] != "native") {
+			std::cerr << "Unknown strategy " << strategies[i] << std::endl;
+			usage(desc);
+			return -1;
+		}
+	}
+
+	synthetic_ability ability(vm["types"].as<size_t>(), vm["preds"].as<size_t>(),
+							  vm["facts"].as<size_t>(), vm["depth"].as<size_t>());
+	if (ability.nb_types == 0 || ability.nb_preds == 0 || ability.nb_facts == 0 ||
+		ability.rule_depth < 2) {
+		std::cerr << "types, preds and facts must be positive, and depth at least 2" << std::endl;
+		return -1;
+	}
+
+	hyper::bench::measureV res;
+	bool consistent = true;
+
+	if (!vm.count("no-synthetic")) {
+		size_t expected = ability.nb_types * ability.nb_preds;
+		boost::optional<std::vector<function_call> > expected_closure;
+		for (size_t i = 0; i < strategies.size(); ++i) {
+			bool native = (strategies[i] == "native");
+			if (native && ability.rule_depth != 2)
+				continue;
+
+			chaining_strategy s = hyper::bench::parse_strategy(native ? "semi-naive" : strategies[i]);
+			std::vector<function_call> closure;
+			size_t checked = ability.run(s, native, vm["runs"].as<size_t>(), res, closure);
+			if (!expected_closure)
+				expected_closure = closure;
+			if (checked != expected || closure != *expected_closure) {
+				std::cerr << "Inconsistent closure for strategy " << strategies[i] << std::endl;
+				consistent = false;
+			}
+		}
+	}
+
+	if (vm.count("replay")) {
+		std::vector<std::string> files = vm["replay"].as<std::vector<std::string> >();
+		for (size_t i = 0; i < files.size(); ++i)
+			for (size_t j = 0; j < strategies.size(); ++j) {
+				if (strategies[j] == "native")
+					continue;
+				if (!hyper::bench::replay(files[i], hyper::bench::parse_strategy(strategies[j]), res))
+					return -1;
+			}
+	}
+
+	hyper::bench::dump_csv(std::cout, res);
+
+	return consistent ? 0 : -1;
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -1;
+	}
+}
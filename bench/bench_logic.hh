@@ -0,0 +1,69 @@
+#ifndef _HYPER_BENCH_LOGIC_HH_
+#define _HYPER_BENCH_LOGIC_HH_
+
+#include <logic/engine.hh>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace hyper {
+	namespace bench {
+
+		/* One line of the report : the time spent in count calls of operation */
+		struct measure {
+			std::string workload;
+			std::string strategy;
+			std::string operation;
+			size_t count;
+			double seconds;
+		};
+
+		typedef std::vector<measure> measureV;
+
+		/*
+		 * Accumulate the time spent in one kind of operation. The clock is
+		 * the one already used by the runtime (boost::posix_time).
+		 */
+		class chrono {
+			private:
+				boost::posix_time::ptime start_;
+				boost::posix_time::time_duration total_;
+				size_t count_;
+
+			public:
+				chrono() : total_(boost::posix_time::microseconds(0)), count_(0) {}
+
+				void start() { start_ = boost::posix_time::microsec_clock::local_time(); }
+				void stop()
+				{
+					total_ += boost::posix_time::microsec_clock::local_time() - start_;
+					count_++;
+				}
+
+				size_t count() const { return count_; }
+				double seconds() const { return total_.total_microseconds() / 1e6; }
+		};
+
+		/*
+		 * Output the measures as CSV, one line per measure, with a header,
+		 * so that the results of different releases can be compared by
+		 * scripts
+		 */
+		void dump_csv(std::ostream& oss, const measureV& v);
+
+		logic::chaining_strategy parse_strategy(const std::string& s);
+		std::string strategy_name(logic::chaining_strategy s);
+
+		/*
+		 * Replay the trace of an engine (see logic::engine::set_trace) in a
+		 * new engine using strategy s, and append the time spent in each
+		 * kind of call to res. Returns false if the trace can't be parsed.
+		 */
+		bool replay(const std::string& file, logic::chaining_strategy s, measureV& res);
+	}
+}
+
+#endif /* _HYPER_BENCH_LOGIC_HH_ */
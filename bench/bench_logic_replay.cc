@@ -0,0 +1,253 @@
+#include "bench_logic.hh"
+
+#include <logic/eval.hh>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/variant/apply_visitor.hpp>
+
+using namespace hyper::logic;
+
+namespace {
+
+	/*
+	 * The trace does not contain the evaluation functions of the
+	 * predicates. Restore the ones of the comparison predicates declared
+	 * by the model layer for each comparable type (less_${type}, ...), so
+	 * the replay checks the same inconsistencies than the real ability.
+	 */
+	struct op_less { template <typename T> bool operator() (const T& a, const T& b) const { return a < b; } };
+	struct op_less_equal { template <typename T> bool operator() (const T& a, const T& b) const { return a <= b; } };
+	struct op_greater { template <typename T> bool operator() (const T& a, const T& b) const { return a > b; } };
+	struct op_greater_equal { template <typename T> bool operator() (const T& a, const T& b) const { return a >= b; } };
+	struct op_not_equal { template <typename T> bool operator() (const T& a, const T& b) const { return a != b; } };
+
+	template <typename Op>
+	struct compare_constant : public boost::static_visitor<tribool>
+	{
+		template <typename T, typename U>
+		tribool operator() (const T&, const U&) const { return indeterminate; }
+
+		template <typename U>
+		tribool operator() (const Constant<U>& u, const Constant<U>& v) const
+		{
+			return Op()(u.value, v.value);
+		}
+	};
+
+	template <typename Op>
+	struct compare
+	{
+		tribool operator() (const expression& e1, const expression& e2) const
+		{
+			return boost::apply_visitor(compare_constant<Op>(), e1.expr, e2.expr);
+		}
+	};
+
+	eval_predicate* builtin_eval(const std::string& name, size_t arity)
+	{
+		if (arity != 2)
+			return 0;
+
+		/* the longest prefixes first */
+		if (boost::starts_with(name, "less_equal_"))
+			return new eval<compare<op_less_equal>, 2>();
+		if (boost::starts_with(name, "greater_equal_"))
+			return new eval<compare<op_greater_equal>, 2>();
+		if (boost::starts_with(name, "less_"))
+			return new eval<compare<op_less>, 2>();
+		if (boost::starts_with(name, "greater_"))
+			return new eval<compare<op_greater>, 2>();
+		if (boost::starts_with(name, "not_equal_"))
+			return new eval<compare<op_not_equal>, 2>();
+		return 0;
+	}
+
+	/* Split s on the separator sep, and trim each part */
+	std::vector<std::string> split(const std::string& s, const std::string& sep)
+	{
+		std::vector<std::string> res;
+		std::string::size_type begin = 0, end;
+		do {
+			end = s.find(sep, begin);
+			res.push_back(boost::trim_copy(s.substr(begin, end - begin)));
+			begin = end + sep.size();
+		} while (end != std::string::npos);
+
+		return res;
+	}
+
+	struct replayer {
+		engine& e;
+		std::map<std::string, hyper::bench::chrono> chronos;
+
+		replayer(engine& e) : e(e) {}
+
+		bool declare(const std::string& kind, std::istringstream& iss)
+		{
+			std::string name;
+			size_t arity;
+			std::vector<std::string> types;
+			if (!(iss >> name >> arity))
+				return false;
+			std::string type;
+			while (iss >> type)
+				types.push_back(type);
+
+			hyper::bench::chrono& c = chronos["declare"];
+			c.start();
+			if (kind == "predicate")
+				e.add_predicate(name, arity, types, builtin_eval(name, arity));
+			else
+				e.add_func(name, arity, types);
+			c.stop();
+			return true;
+		}
+
+		bool rule(const std::vector<std::string>& parts)
+		{
+			if (parts.size() != 3)
+				return false;
+
+			std::vector<std::string> cond = split(parts[1], ";");
+			std::vector<std::string> action;
+			if (!parts[2].empty())
+				action = split(parts[2], ";");
+
+			hyper::bench::chrono& c = chronos["add_rule"];
+			c.start();
+			e.add_rule<std::string>(parts[0].substr(parts[0].find(' ') + 1), cond, action);
+			c.stop();
+			return true;
+		}
+
+		bool query(const std::string& kind, const std::vector<std::string>& parts)
+		{
+			if (parts.size() != 2)
+				return false;
+			std::string identifier = parts[0].substr(parts[0].find(' ') + 1);
+
+			if (kind == "fact") {
+				std::vector<std::string> facts = split(parts[1], ";");
+				hyper::bench::chrono& c = chronos["add_fact"];
+				c.start();
+				if (facts.size() == 1)
+					e.add_fact(facts[0], identifier);
+				else
+					e.add_fact(facts, identifier);
+				c.stop();
+				return true;
+			}
+
+			if (kind == "retract") {
+				hyper::bench::chrono& c = chronos["retract_fact"];
+				c.start();
+				e.retract_fact(parts[1], identifier);
+				c.stop();
+				return true;
+			}
+
+			if (kind == "infer") {
+				hyper::bench::chrono& c = chronos["infer"];
+				c.start();
+				e.infer(parts[1], identifier);
+				c.stop();
+				return true;
+			}
+
+			if (kind == "infer_hyps") {
+				std::vector<function_call> hyps;
+				hyper::bench::chrono& c = chronos["infer_hyps"];
+				c.start();
+				e.infer(parts[1], hyps, identifier);
+				c.stop();
+				return true;
+			}
+
+			return false;
+		}
+
+		bool operator() (const std::string& line)
+		{
+			std::istringstream iss(line);
+			std::string kind;
+			iss >> kind;
+
+			if (kind == "type") {
+				std::string name;
+				iss >> name;
+				hyper::bench::chrono& c = chronos["declare"];
+				c.start();
+				e.add_type(name);
+				c.stop();
+				return true;
+			}
+
+			if (kind == "predicate" || kind == "func")
+				return declare(kind, iss);
+
+			std::vector<std::string> parts = split(line, "|");
+			if (kind == "rule")
+				return rule(parts);
+
+			if (kind == "base" && parts.size() == 2) {
+				hyper::bench::chrono& c = chronos["add_base_fact"];
+				c.start();
+				e.add_base_fact(parts[1]);
+				c.stop();
+				return true;
+			}
+
+			return query(kind, parts);
+		}
+	};
+}
+
+namespace hyper {
+	namespace bench {
+		bool replay(const std::string& file, chaining_strategy s, measureV& res)
+		{
+			std::ifstream ifs(file.c_str());
+			if (!ifs) {
+				std::cerr << "Can't open " << file << std::endl;
+				return false;
+			}
+
+			engine e;
+			e.set_chaining_strategy(s);
+			replayer r(e);
+
+			std::string line;
+			size_t line_number = 0;
+			while (std::getline(ifs, line)) {
+				line_number++;
+				boost::trim(line);
+				if (line.empty() || line[0] == '#')
+					continue;
+				if (!r(line)) {
+					std::cerr << file << ":" << line_number << ": can't parse " << line << std::endl;
+					return false;
+				}
+			}
+
+			std::string workload = "replay:" + boost::filesystem::path(file).filename().string();
+			std::map<std::string, chrono>::const_iterator it;
+			for (it = r.chronos.begin(); it != r.chronos.end(); ++it) {
+				measure m;
+				m.workload = workload;
+				m.strategy = strategy_name(s);
+				m.operation = it->first;
+				m.count = it->second.count();
+				m.seconds = it->second.seconds();
+				res.push_back(m);
+			}
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef HYPER_COMPILER_NATIVE_RULE_OUTPUT_HH_
+#define HYPER_COMPILER_NATIVE_RULE_OUTPUT_HH_
+
+#include <iostream>
+#include <string>
+
+namespace hyper {
+	namespace compiler {
+		struct rule_decl;
+
+		/*
+		 * A native matcher can only be generated if the rule has some
+		 * premises, and if each argument of each premise is a variable or
+		 * a constant. Otherwise, the rule is left to the interpreter.
+		 */
+		bool has_native_matcher(const rule_decl& r);
+
+		/*
+		 * Output the definition of the function name, which is a native
+		 * matcher (see logic::rule::matcher_type) for the rule r
+		 */
+		void dump_native_matcher(std::ostream& oss, const rule_decl& r,
+								 const std::string& name);
+	}
+}
+
+#endif /* HYPER_COMPILER_NATIVE_RULE_OUTPUT_HH_ */
@@ -88,7 +88,12 @@ namespace hyper {
 				size_t dump_ability_functions_impl(const std::string& directoryName, 
 												   const std::string& name) const;
 				void dump_ability_import_module_def(std::ostream& oss, const std::string& name) const;
-				void dump_ability_import_module_impl(std::ostream& oss, const std::string& name) const;
+				/* 
+				 * If native_rules is true, generate a native matcher for
+				 * each rule which supports it (@see has_native_matcher)
+				 */
+				void dump_ability_import_module_impl(std::ostream& oss, const std::string& name,
+													 bool native_rules = false) const;
 				void dump_ability(std::ostream& oss, const std::string& name) const;
 
 				void generate_additional_files_for_extension(const std::string& path, 
@@ -12,4 +12,13 @@
 #define HYPER_SERIALIZATION BINARY_ARCHIVE
 #endif
 
+/* 
+ * If set, the facts and the logic variables of the logic engine are
+ * stored in hash based containers instead of ordered ones. Set it with
+ * the cmake option HYPER_LOGIC_HASH.
+ */
+#ifndef HYPER_LOGIC_HASH
+#define HYPER_LOGIC_HASH 0
+#endif
+
 #endif /* HYPER_CONFIG_HH_ */
@@ -73,6 +73,38 @@ namespace hyper {
 					facts_ctx& ctx;
 					const rules& rs;
 
+					const infer_budget& budget;
+					const congruenceM& congruence;
+					size_t nb_nodes;
+					bool exhausted;
+
+					/* 
+					 * A copy of ctx, sharing its facts (see facts::shared_factsV),
+					 * where compute_node_state checks the consistency of
+					 * the hypothesis in a transaction, so that ctx is never
+					 * modified by the inference. Created on the first use.
+					 */
+					boost::shared_ptr<facts_ctx> scratch;
+					facts_ctx& scratch_ctx();
+
+					/*
+					 * The facts of each predicate with a congruence, as
+					 * given by facts::generate_all, so that the congruence
+					 * of each goal does not generate them again. ctx is not
+					 * modified by the inference, so they are computed once
+					 * per proof_tree, on the first use.
+					 */
+					typedef std::map<functionId, std::vector<function_call> > known_factsM;
+					known_factsM known_facts_;
+					const std::vector<function_call>& known_facts(functionId id);
+
+					/* 
+					 * Count a new node, returns false if the budget does not
+					 * allow it. Once the budget is exhausted, the hypothesis
+					 * are not explored anymore.
+					 */
+					bool new_node();
+
 					void update_hypothesis(hypothesis_id id, const hypothesis& h);
 
 					node_id insert_node(const node& n);
@@ -91,6 +123,14 @@ namespace hyper {
 
 					void compute_node_state(node& n);
 
+					/*
+					 * Returns true if f is already known to make a node
+					 * proven_false (see compute_node_state), without
+					 * checking the consistency of the world. Used to prune
+					 * the candidates of generate_node.
+					 */
+					bool is_refuted(const function_call& f);
+
 					node& get_node(node_id);
 					void try_solve_node(node & n);
 					void explore_hypothesis(hypothesis_id);
@@ -100,8 +140,10 @@ namespace hyper {
 					friend struct explore_node;
 
 				public:
-					proof_tree(facts_ctx& ctx, const rules& rs) : 
-						node_id_generator(0), hyp_id_generator(0), ctx(ctx), rs(rs) 
+					proof_tree(facts_ctx& ctx, const rules& rs, const infer_budget& budget,
+							   const congruenceM& congruence) : 
+						node_id_generator(0), hyp_id_generator(0), ctx(ctx), rs(rs),
+						budget(budget), congruence(congruence), nb_nodes(0), exhausted(false)
 					{}
 
 					boost::logic::tribool compute(const function_call& f);
@@ -125,9 +167,13 @@ namespace hyper {
 		struct backward_chaining {
 			const rules& rs;
 			facts_ctx& ctx;
+			infer_budget budget;
+			congruenceM congruence;
 
-			backward_chaining(const rules& rs, facts_ctx& ctx):
-				rs(rs), ctx(ctx)
+			backward_chaining(const rules& rs, facts_ctx& ctx, 
+							  const infer_budget& budget = infer_budget(),
+							  const congruenceM& congruence = congruenceM()):
+				rs(rs), ctx(ctx), budget(budget), congruence(congruence)
 			{}
 
 			/* Check if f is directly inferable from the facts and the rules */
@@ -2,14 +2,23 @@
 #ifndef _LOGIC_ENGINE_HH_
 #define _LOGIC_ENGINE_HH_
 
+#include <algorithm>
 #include <map>
+#include <ostream>
+#include <set>
 
 #include <logic/facts.hh>
 #include <logic/logic_var.hh>
+#include <logic/rete.hh>
 #include <logic/rules.hh>
 
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
 #include <boost/logic/tribool.hpp>
+#include <boost/optional/optional.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace hyper {
 	namespace logic {
@@ -17,13 +26,60 @@ namespace hyper {
 		struct facts_ctx {
 			private:
 				bool ctx_rules_update;
+				bool saved_rules_update;
+
+				/*
+				 * Each modification of the facts or of the rules gives a new
+				 * version to the context. Versions are never reused, even
+				 * after a rollback.
+				 */
+				size_t version_;
+				size_t saved_version_;
+				size_t last_version_;
+
+				void new_version() { version_ = ++last_version_; }
+
+				/*
+				 * Tabling of the backward chaining : the subgoals already
+				 * proved or refuted, valid for table_version_ only.
+				 */
+				typedef std::map<function_call, bool> tableM;
+				tableM table_;
+				size_t table_version_;
+
+				/* 
+				 * The facts asserted by add, by number (see
+				 * facts::support_type), so they can be retracted
+				 */
+				const funcDefList& funcs_;
+				typedef std::map<size_t, function_call> assertionM;
+				assertionM assertions_;
+				size_t next_assertion_;
+				size_t saved_next_assertion_;
+
+				/* number of rules used by the last compute_possible_expression */
+				size_t possible_rules_;
+				size_t saved_possible_rules_;
+
+				bool add_(const function_call& fact) {
+					size_t n = next_assertion_++;
+					assertions_[n] = fact;
+					bool res = f.add(fact, facts::support_type(1, n));
+					ctx_rules_update = false;
+					new_version();
+					return res;
+				}
 
 			public:
 				facts f;
 
+				/* partial matches of the engine rete_network, see rete_chaining */
+				rete_memory rete;
+
 				typedef std::set<expression> expressionS;
-				typedef std::map<std::string, expressionS> expressionM;
-				typedef std::map<rule::identifier_type, expressionM> expressionMM;
+				typedef std::map<std::string, boost::shared_ptr<const expressionS> > expressionM;
+				typedef std::map<rule::identifier_type, boost::shared_ptr<const expressionM> > 
+					expressionMM;
 
 				/**
 				 * For each rule (indexed by rules::identifier_type), associate the
@@ -33,47 +89,174 @@ namespace hyper {
 				 */
 
 				/*
-				 * XXX
-				 * You must be really careful when manipulating this stuff.
-				 * In the current situation, it is modified once, in
-				 * compute_possible_expression, but copied a lot in
-				 * proof_tree::compute_node_state(), without any change on it.
-				 * Considering this situation, it is correct to share
-				 * symbol_to_possible_expression between the difference
-				 * instances. But it may be incorrect if the implementation
-				 * changes. In this case, we need to deal more smartly with
-				 * this data structure, using some kind of 'persistant
-				 * structure', using shared_ptr in the data structure, and
-				 * replacing only part of the changed structure.
-				 */
-				boost::shared_ptr<expressionMM> symbol_to_possible_expression;
-
-				facts_ctx(const funcDefList& fun) : ctx_rules_update(false), f(fun),
+				 * The map may be shared between copies of the facts_ctx. So
+				 * it is never modified in place : compute_possible_expression
+				 * builds a new map and replaces the pointer. It makes it safe
+				 * to work concurrently on different facts_ctx.
+				 *
+				 * The sets of expressions are shared in the same way, so
+				 * that compute_possible_expression only copies the sets
+				 * touched by the sub-expressions added since its last call
+				 * (see facts::take_sub_delta). The whole map is only
+				 * recomputed when rules have been added, or when the
+				 * sub-expressions have been rewritten.
+				 */
+				boost::shared_ptr<const expressionMM> symbol_to_possible_expression;
+
+			private:
+				boost::shared_ptr<const expressionMM> saved_possible_expression_;
+
+			public:
+
+				/* 
+				 * Return the possible expressions for the symbols of rule id,
+				 * as computed by the last call to compute_possible_expression
+				 */
+				const expressionM& possible_expression(const rule::identifier_type& id) const;
+
+				facts_ctx(const funcDefList& fun) : ctx_rules_update(false), 
+					saved_rules_update(false), version_(0), saved_version_(0),
+					last_version_(0), table_version_(0), funcs_(fun),
+					next_assertion_(0), saved_next_assertion_(0), possible_rules_(0),
+					saved_possible_rules_(0), f(fun),
 					symbol_to_possible_expression(new expressionMM())
 				{}
 
 				bool add(const std::string& fact) { 
-					bool res = f.add(fact);
-					ctx_rules_update = false;
-					return res;
+					generate_return r = generate(fact, funcs_);
+					assert(r.res);
+					if (!r.res) return false;
+					return add_(r.e);
 				}
 
 				bool add(const function_call& fact) { 
-					bool res = f.add(fact);
-					ctx_rules_update = false;
-					return res;
+					generate_return r = generate(fact, funcs_);
+					assert(r.res);
+					if (!r.res) return false;
+					return add_(r.e);
+				}
+
+				/*
+				 * Retract the asserted facts equal to fact, and the facts
+				 * which depend on them (see facts::retract). The
+				 * categories of the removed facts are inserted in removed,
+				 * unless the database has to be rebuilt from the remaining
+				 * asserted facts : rebuilt is then set, and the rules must
+				 * be applied again on the whole database.
+				 *
+				 * Returns false if fact has not been asserted.
+				 */
+				bool retract(const function_call& fact, std::set<functionId>& removed,
+							 bool& rebuilt);
+
+				void new_rule() { 
+					ctx_rules_update = false; 
+					new_version();
+				}
+
+				size_t version() const { return version_; }
+
+				/* @see facts::begin_transaction */
+				void begin_transaction() {
+					saved_rules_update = ctx_rules_update;
+					saved_version_ = version_;
+					saved_next_assertion_ = next_assertion_;
+					saved_possible_expression_ = symbol_to_possible_expression;
+					saved_possible_rules_ = possible_rules_;
+					f.begin_transaction();
+					rete.begin_transaction();
+				}
+
+				void commit() { f.commit(); rete.commit(); }
+
+				void rollback() {
+					f.rollback();
+					rete.rollback();
+					ctx_rules_update = saved_rules_update;
+					version_ = saved_version_;
+					assertions_.erase(assertions_.lower_bound(saved_next_assertion_),
+									  assertions_.end());
+					next_assertion_ = saved_next_assertion_;
+					symbol_to_possible_expression = saved_possible_expression_;
+					possible_rules_ = saved_possible_rules_;
 				}
 
-				void new_rule() { ctx_rules_update = false; }
+				/* 
+				 * Look for f in the tabling cache. Returns boost::none if f
+				 * has not been proved or refuted for the current version.
+				 */
+				boost::optional<bool> table_find(const function_call& f);
+				void table_insert(const function_call& f, bool proved);
 
 				void compute_possible_expression(const rules& rs);
 		};
 
 		std::ostream& operator << (std::ostream& oss, const facts_ctx& f);
 
+		/**
+		 * Strategy used to compute the closure of a facts_ctx under the rules
+		 *
+		 * naive_chaining re-applies every rule on the whole facts database
+		 * until no new fact is produced. semi_naive_chaining only joins the
+		 * rules conditions with the facts produced by the previous round.
+		 * rete_chaining compiles the rules into a rete_network, and keeps
+		 * the partial matches of the rules between two calls, so each new
+		 * fact is only joined once with the facts already known.
+		 * They all compute the same closure.
+		 */
+		enum chaining_strategy { naive_chaining, semi_naive_chaining, rete_chaining };
+
+		/**
+		 * Bound the work of the backward chaining of one infer : the search
+		 * stops once max_nodes nodes of the proof tree have been built, or
+		 * once deadline is passed. The goal is then indeterminate, and the
+		 * hypothesis found so far are returned. A default constructed
+		 * budget is unlimited.
+		 */
+		struct infer_budget {
+			boost::posix_time::ptime deadline; /**< not_a_date_time if none */
+			size_t max_nodes; /**< 0 if unlimited */
+
+			infer_budget() : max_nodes(0) {}
+			infer_budget(const boost::posix_time::ptime& deadline, size_t max_nodes = 0) :
+				deadline(deadline), max_nodes(max_nodes) {}
+
+			/* A budget of d from now */
+			static infer_budget within(const boost::posix_time::time_duration& d, 
+									   size_t max_nodes = 0)
+			{
+				return infer_budget(boost::posix_time::microsec_clock::universal_time() + d, 
+									max_nodes);
+			}
+
+			bool unlimited() const { return deadline.is_not_a_date_time() && max_nodes == 0; }
+
+			/* true if the search must stop after building nodes nodes */
+			bool exhausted(size_t nodes) const
+			{
+				if (max_nodes != 0 && nodes >= max_nodes)
+					return true;
+				return !deadline.is_not_a_date_time() && 
+					   boost::posix_time::microsec_clock::universal_time() >= deadline;
+			}
+		};
+
+		/*
+		 * For each predicate, the equal_${type} predicate of each of its
+		 * arguments, as a function_call whose two arguments are to be
+		 * filled. For each function, the same followed by the equality
+		 * predicate of its return type. As equality is not encoded as rules
+		 * (see engine::add_type), backward_chaining uses it to propose the
+		 * equality hypotheses which make a goal true by congruence.
+		 */
+		typedef std::map<functionId, std::vector<function_call> > congruenceM;
+
+		struct infer_pool;
+
 		class engine {
 			private:
 				funcDefList funcs_; /**< A set of known function definition */
+				congruenceM congruence_;
 
 				/** 
 				 * A set of facts database (our post-conditions), indexed by
@@ -83,10 +266,82 @@ namespace hyper {
 				typedef std::map<std::string, facts_ctx> factsMap;
 				factsMap facts_ ;
 
+				/**
+				 * The base layer : the facts shared by all the contexts.
+				 * The contexts are created as a copy of it, which shares
+				 * its facts until they are modified, @see add_base_fact
+				 */
+				facts_ctx base_;
+
 				rules rules_;  /**< A set of logic rules, the same for all context */
 
+				void add_congruence(functionId id, const std::vector<std::string>& types);
+
+				chaining_strategy strategy_;
+				rete_network rete_; /**< the rules compiled for rete_chaining */
+
+				size_t parallelism_; /**< number of threads used by parallel_infer_all */
+				size_t parallel_threshold_; /**< @see set_parallel_threshold */
+
+				/* 
+				 * The threads of parallel_infer_, started on its first call
+				 * and kept until the destruction of the engine
+				 */
+				boost::shared_ptr<infer_pool> pool_;
+				boost::mutex pool_mutex_;
+
+				std::ostream* trace_; /**< if not null, the calls are recorded, @see set_trace */
+				boost::mutex trace_mutex_; /**< protects trace_ from parallel_infer_ */
+
+				bool truth_maintenance_; /**< @see set_truth_maintenance */
+
+				bool declaring_; /**< @see begin_declarations */
+
+				/*
+				 * Write one line of the trace. The expressions are written
+				 * so that they can be parsed again by generate.
+				 */
+				void record(const std::string& line);
+
+				static std::string trace_string(const std::string& s) { return s; }
+				static std::string trace_string(const function_call& f);
+
+				template <typename FactType>
+				void record(const std::string& op, const std::string& identifier, const FactType& f)
+				{
+					if (trace_)
+						record(op + " " + identifier + " | " + trace_string(f));
+				}
+
+				template <typename FactType>
+				static std::string trace_string(const std::vector<FactType>& v)
+				{
+					std::string res;
+					for (size_t i = 0; i < v.size(); ++i) {
+						if (i != 0) res += " ; ";
+						res += trace_string(v[i]);
+					}
+					return res;
+				}
+
 				void apply_rules(facts_ctx &);
 
+				void apply_new_rule()
+				{
+					base_.f.invalidate_delta();
+					apply_rules(base_);
+
+					// XXX rewrite it using boost::phoenix::bind
+					for (factsMap::iterator it = facts_.begin(); it != facts_.end(); ++it) {
+						// the new rule must be checked against all the known facts
+						it->second.f.invalidate_delta();
+						apply_rules(it->second);
+					}
+				}
+				void apply_rules_naive(facts_ctx &);
+				void apply_rules_semi_naive(facts_ctx &);
+				void apply_rules_rete(facts_ctx &);
+
 				/**
 				 * Get the fact_ctx associated to an identifier
 				 *
@@ -95,17 +350,6 @@ namespace hyper {
 				 */
 				facts_ctx& get_facts(const std::string& identifier);
 
-
-				/**
-				 * Set the fact_ctx associated to an identifier
-				 *
-				 * @param a string identifier describing the context
-				 * (corresponding to task)
-				 * @param ctx 
-				 * @return nothing, facts_ is modified.
-				 */
-				void set_facts(const std::string& identifier, const facts_ctx& ctx);
-
 				/**
 				 * Infer if a fact can be decided from the facts_ctx associated
 				 * to identifier
@@ -113,9 +357,11 @@ namespace hyper {
 				 * @param f represents the facts the system try to infer
 				 * @param identifier is a string identifier for the fact_ctx we
 				 * want to use
+				 * @param budget bounds the backward chaining
 				 * @return a tribool true / false / can't infer
 				 */
-				boost::logic::tribool infer_(const logic::function_call& f, const std::string& identifier);
+				boost::logic::tribool infer_(const logic::function_call& f, const std::string& identifier,
+											 const infer_budget& budget);
 
 				/**
 				 * Infer if a fact can be decided from the facts_ctx associated
@@ -126,25 +372,52 @@ namespace hyper {
 				 * @param hyps can store some hypothesis which leads to f be true.
 				 * @param identifier is a string identifier for the fact_ctx we
 				 * want to use
+				 * @param budget bounds the backward chaining
 				 * @return a tribool true / false / can't infer
 				 */
 				boost::logic::tribool infer_(const logic::function_call& f,
 											std::vector<logic::function_call>& hyps,
-										    const std::string& identifier);
+										    const std::string& identifier,
+											const infer_budget& budget);
+
+				bool retract_fact_(const function_call& fact, const std::string& identifier);
+
+				bool add_base_fact_(const function_call& fact);
 
 				/**
 				 * Compute if the fact_ctx form a sound theory or if it leads to incoherencies.
-				 * In case of success, update the facts_ with facts for identifier
+				 * facts must be in a transaction : it is committed in case of
+				 * success, and rollbacked otherwise.
+				 */
+				bool generate_theory(facts_ctx& facts);
+
+				typedef boost::function<boost::logic::tribool (const std::string&, 
+											std::vector<logic::function_call>&)> infer_task;
+
+				/**
+				 * Run task on each identifier of ids, using the calling
+				 * thread and parallelism_ - 1 threads of pool_. The result
+				 * and the hypothesis associated to ids[i] are stored in
+				 * res[i] and hyps[i]. If the facts_ctx of ids hold less
+				 * than parallel_threshold_ facts, they are just handled one
+				 * after the other.
+				 *
+				 * Each facts_ctx is only accessed by one thread, and the
+				 * shared structures (funcs_, rules_) are only read.
 				 */
-				bool generate_theory(facts_ctx& facts, const std::string& identifier);
+				void parallel_infer_(const std::vector<std::string>& ids, infer_task task,
+									 std::vector<boost::logic::tribool>& res,
+									 std::vector<std::vector<logic::function_call> >& hyps);
 			
 			public:
 				engine();
 
 				/**
-				 * Add the existence of type in the engine, and associated equality predicates :
-				 * equal_${type}(X, Y) :- equal_${type}(Y, X)
-				 * equal_${type}(X, Y), equal_${type}(Y, Z) :- equal_${type}(X, Z)
+				 * Add the existence of type in the engine, and its associated
+				 * equality predicate equal_${type}. It is a unification
+				 * predicate : its reflexivity, symmetry and transitivity,
+				 * and the congruence of the other predicates and functions
+				 * are handled directly by the facts database.
 				 *
 				 * @param type represents the name of the new type
 				 * @return true. 
@@ -166,11 +439,12 @@ namespace hyper {
 								   eval_predicate* p= 0);
 				
 				/**
-				 * Add a function in the engine, and its associated predicate
+				 * Add a function in the engine
 				 *
 				 * @param identifier is the name of the function
 				 * @param arity is the number of arguments
-				 * @params args_types is the list of types, in order. type must exists.
+				 * @params args_types is the list of types, in order, followed
+				 * by the return type. type must exists.
 				 *
 				 * @return if the function is valide, and has been succesfully inserted
 				 */
@@ -192,11 +466,41 @@ namespace hyper {
 				bool add_fact(const FactType& fact,
 							  const std::string& identifier = "default")
 				{
-					/* yes copy it, until we check the coherency */
-					facts_ctx current_facts = get_facts(identifier);
+					record("fact", identifier, fact);
+
+					/* record the changes, until we check the coherency */
+					facts_ctx& current_facts = get_facts(identifier);
+					current_facts.begin_transaction();
 					current_facts.add(fact);
 
-					return generate_theory(current_facts, identifier);
+					return generate_theory(current_facts);
+				}
+
+				/**
+				 * Add a fact in the base layer, shared by all the contexts.
+				 * FactType is of kind string, or logic::function_call
+				 *
+				 * A new context starts as a copy of the base layer, which
+				 * shares its facts until it modifies them : its memory
+				 * depends on its own facts, and the consequences of the
+				 * base facts are not computed again. The fact is also added
+				 * to the existing contexts, as by add_fact. So the base
+				 * facts should be added before the others.
+				 *
+				 * @return false if the fact is inconsistent with the base
+				 * layer. The existing contexts it is inconsistent with
+				 * don't get it.
+				 */
+				template <typename FactType>
+				bool add_base_fact(const FactType& fact)
+				{
+					if (trace_)
+						record("base | " + trace_string(fact));
+
+					generate_return r = generate(fact, funcs_);
+					if (!r.res)
+						return false;
+					return add_base_fact_(r.e);
 				}
 
 				/**
@@ -206,6 +510,33 @@ namespace hyper {
 				bool add_fact(const std::vector<std::string>&, 
 							  const std::string& identifier = "default");
 
+				/**
+				 * Retract a fact previously added with add_fact in the
+				 * identifier fact_ctx, and the facts derived from it.
+				 * FactType is of kind string, or logic::function_call
+				 *
+				 * With the truth maintenance (see set_truth_maintenance),
+				 * only the facts whose support contains fact are removed,
+				 * and the rules are applied again to derive them
+				 * differently if possible. Otherwise, or if a unification
+				 * of logic variables depends on fact, the fact_ctx is
+				 * rebuilt from the remaining asserted facts.
+				 *
+				 * @return false if fact has not been asserted in this
+				 * context
+				 */
+				template <typename FactType>
+				bool retract_fact(const FactType& fact,
+								  const std::string& identifier = "default")
+				{
+					record("retract", identifier, fact);
+
+					generate_return r = generate(fact, funcs_);
+					if (!r.res)
+						return false;
+					return retract_fact_(r.e, identifier);
+				}
+
 				/**
 				 * Add a rule in the engine. FactType is of kind string or function_call.
 				 *
@@ -220,11 +551,32 @@ namespace hyper {
 							  const typename std::vector<FactType>& cond,
 							  const typename std::vector<FactType>& action)
 				{
+					if (trace_)
+						record("rule " + identifier + " | " + trace_string(cond) + 
+							   " | " + trace_string(action));
 					bool res = rules_.add(identifier, cond, action);
+					if (!declaring_)
+						apply_new_rule();
+					return res;
+				}
 
-					// XXX rewrite it using boost::phoenix::bind
-					for (factsMap::iterator it = facts_.begin(); it != facts_.end(); ++it) 
-						apply_rules(it->second);
+				/**
+				 * Add a rule in the engine, whose conditions are unified by
+				 * the native matcher m, generally generated by hyperc.
+				 *
+				 * @see add_rule, rule::matcher_type
+				 */
+				bool add_rule(const std::string& identifier,
+							  const std::vector<function_call>& cond,
+							  const std::vector<function_call>& action,
+							  const rule::matcher_type& m)
+				{
+					if (trace_)
+						record("rule " + identifier + " | " + trace_string(cond) + 
+							   " | " + trace_string(action));
+					bool res = rules_.add(identifier, cond, action, m);
+					if (!declaring_)
+						apply_new_rule();
 					return res;
 				}
 
@@ -245,8 +597,22 @@ namespace hyper {
 				boost::logic::tribool infer(const GoalType& goal,
 											const std::string& identifier = "default")
 				{
+					record("infer", identifier, goal);
+					facts_ctx& current_facts = get_facts(identifier);
+					return infer_(current_facts.f.generate(goal), identifier, infer_budget());
+				}
+
+				/**
+				 * Same as infer, but the search is bounded by budget. If it is
+				 * exhausted before a conclusion, the result is indeterminate.
+				 */
+				template <typename GoalType>
+				boost::logic::tribool infer(const GoalType& goal, const infer_budget& budget,
+											const std::string& identifier = "default")
+				{
+					record("infer", identifier, goal);
 					facts_ctx& current_facts = get_facts(identifier);
-					return infer_(current_facts.f.generate(goal), identifier);
+					return infer_(current_facts.f.generate(goal), identifier, budget);
 				}
 
 				/** 
@@ -268,8 +634,26 @@ namespace hyper {
 											std::vector<logic::function_call>& hyps,
 											const std::string& identifier = "default")
 				{
+					record("infer_hyps", identifier, goal);
+					facts_ctx& current_facts = get_facts(identifier);
+					return infer_(current_facts.f.generate(goal), hyps, identifier, infer_budget());
+				}
+
+				/**
+				 * Same as infer, but the search is bounded by budget. If it is
+				 * exhausted before a conclusion, the result is indeterminate,
+				 * and hyps contains the hypothesis found in the part of the
+				 * proof tree explored so far.
+				 */
+				template <typename GoalType>
+				boost::logic::tribool infer(const GoalType& goal,
+											std::vector<logic::function_call>& hyps,
+											const infer_budget& budget,
+											const std::string& identifier = "default")
+				{
+					record("infer_hyps", identifier, goal);
 					facts_ctx& current_facts = get_facts(identifier);
-					return infer_(current_facts.f.generate(goal), hyps, identifier);
+					return infer_(current_facts.f.generate(goal), hyps, identifier, budget);
 				}
 
 				/**
@@ -361,9 +745,156 @@ namespace hyper {
 					}
 				}
 
+				/**
+				 * Same as infer_all_in, but the different facts_ctx are
+				 * evaluated concurrently (@see set_parallelism). The results
+				 * are written in the same order than infer_all_in.
+				 */
+				template <typename GoalType, typename OutputIterator1, typename OutputIterator2, typename InputIterator>
+				void parallel_infer_all_in(const GoalType& goal, OutputIterator1 out1, OutputIterator2 out2,
+										   InputIterator begin, InputIterator end)
+				{
+					parallel_infer_all_in(goal, out1, out2, begin, end, infer_budget());
+				}
+
+				/**
+				 * Same as parallel_infer_all_in, but the search in each
+				 * facts_ctx is bounded by budget (@see infer_budget). The
+				 * deadline is common to all the facts_ctx, max_nodes applies
+				 * to each of them.
+				 */
+				template <typename GoalType, typename OutputIterator1, typename OutputIterator2, typename InputIterator>
+				void parallel_infer_all_in(const GoalType& goal, OutputIterator1 out1, OutputIterator2 out2,
+										   InputIterator begin, InputIterator end,
+										   const infer_budget& budget)
+				{
+					std::vector<std::string> ids;
+					for (factsMap::const_iterator it = facts_.begin();
+												  it != facts_.end(); ++it)
+					{
+						if (std::find(begin, end, it->first) == end) 
+							ids.push_back(it->first);
+					}
+
+					boost::logic::tribool (engine::*f) (const GoalType&, std::vector<logic::function_call>&,
+														const infer_budget&, const std::string&) = 
+						&engine::infer<GoalType>;
+
+					std::vector<boost::logic::tribool> res(ids.size());
+					std::vector<std::vector<logic::function_call> > hyps(ids.size());
+					parallel_infer_(ids, boost::bind(f, this, boost::cref(goal), _2, boost::cref(budget), _1), 
+									res, hyps);
+
+					for (size_t i = 0; i < ids.size(); ++i) {
+						if (!boost::logic::indeterminate(res[i]) && res[i])
+							*out1++ = ids[i];
+						else if (boost::logic::indeterminate(res[i]) && !hyps[i].empty()) {
+							plausible_hypothesis h;
+							h.name = ids[i];
+							std::swap(h.hyps, hyps[i]);
+							*out2++ = h;
+						}
+					}
+				}
+
+				template <typename GoalType, typename OutputIterator1, typename OutputIterator2>
+				void parallel_infer_all(const GoalType& goal, OutputIterator1 out1, OutputIterator2 out2)
+				{
+					std::vector<std::string> none;
+					parallel_infer_all_in(goal, out1, out2, none.begin(), none.end());
+				}
+
 				friend std::ostream& operator << (std::ostream&, const engine&);
 
 				const funcDefList& funcs() const { return funcs_; }
+
+				/**
+				 * Set the number of threads used by parallel_infer_all. By
+				 * default, the number of cores of the machine.
+				 */
+				void set_parallelism(size_t n) { parallelism_ = n; }
+				size_t get_parallelism() const { return parallelism_; }
+
+				/**
+				 * Set the number of facts under which parallel_infer_all
+				 * does not use threads, as the inference is then cheaper
+				 * than the synchronisation. The facts of all the facts_ctx
+				 * to handle are counted.
+				 */
+				void set_parallel_threshold(size_t n) { parallel_threshold_ = n; }
+				size_t get_parallel_threshold() const { return parallel_threshold_; }
+
+				/*
+				 * The rete memories are not fed by the other strategies, so
+				 * they are dropped when changing of strategy.
+				 */
+				void set_chaining_strategy(chaining_strategy s);
+
+				/**
+				 * Record, for each fact, the asserted facts it has been
+				 * derived from, so that retract_fact only removes the facts
+				 * which depend on the retracted one. It costs a lookup of
+				 * the premises each time a rule is applied, so it is
+				 * disabled by default. The facts known before enabling it
+				 * have no support : the next retract_fact rebuilds their
+				 * fact_ctx.
+				 */
+				void set_truth_maintenance(bool b);
+				bool get_truth_maintenance() const { return truth_maintenance_; }
+
+				/**
+				 * Record the declarations, the facts, the rules and the
+				 * queries received by the engine in os, one per line, so
+				 * that the workload can be replayed later (see bench_logic).
+				 * The lines are :
+				 *   type <name>
+				 *   predicate <name> <arity> <type>...
+				 *   func <name> <arity> <type>...
+				 *   rule <name> | <cond> ; <cond> | <action> ; <action>
+				 *   base | <fact>
+				 *   fact <identifier> | <fact> ; <fact>
+				 *   retract <identifier> | <fact>
+				 *   infer <identifier> | <goal>
+				 *   infer_hyps <identifier> | <goal>
+				 * The evaluation functions of the predicates are not
+				 * recorded. set_trace(0) stops the recording.
+				 */
+				void set_trace(std::ostream* os) { trace_ = os; }
+
+				/**
+				 * Until end_declarations, add_rule does not apply the new
+				 * rules to the known facts. An ability declares all its
+				 * rules at start, so they are applied once, and not after
+				 * each of them.
+				 */
+				void begin_declarations() { declaring_ = true; }
+
+				/**
+				 * Apply the rules declared since begin_declarations
+				 */
+				void end_declarations()
+				{
+					if (!declaring_)
+						return;
+					declaring_ = false;
+					apply_new_rule();
+				}
+
+				/**
+				 * Check if the facts_ctx identifier is consistent with the
+				 * rules and the evaluation functions of the predicates
+				 */
+				bool is_consistent(const std::string& identifier = "default");
+
+				/**
+				 * Return all the facts of the facts_ctx identifier, asserted or
+				 * derived, with their logic variables replaced by the terms
+				 * they are unified with, sorted. It does not depend on the
+				 * chaining strategy.
+				 */
+				std::vector<function_call> known_facts(const std::string& identifier = "default");
+
+				chaining_strategy get_chaining_strategy() const { return strategy_; }
 		};
 
 		std::ostream& operator << (std::ostream&, const engine&);
@@ -18,6 +18,20 @@ namespace hyper {
 		struct eval_predicate
 		{
 			virtual tribool operator()(const std::vector<expression>& e) = 0;
+
+			/*
+			 * Evaluate the predicate on the arguments of each element of v,
+			 * and append the results to res. The specialisations of eval
+			 * call their functor directly, so evaluating a whole category
+			 * of facts costs only one virtual call.
+			 */
+			virtual void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				res.reserve(res.size() + v.size());
+				for (size_t i = 0; i < v.size(); ++i)
+					res.push_back((*this)(v[i].args));
+			}
+
 			virtual ~eval_predicate() {};
 		};
 
@@ -28,6 +42,11 @@ namespace hyper {
 			{
 				(void)e; return indeterminate;
 			}
+
+			void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				res.resize(res.size() + v.size(), indeterminate);
+			}
 		};
 
 		template <typename F>
@@ -38,6 +57,14 @@ namespace hyper {
 				assert(e.size() == 0);
 				return F()();
 			}
+
+			void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				F f;
+				res.reserve(res.size() + v.size());
+				for (size_t i = 0; i < v.size(); ++i)
+					res.push_back(f());
+			}
 		};
 
 		template <>
@@ -47,6 +74,11 @@ namespace hyper {
 			{
 				(void)e; return indeterminate;
 			}
+
+			void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				res.resize(res.size() + v.size(), indeterminate);
+			}
 		};
 
 		template <typename F>
@@ -57,6 +89,14 @@ namespace hyper {
 				assert(e.size() == 1);
 				return F()(e[0].expr);
 			}
+
+			void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				F f;
+				res.reserve(res.size() + v.size());
+				for (size_t i = 0; i < v.size(); ++i)
+					res.push_back(f(v[i].args[0].expr));
+			}
 		};
 
 		template <>
@@ -66,6 +106,11 @@ namespace hyper {
 			{
 				(void)e; return indeterminate;
 			}
+
+			void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				res.resize(res.size() + v.size(), indeterminate);
+			}
 		};
 
 		template <typename F>
@@ -76,6 +121,14 @@ namespace hyper {
 				assert(e.size() == 2);
 				return F()(e[0].expr, e[1].expr);
 			}
+
+			void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				F f;
+				res.reserve(res.size() + v.size());
+				for (size_t i = 0; i < v.size(); ++i)
+					res.push_back(f(v[i].args[0].expr, v[i].args[1].expr));
+			}
 		};
 
 		template <>
@@ -85,6 +138,11 @@ namespace hyper {
 			{
 				(void)e; return indeterminate;
 			}
+
+			void eval_all(const std::vector<function_call>& v, std::vector<tribool>& res)
+			{
+				res.resize(res.size() + v.size(), indeterminate);
+			}
 		};
 	}
 }
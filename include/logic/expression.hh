@@ -37,6 +37,13 @@ namespace hyper {
 		struct empty {};
 		struct function_call;
 
+		/*
+		 * Expressions are plain values, as compiler/ and model/ build and
+		 * visit them directly (boost::get<std::string>, visitors on expr).
+		 * Functions are compared by functionId, and the other parts of a
+		 * term by value, in one walk (see compare). Inside logic/, the
+		 * facts database keeps them interned, see term.hh.
+		 */
 		struct expression
 		{
 			typedef
@@ -105,8 +112,33 @@ namespace hyper {
 #undef PUSH_BACK_ARGS
 #undef NEW_PARAMS_ARGS
 
+		/*
+		 * Three-way comparison of expressions and function_call : returns a
+		 * negative value, zero or a positive value if the first one is
+		 * respectively lesser, equal or greater than the second one. The
+		 * comparison operators rely on it, so that a comparison walks each
+		 * term only once.
+		 */
+		int compare(const expression& e1, const expression& e2);
+		int compare(const function_call& f1, const function_call& f2);
+
+		bool operator == (const function_call& f1, const function_call& f2);
+
+		inline bool operator != (const function_call& f1, const function_call& f2)
+		{
+			return ! (f1 == f2);
+		}
+
 		bool operator < (const function_call& f1, const function_call& f2);
 
+		/*
+		 * Structural hash of expressions and function_call, consistent with
+		 * compare. It is found by boost::hash, and used by the hash based
+		 * containers (see HYPER_LOGIC_HASH).
+		 */
+		std::size_t hash_value(const expression& e);
+		std::size_t hash_value(const function_call& f);
+
 		/* Will extend it with error case if needed */
 		struct generate_return {
 			bool res;
@@ -1,12 +1,21 @@
 #ifndef _LOGIC_FACTS_HH_
 #define _LOGIC_FACTS_HH_
 
+#include <hyperConfig.hh>
+
 #include <logic/expression.hh>
 #include <logic/logic_var.hh>
+#include <logic/term.hh>
 
 #include <boost/logic/tribool.hpp>
+#include <boost/optional/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#if HYPER_LOGIC_HASH
+#include <boost/unordered_map.hpp>
+#endif
 
 #include <iostream>
+#include <map>
 #include <set>
 #include <vector>
 
@@ -15,15 +24,138 @@ namespace hyper {
 		struct handle_adapt_res;
 		class facts {
 			public:
-				typedef std::set<function_call> expressionS;
+				/*
+				 * The facts and the sub-expressions are kept by term (see
+				 * term_set), in the term table of funcs : they are in the
+				 * order of their first insertion in the table, or not
+				 * ordered at all when HYPER_LOGIC_HASH is set.
+				 */
+				typedef term_set<function_call> expressionS;
 				typedef std::vector<expressionS> factsV;
 				typedef expressionS::const_iterator const_iterator;
 
 				/* A list of sub-expression which appears for each category */
-				typedef std::set<expression> sub_expressionS;
-				typedef std::vector<sub_expressionS> sub_expressionV;
+				typedef term_set<expression> sub_expressionS;
 				typedef sub_expressionS::const_iterator sub_const_iterator;
 
+				/*
+				 * The facts and the sub-expressions of each category are
+				 * shared between the copies of a database, and only copied
+				 * by the first modification of a copy (copy on write). So a
+				 * copy of a database (see engine::add_base_fact) only costs
+				 * the categories it modifies. A null pointer is an empty
+				 * category.
+				 */
+				typedef std::vector<boost::shared_ptr<expressionS> > shared_factsV;
+				typedef std::vector<boost::shared_ptr<sub_expressionS> > sub_expressionV;
+
+				/*
+				 * The list of facts inserted since the last call to
+				 * take_delta(), indexed by functionId. If all is true, the
+				 * database has been rewritten in the meantime (unification of
+				 * logic variables), and each fact must be considered as new.
+				 */
+				struct delta_type {
+					bool all;
+					size_t size;
+					factsV list;
+
+					delta_type() : all(false), size(0) {}
+
+					bool empty() const { return !all && size == 0; }
+
+					const_iterator begin(functionId id) const { return list[id].begin(); }
+					const_iterator end(functionId id) const { return list[id].end(); }
+				};
+
+				/*
+				 * Index of the facts of one category on one argument
+				 * position : for each term of the argument, the list of
+				 * facts with this value. Indexes are built lazily, on the
+				 * first lookup for a position, and then maintained by
+				 * add_new_facts until the next apply_permutations, or until
+				 * the category is rehashed.
+				 */
+				typedef std::vector<const_iterator> const_iteratorV;
+				struct arg_index {
+					bool built;
+#if HYPER_LOGIC_HASH
+					typedef boost::unordered_map<term, const_iteratorV> map_type;
+#else
+					typedef std::map<term, const_iteratorV> map_type;
+#endif
+					map_type m;
+
+					arg_index() : built(false) {}
+				};
+
+				/* 
+				 * The indexes refer to the nodes of list, so they are never
+				 * copied, but rebuilt on demand by the copy.
+				 */
+				struct index_type {
+					std::vector<std::vector<arg_index> > v;
+
+					index_type() {}
+					index_type(const index_type&) {}
+					index_type& operator=(const index_type&) { v.clear(); return *this; }
+				};
+
+				/* The list of sub-expressions inserted, by category */
+				typedef std::vector<std::pair<functionId, expression> > sub_logV;
+
+				/*
+				 * The sub-expressions inserted since the last call to
+				 * take_sub_delta(). If all is true, some sub-expressions
+				 * have been rewritten or removed in the meantime.
+				 */
+				struct sub_delta_type {
+					bool all;
+					sub_logV list;
+
+					sub_delta_type() : all(false) {}
+				};
+
+				/*
+				 * Support of a fact, for the truth maintenance (see
+				 * track_support) : the sorted numbers of the asserted facts
+				 * it has been derived from. An asserted fact is supported by
+				 * its own number.
+				 */
+				typedef std::vector<size_t> support_type;
+				typedef std::map<function_call, support_type> supportM;
+
+				/*
+				 * Undo log of the modifications done since
+				 * begin_transaction(). Insertions are logged one by one. When
+				 * apply_permutations rewrites the database, a copy of the
+				 * facts is saved instead, and the following insertions are
+				 * not logged anymore.
+				 */
+				struct transaction_type {
+					bool active;
+					bool saved;
+					size_t size;
+					delta_type delta;
+					std::vector<function_call> new_facts;
+					sub_logV new_sub_expressions;
+					shared_factsV list;
+					sub_expressionV sub_list;
+					supportM supports;
+					/* the previous support of the facts whose support changed */
+					std::vector<std::pair<function_call, boost::optional<support_type> > > 
+						replaced_supports;
+					size_t unify_support_size;
+					size_t sub_delta_size;
+					bool sub_delta_taken;
+					/* the shared categories copied by the transaction */
+					std::vector<std::pair<functionId, boost::shared_ptr<expressionS> > > copied;
+
+					transaction_type() : active(false), saved(false), size(0),
+										 unify_support_size(0), sub_delta_size(0),
+										 sub_delta_taken(false) {}
+				};
+
 				/* 
 				 * Let handle_adapt_res visitor access to add_new_facts, and
 				 * apply_permutations, but let them private as they are no part
@@ -32,33 +164,145 @@ namespace hyper {
 				friend struct handle_adapt_res;
 			private:
 				const funcDefList& funcs;
-				mutable factsV list;
+				mutable shared_factsV list;
 				mutable sub_expressionV sub_list;
 				logic_var_db db;
+				delta_type delta_;
+				sub_delta_type sub_delta_;
+				mutable index_type index_;
+				transaction_type transaction_;
 
 				size_t size__;
 
+				/*
+				 * Truth maintenance : supports_ records the support of each
+				 * fact, and unify_support_ the asserted facts the
+				 * unifications of logic variables depend on (no_support if
+				 * one of them is unknown). support_ is the support of the
+				 * fact being added. untracked_ is set if something has been
+				 * added while track_support_ was not set.
+				 */
+				bool track_support_;
+				bool untracked_;
+				const support_type* support_;
+				supportM supports_;
+				std::vector<size_t> unify_support_;
+
+				static const size_t no_support = static_cast<size_t>(-1);
+
+				void record_support(const function_call& f, bool inserted);
+
+				/* 
+				 * Incremented each time the facts are moved in memory, so the
+				 * pointers on them are invalidated
+				 */
+				mutable size_t generation_;
+
+				term_table& terms() const { return funcs.terms(); }
+
 				bool add_new_facts(const function_call& f);
 				bool apply_permutations(const adapt_res::permutationSeq& seq);
 
-				template <typename T>
-				void resize(functionId id, T& list_) const 
+				void resize(functionId id) const 
 				{
 					if (id >= list.size()) {
 						assert(id < funcs.size());
-						list_.resize(funcs.size());
+						list.resize(funcs.size());
+						sub_list.resize(funcs.size());
+						generation_++;
 					}
 				}
+
+				const expressionS& category(functionId id) const {
+					static const expressionS empty;
+					resize(id);
+					return list[id] ? *list[id] : empty;
+				}
+
+				/* The facts of category id, copied first if they are shared */
+				expressionS& own_category(functionId id);
+				const sub_expressionS& sub_category(functionId id) const {
+					static const sub_expressionS empty;
+					resize(id);
+					return sub_list[id] ? *sub_list[id] : empty;
+				}
+
 				bool add_(const function_call& f);
+				boost::logic::tribool known(const function_call& f);
+				template <typename Iterator>
+				void matches_(Iterator begin, Iterator end, std::vector<boost::logic::tribool>& res);
+				arg_index& get_index(functionId id, size_t pos) const;
+				void unindex(const_iterator it);
+
+				sub_logV* sub_log() {
+					if (transaction_.active && !transaction_.saved)
+						return &transaction_.new_sub_expressions;
+					return 0;
+				}
 
 			public:	
-				facts(const funcDefList& funcs_): funcs(funcs_), db(funcs), size__(0) {}
+				facts(const funcDefList& funcs_): funcs(funcs_), db(funcs), size__(0),
+												  track_support_(false), untracked_(false),
+												  support_(0), generation_(0) {}
 
 				bool add(const std::string& s);
 				bool add(const function_call& f);
 
+				/* Add f, supported by s (see track_support) */
+				bool add(const std::string& f, const support_type& s);
+				bool add(const function_call& f, const support_type& s);
+
+				/* Remove all the facts, and forget all the logic variables */
+				void clear();
+
+				/*
+				 * Record, or not, the support of the new facts. When a fact
+				 * is produced several times, the smallest support is kept.
+				 * The facts added without support depend on all the
+				 * asserted facts.
+				 */
+				void track_support(bool b) { track_support_ = b; }
+				bool tracks_support() const { return track_support_; }
+
+				/* 
+				 * True if all the facts have been added while track_support
+				 * was set, since the creation or the last clear().
+				 */
+				bool complete_support() const { return track_support_ && !untracked_; }
+
+				/* Return the support of the fact f, or 0 if it is unknown */
+				const support_type* support(const function_call& f) const {
+					supportM::const_iterator it = supports_.find(f);
+					if (it == supports_.end())
+						return 0;
+					return &it->second;
+				}
+
+				/*
+				 * Remove the facts whose support contains one of the asserted
+				 * facts of s, or is unknown, and insert their category in
+				 * removed. The sub-expressions are kept, they only widen the
+				 * candidates of the backward chaining.
+				 *
+				 * Returns false, without removing anything, if the support is
+				 * not complete, or if a unification of logic variables
+				 * depends on s, as it can't be undone : the database must
+				 * then be rebuilt. It can't be called in a transaction.
+				 */
+				bool retract(const support_type& s, std::set<functionId>& removed);
+
 				boost::logic::tribool matches(const function_call & e);
 
+				/*
+				 * Batch version of matches : append to res the result of
+				 * matches for each element of v, or for each fact of
+				 * category id. Each run of function_call of a same
+				 * predicate is evaluated in one call to its eval_predicate.
+				 */
+				void matches(const std::vector<function_call>& v, 
+							 std::vector<boost::logic::tribool>& res);
+				void matches(functionId id, std::vector<boost::logic::tribool>& res);
+
 				template <typename ExpressionType>
 				function_call generate(const ExpressionType& f) {
 					generate_return r = hyper::logic::generate(f, funcs);
@@ -66,38 +310,91 @@ namespace hyper {
 					return db.adapt(r.e);
 				}
 
-				std::vector<function_call> generate_all(const function_call& f) const;
+				/* 
+				 * Return the adapted forms of the equality f, where each
+				 * argument is also replaced by the logic_var bound to it, in
+				 * both directions. Use generate_all to get back the concrete
+				 * hypotheses.
+				 */
+				std::vector<function_call> equal_candidates(const function_call& f);
 
-				const_iterator begin(functionId id) const { 
-					resize(id, list);
-					return list[id].begin();
-				}
+				std::vector<function_call> generate_all(const function_call& f) const;
 
-				const_iterator end(functionId id) const { 
-					resize(id, list);
-					return list[id].end();
-				}
+				const_iterator begin(functionId id) const { return category(id).begin(); }
+				const_iterator end(functionId id) const { return category(id).end(); }
 
 				sub_const_iterator sub_begin(functionId id) const {
-					resize(id, sub_list);
-					return sub_list[id].begin();
+					return sub_category(id).begin();
 				}
 
 				sub_const_iterator sub_end(functionId id) const {
-					resize(id, sub_list);
-					return sub_list[id].end();
+					return sub_category(id).end();
 				}
 
-				size_t size(functionId id) const {
-					if (id >= list.size())
-						list.resize(funcs.size());
-					return list[id].size();
+				bool has_sub_expression(functionId id, const expression& e) const {
+					const sub_expressionS& sub = sub_category(id);
+					return sub.find(e) != sub.end();
+				}
+
+				/*
+				 * Return the facts of category id whose argument number pos
+				 * is e
+				 */
+				const const_iteratorV& find(functionId id, size_t pos, const expression& e) const;
+
+				/* Return the fact f, or end(f.id) if it is not known */
+				const_iterator find(const function_call& f) const {
+					return category(f.id).find(f);
 				}
 
+				size_t size(functionId id) const { return category(id).size(); }
+
 				size_t size() const { return size__; }
 
 				size_t max_id() const { return list.size(); }
 
+				size_t generation() const { return generation_; }
+
+				/*
+				 * Start to record the modifications of the facts database.
+				 * They are then either kept with commit(), or cancelled with
+				 * rollback(). Transactions can't be nested.
+				 */
+				void begin_transaction();
+				void commit();
+				void rollback();
+
+				/*
+				 * Compute the changes done in the current transaction : d
+				 * receives the new facts, and to_match the facts whose
+				 * evaluation may have changed (the new ones and the ones
+				 * of an evaluable predicate which refer to a logic_var bound
+				 * in the meantime). 
+				 * Returns false if these changes can't be computed, because
+				 * the database has been rewritten, or because there is no
+				 * transaction.
+				 */
+				bool transaction_changes(delta_type& d, std::vector<function_call>& to_match) const;
+
+				/* 
+				 * Move the facts inserted since the previous call in d, and
+				 * start a new delta 
+				 */
+				void take_delta(delta_type& d);
+
+				/* 
+				 * Move the sub-expressions inserted since the previous call
+				 * in d, and start a new sub delta
+				 */
+				void take_sub_delta(sub_delta_type& d);
+
+				/* Consider that all the current facts are new ones */
+				void invalidate_delta() { 
+					delta_.all = true; 
+					delta_.size = 0;
+					delta_.list.clear();
+				}
+
 				friend std::ostream& operator << (std::ostream& os, const facts&);
 		};
 
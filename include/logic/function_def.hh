@@ -8,12 +8,14 @@
 
 #include <boost/optional/optional_fwd.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace hyper {
 	namespace logic {
 		typedef std::size_t functionId ;
 
 		struct eval_predicate;
+		class term_table;
 
 		/*
 		 * In the logic world, everything is untyped
@@ -42,7 +44,8 @@ namespace hyper {
 		 * search.
 		 *
 		 * funcDefList is also responsible of the lifetime of the
-		 * eval_predicate*, stored in list_eval
+		 * eval_predicate*, stored in list_eval, and of the table of the
+		 * terms built on its functions (see term.hh)
 		 */
 		class funcDefList : public boost::noncopyable
 		{
@@ -54,6 +57,7 @@ namespace hyper {
 				funcV list;
 				funcE list_eval;
 				funcM m;
+				boost::scoped_ptr<term_table> terms_;
 
 			public:
 				funcDefList();
@@ -72,6 +76,22 @@ namespace hyper {
 				boost::optional<functionId> getId(const std::string& name) const;
 
 				size_t size() const { return list.size(); }
+
+				/* 
+				 * Returns false if function id has been declared without
+				 * evaluation, so that it is never evaluated to true or false 
+				 */
+				bool evaluable(functionId id) const
+				{
+					return get(id).eval_pred != list_eval[0];
+				}
+
+				/*
+				 * The terms of the expressions on these functions. Making a
+				 * term doesn't change the functions, so the table can be
+				 * used through a const funcDefList.
+				 */
+				term_table& terms() const { return *terms_; }
 		};
 	}
 }
@@ -1,10 +1,19 @@
 #ifndef HYPER_LOGIC_LOGIC_VAR_HH_
 #define HYPER_LOGIC_LOGIC_VAR_HH_
 
+#include <hyperConfig.hh>
+
 #include <logic/expression.hh>
 
+#include <map>
+#include <set>
+
 #include <boost/bimap/bimap.hpp>
 #include <boost/bimap/multiset_of.hpp>
+#if HYPER_LOGIC_HASH
+#include <boost/bimap/unordered_multiset_of.hpp>
+#include <boost/bimap/unordered_set_of.hpp>
+#endif
 
 #include <boost/optional.hpp>
 #include <boost/variant/variant.hpp>
@@ -68,18 +77,54 @@ namespace hyper {
 
 		class logic_var_db {
 			public:
+#if HYPER_LOGIC_HASH
+				typedef boost::bimaps::bimap<
+					boost::bimaps::unordered_multiset_of<logic_var::identifier_type>,
+					boost::bimaps::unordered_set_of<expression>
+				> bm_type;
+#else
 				typedef boost::bimaps::bimap<
 					boost::bimaps::multiset_of<logic_var::identifier_type>,
 					boost::bimaps::set_of<expression>
 				> bm_type;
+#endif
 				typedef bm_type::value_type value_type;
 
 				typedef std::map<logic_var::identifier_type, logic_var> map_type;
 
+				/* The logic variables bound to each value, see bound_to */
+				typedef std::map<expression, std::set<logic_var::identifier_type> > 
+					value_index_type;
+
+				/*
+				 * Undo log of the modifications done since
+				 * begin_transaction() : the newly introduced logic variables,
+				 * and the previous state of the modified ones. A merge of two
+				 * logic variables rewrites the whole database, so in this
+				 * case, a copy of it is saved instead, and the following
+				 * modifications are not logged anymore.
+				 */
+				struct transaction_type {
+					bool active;
+					bool saved;
+					std::vector<logic_var::identifier_type> new_vars;
+					map_type modified_vars;
+					bm_type bm;
+					map_type m_logic_var;
+					value_index_type values;
+
+					transaction_type() : active(false), saved(false) {}
+				};
+
 			private:
 				bm_type bm;
 				map_type m_logic_var;
+				value_index_type values;
 				const funcDefList& funcs;
+				transaction_type transaction_;
+
+				void log_new_vars(const std::vector<logic_var::identifier_type>& v);
+				void log_unify(const expression& e1, const expression& e2);
 
 			public:
 				logic_var_db(const funcDefList& funcs) : funcs(funcs) {}
@@ -93,10 +138,28 @@ namespace hyper {
 
 				const logic_var& get(const logic_var::identifier_type& id) const;
 
+				/* Forget all the logic variables. It can't be called in a transaction */
+				void clear();
+
+				/* Return the logic_var whose value is e, in logarithmic time */
+				std::vector<logic_var::identifier_type> bound_to(const expression& e) const;
+
 				/* Do the inverse operation of adapt, meaning, replace all
 				 * logic_var by one of their value 1 -> n*/
 				std::vector<function_call> deadapt(const function_call& f) const;
 
+				/* @see facts::begin_transaction */
+				void begin_transaction();
+				void commit();
+				void rollback();
+
+				/* 
+				 * List the logic_var whose value has been modified in the
+				 * current transaction. Returns false if the database has
+				 * been rewritten, or if there is no transaction.
+				 */
+				bool transaction_changes(std::vector<logic_var::identifier_type>& vars) const;
+
 				friend std::ostream& operator<<(std::ostream& os, const logic_var_db& db);
 		};
 	}
@@ -0,0 +1,91 @@
+#ifndef _LOGIC_NATIVE_RULE_HH_
+#define _LOGIC_NATIVE_RULE_HH_
+
+#include <logic/facts.hh>
+#include <logic/rules.hh>
+#include <logic/unify.hh>
+
+#include <cassert>
+
+#include <boost/variant/get.hpp>
+
+namespace hyper {
+	namespace logic {
+		/*
+		 * Support for the native matchers generated by hyperc (see
+		 * rule::matcher_type). A native matcher is a nest of loops, one per
+		 * condition of the rule, with the arity of the conditions, their
+		 * constants and the variables they share known at compile time.
+		 */
+		namespace native {
+
+			/*
+			 * Enumerate the facts the condition k of a rule must be unified
+			 * with : the facts of delta if k is the delta condition, the facts
+			 * of the category through the argument index if the value of
+			 * one argument is already known, or the whole category
+			 * otherwise.
+			 */
+			class candidates {
+				private:
+					const facts::const_iteratorV* v_;
+					size_t i_;
+					facts::const_iterator it_, end_;
+
+				public:
+					candidates(const facts& fs, const facts::delta_type* delta,
+							   size_t delta_cond, size_t k, functionId id) : v_(0), i_(0)
+					{
+						if (delta && k == delta_cond) {
+							it_ = delta->begin(id);
+							end_ = delta->end(id);
+						} else {
+							it_ = fs.begin(id);
+							end_ = fs.end(id);
+						}
+					}
+
+					candidates(const facts& fs, const facts::delta_type* delta,
+							   size_t delta_cond, size_t k, functionId id,
+							   size_t pos, const expression& value) : v_(0), i_(0)
+					{
+						if (delta && k == delta_cond) {
+							it_ = delta->begin(id);
+							end_ = delta->end(id);
+						} else
+							v_ = &fs.find(id, pos, value);
+					}
+
+					bool next(const function_call*& f)
+					{
+						if (v_) {
+							if (i_ == v_->size())
+								return false;
+							f = &*(*v_)[i_++];
+							return true;
+						}
+
+						if (it_ == end_)
+							return false;
+						f = &*it_++;
+						return true;
+					}
+			};
+
+			/* Inlined version of the check of a constant argument of a condition */
+			template <typename T>
+			inline bool is_constant(const expression& e, const T& value)
+			{
+				const Constant<T>* c = boost::get<Constant<T> >(&e.expr);
+				return c && c->value == value;
+			}
+
+			inline bool same(const expression& e1, const expression& e2)
+			{
+				return compare(e1, e2) == 0;
+			}
+		}
+	}
+}
+
+#endif /* _LOGIC_NATIVE_RULE_HH_ */
@@ -0,0 +1,196 @@
+#ifndef _LOGIC_RETE_HH_
+#define _LOGIC_RETE_HH_
+
+#include <logic/facts.hh>
+#include <logic/rules.hh>
+#include <logic/unify.hh>
+
+#include <map>
+#include <vector>
+
+namespace hyper {
+	namespace logic {
+		class rete_memory;
+
+		/*
+		 * Rete network for the forward chaining (see rete_chaining).
+		 *
+		 * Each rule condition is tested by an alpha node, shared between
+		 * the conditions with the same shape (same function, same constants,
+		 * same repeated variables). The rules are then compiled as chains of
+		 * beta nodes, one per condition, which join the partial matches of
+		 * the previous conditions with the facts of the alpha node. Rules
+		 * with the same first conditions share the same beta nodes.
+		 *
+		 * The network only depends on the rules, the facts and the partial
+		 * matches are stored in a rete_memory, one for each facts_ctx.
+		 */
+		class rete_network {
+			public:
+				/* A new match for the rule number rule */
+				struct match {
+					size_t rule;
+					substitution s;
+				};
+				typedef std::vector<match> matchV;
+
+			private:
+				struct alpha_node {
+					functionId id;
+					function_call pattern;
+					/*
+					 * a condition with a nested function_call is never
+					 * unified (see unify)
+					 */
+					bool never;
+					/* beta nodes fed by this node, the deepest first */
+					std::vector<size_t> successors;
+				};
+
+				/*
+				 * Join the tokens of parent with the facts of alpha. A token
+				 * holds the values of vars. For each argument of the
+				 * condition, join_pos is the position in the parent token
+				 * the argument must be equal to, or -1. new_args are the
+				 * arguments which bind a new variable, in the order of vars.
+				 *
+				 * If the condition shares a variable with its parent, the
+				 * memories are indexed on the first one : key_arg is its
+				 * position in the condition, and key_token its position in
+				 * the parent token. Otherwise key_arg is -1.
+				 */
+				struct beta_node {
+					size_t parent;
+					size_t alpha;
+					size_t depth;
+					std::vector<std::string> vars;
+					std::vector<int> join_pos;
+					std::vector<size_t> new_args;
+					int key_arg;
+					int key_token;
+					std::vector<size_t> children;
+					std::vector<size_t> rules;
+				};
+
+				/* for each slot of the rule, the position in the token, or -1 */
+				struct terminal {
+					size_t node;
+					std::vector<int> token_pos;
+				};
+
+				const static size_t root = static_cast<size_t>(-1);
+
+				std::vector<alpha_node> alpha_;
+				std::vector<beta_node> beta_;
+				std::vector<size_t> root_children_;
+				std::map<function_call, size_t> alpha_map_;
+				std::map<std::pair<size_t, function_call>, size_t> beta_map_;
+				/* alpha nodes indexed by the function they test */
+				std::vector<std::vector<size_t> > alpha_by_id_;
+
+				/* indexed by the rule number */
+				std::vector<terminal> terminals_;
+				/* rules without condition, they match once */
+				std::vector<size_t> empty_rules_;
+				size_t nb_rules_;
+
+				size_t get_alpha(const function_call& cond);
+				size_t get_beta(size_t parent, const function_call& cond);
+
+				bool is_valid(const rete_memory& m, const facts& fs) const;
+				void reset(rete_memory& m, const facts& fs, matchV& res) const;
+				void add_fact(rete_memory& m, const function_call& f, matchV& res) const;
+				void right_activate(rete_memory& m, size_t node, const function_call& f,
+									matchV& res) const;
+				void left_activate(rete_memory& m, size_t node, const substitution& token,
+								   matchV& res) const;
+				bool join(size_t node, const substitution& token, const function_call& f,
+						  substitution& new_token) const;
+				void emit(size_t node, const substitution& token, matchV& res) const;
+
+			public:
+				rete_network() : nb_rules_(0) {}
+
+				/*
+				 * Add the rules of rs which are not yet part of the network.
+				 * The rules are numbered by their position in rs. Inconsistency
+				 * rules are not part of the network.
+				 */
+				void compile(const rules& rs);
+
+				size_t nb_rules() const { return nb_rules_; }
+				size_t nb_alpha() const { return alpha_.size(); }
+				size_t nb_beta() const { return beta_.size(); }
+
+				/*
+				 * Feed m with the facts of delta, and append the new matches
+				 * to res. If delta.all is set, or if m is out of date (new
+				 * rules, facts moved by fs), m is rebuilt from all the facts
+				 * of fs, and all the matches are appended to res.
+				 */
+				void update(rete_memory& m, const facts& fs, const facts::delta_type& delta,
+							matchV& res) const;
+		};
+
+		/*
+		 * The state of a rete_network for one facts database. The alpha
+		 * memories refer to the facts of the database, so they are not
+		 * copied. The memories only grow, so a transaction just records
+		 * their size.
+		 *
+		 * For each beta node with a key (see rete_network::beta_node),
+		 * right indexes the facts of its alpha memory on the value of the
+		 * key, and left the tokens of its parent. Both store positions in
+		 * the memories, and the insertions of a transaction are logged to
+		 * be undone by rollback.
+		 */
+		class rete_memory {
+			private:
+				friend class rete_network;
+
+				bool valid;
+				size_t generation;
+				std::vector<std::vector<const function_call*> > alpha;
+				std::vector<std::vector<substitution> > beta;
+
+				typedef std::map<expression, std::vector<size_t> > indexM;
+				std::vector<indexM> right;
+				std::vector<indexM> left;
+
+				struct index_log {
+					bool is_left;
+					size_t node;
+					expression key;
+				};
+				std::vector<index_log> log;
+
+				void index(bool is_left, size_t node, const expression& key, size_t pos);
+
+				/* rebuilt is true if the memory has been reset in the transaction */
+				bool in_transaction;
+				bool rebuilt;
+				bool saved_valid;
+				std::vector<size_t> saved_alpha;
+				std::vector<size_t> saved_beta;
+
+				void clear();
+
+			public:
+				rete_memory() : valid(false), generation(0), in_transaction(false),
+								rebuilt(false), saved_valid(false) {}
+				rete_memory(const rete_memory&) : valid(false), generation(0),
+												  in_transaction(false), rebuilt(false),
+												  saved_valid(false) {}
+				rete_memory& operator=(const rete_memory&) { clear(); return *this; }
+
+				/* force the next update to rebuild the memory */
+				void invalidate() { valid = false; }
+
+				void begin_transaction();
+				void commit();
+				void rollback();
+		};
+	}
+}
+
+#endif /* _LOGIC_RETE_HH_ */
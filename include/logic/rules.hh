@@ -3,6 +3,10 @@
 #define _LOGIC_RULES_HH_ 
 
 #include <logic/expression.hh>
+#include <logic/facts.hh>
+#include <logic/unify.hh>
+
+#include <boost/function.hpp>
 
 #include <iostream>
 #include <vector>
@@ -38,6 +42,27 @@ namespace hyper {
 			 */
 			map_symbol symbol_to_fun;
 
+			/*
+			 * The variables are numbered by their rank in symbols. For each
+			 * argument of each condition (resp. action), the number of the
+			 * variable, or -1 if the argument is not a variable.
+			 */
+			typedef std::vector<std::vector<int> > slots_type;
+			slots_type condition_slots;
+			slots_type action_slots;
+
+			/*
+			 * A native matcher computes the same substitutions than the
+			 * interpreted unification of the conditions of the rule, but
+			 * is compiled for this rule (see logic/native_rule.hh). If delta
+			 * is not null, the condition delta_cond is only unified with
+			 * the facts of delta. The matcher appends the substitutions to
+			 * the last argument. It is empty for interpreted rules.
+			 */
+			typedef boost::function<void (const rule&, const facts&, 
+										  const facts::delta_type*, size_t,
+										  std::vector<substitution>&)> matcher_type;
+			matcher_type matcher;
 		};
 
 		std::ostream& operator << (std::ostream&, const rule&);
@@ -60,6 +85,12 @@ namespace hyper {
 						 const std::vector<function_call>& cond,
 						 const std::vector<function_call>& action);
 
+				/* Add a rule, unified by the native matcher m */
+				bool add(const std::string& identifier,
+						 const std::vector<function_call>& cond,
+						 const std::vector<function_call>& action,
+						 const rule::matcher_type& m);
+
 				const_iterator begin() const { return r_.begin(); }
 				const_iterator end() const { return r_.end(); }
 
@@ -0,0 +1,230 @@
+#ifndef HYPER_LOGIC_TERM_HH_
+#define HYPER_LOGIC_TERM_HH_
+
+#include <hyperConfig.hh>
+
+#include <logic/expression.hh>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/iterator/iterator_adaptor.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace hyper {
+	namespace logic {
+		/*
+		 * A term is the interned form of an expression : equal expressions
+		 * (in the sense of compare) have the same term, so terms are
+		 * compared and hashed as integers. Terms are only meaningful for
+		 * the term_table which has built them.
+		 */
+		typedef boost::uint32_t term;
+
+		/*
+		 * Hash-consing table of the terms of one funcDefList (see
+		 * funcDefList::terms). Symbols (variables and string constants)
+		 * are interned once, and a function_call is a functionId and the
+		 * terms of its arguments, so a term is stored only once whatever
+		 * the number of facts it appears in.
+		 *
+		 * The table is the boundary between the two representations :
+		 * make and find convert an expression into its term,
+		 * to_expression and to_function_call convert it back. Terms are
+		 * never freed, they live as long as their funcDefList.
+		 *
+		 * The table is shared by all the facts databases of an engine,
+		 * which may be used by several threads (see
+		 * engine::parallel_infer), so each call locks it.
+		 */
+		class term_table : public boost::noncopyable
+		{
+			public:
+				enum kind_type { empty_, int_, double_, string_, bool_, variable_, function_ };
+
+			private:
+				struct node {
+					kind_type kind;
+					/* value of int and bool, bits of double, symbol or functionId */
+					boost::uint64_t value;
+					std::vector<term> args;
+
+					node() : kind(empty_), value(0) {}
+
+					bool operator==(const node& n) const {
+						return kind == n.kind && value == n.value && args == n.args;
+					}
+				};
+
+				/* A node being searched, whose arguments are not copied */
+				struct node_ref {
+					kind_type kind;
+					boost::uint64_t value;
+					const term* args;
+					size_t size;
+				};
+
+				struct node_hash {
+					std::size_t operator() (const node& n) const;
+					std::size_t operator() (const node_ref& r) const;
+				};
+
+				struct node_equal {
+					bool operator() (const node_ref& r, const node& n) const;
+				};
+
+				typedef boost::unordered_map<node, term, node_hash> nodeM;
+				typedef boost::unordered_map<std::string, boost::uint32_t> symbolM;
+
+				const funcDefList& funcs;
+				nodeM m;
+				/* the nodes are stored once, in m, whose elements don't move */
+				std::vector<const node*> nodes;
+				symbolM symbols_m;
+				std::vector<const std::string*> symbols;
+				mutable boost::mutex mtx;
+
+				term make_(const expression& e);
+				term make_(const function_call& f);
+				term make_node(const node_ref& r);
+				boost::optional<term> find_node(const node_ref& r) const;
+				boost::optional<term> find_(const expression& e) const;
+				boost::optional<term> find_(const function_call& f) const;
+				expression to_expression_(term t) const;
+				function_call to_function_call_(term t) const;
+
+				friend struct make_term;
+				friend struct find_term;
+
+			public:
+				explicit term_table(const funcDefList& funcs) : funcs(funcs) {}
+
+				/* Return the term of e, adding it to the table if needed */
+				term make(const expression& e);
+				term make(const function_call& f);
+
+				/* Return the term of e, or none if it has never been made */
+				boost::optional<term> find(const expression& e) const;
+				boost::optional<term> find(const function_call& f) const;
+
+				expression to_expression(term t) const;
+				function_call to_function_call(term t) const;
+
+				kind_type kind(term t) const;
+
+				/* Append the terms of the arguments of t to args */
+				void args(term t, std::vector<term>& args) const;
+
+				/* Number of different terms in the table */
+				size_t size() const;
+		};
+
+		/*
+		 * A set of T (expression or function_call), ordered by their term
+		 * : a lookup only walks the searched value once, in the term table,
+		 * and then compares integers. The values are kept along their
+		 * term, so iterating on the set gives back a plain T. A set built
+		 * without term_table is empty, and can only be searched.
+		 */
+		template <typename T>
+		class term_set
+		{
+			public:
+#if HYPER_LOGIC_HASH
+				typedef boost::unordered_map<term, T> map_type;
+#else
+				typedef std::map<term, T> map_type;
+#endif
+
+				class const_iterator : public boost::iterator_adaptor<
+									   const_iterator,
+									   typename map_type::const_iterator,
+									   const T>
+				{
+					public:
+						const_iterator() {}
+						explicit const_iterator(typename map_type::const_iterator it) :
+							const_iterator::iterator_adaptor_(it) {}
+
+						/* the term of the current value */
+						term key() const { return this->base()->first; }
+
+					private:
+						friend class boost::iterator_core_access;
+						const T& dereference() const { return this->base()->second; }
+				};
+				typedef const_iterator iterator;
+
+			private:
+				term_table* terms_;
+				map_type m_;
+
+			public:
+				explicit term_set(term_table* terms = 0) : terms_(terms) {}
+
+				const_iterator begin() const { return const_iterator(m_.begin()); }
+				const_iterator end() const { return const_iterator(m_.end()); }
+
+				size_t size() const { return m_.size(); }
+				bool empty() const { return m_.empty(); }
+#if HYPER_LOGIC_HASH
+				/* a rehash invalidates the iterators */
+				size_t bucket_count() const { return m_.bucket_count(); }
+#endif
+
+				/* Insert v, whose term is t */
+				std::pair<const_iterator, bool> insert(term t, const T& v) {
+					std::pair<typename map_type::iterator, bool> p;
+					p = m_.insert(std::make_pair(t, v));
+					return std::make_pair(const_iterator(p.first), p.second);
+				}
+
+				std::pair<const_iterator, bool> insert(const T& v) {
+					assert(terms_);
+					return insert(terms_->make(v), v);
+				}
+
+				const_iterator find(term t) const { return const_iterator(m_.find(t)); }
+
+				const_iterator find(const T& v) const {
+					if (!terms_)
+						return end();
+					boost::optional<term> t = terms_->find(v);
+					if (!t)
+						return end();
+					return find(*t);
+				}
+
+				size_t count(const T& v) const { return find(v) != end(); }
+
+				void erase(const_iterator it) { m_.erase(it.base()->first); }
+
+				size_t erase(const T& v) {
+					const_iterator it = find(v);
+					if (it == end())
+						return 0;
+					erase(it);
+					return 1;
+				}
+
+				bool operator == (const term_set& s) const {
+					if (m_.size() != s.m_.size())
+						return false;
+					typename map_type::const_iterator it;
+					for (it = m_.begin(); it != m_.end(); ++it)
+						if (s.m_.find(it->first) == s.m_.end())
+							return false;
+					return true;
+				}
+
+				bool operator != (const term_set& s) const { return !(*this == s); }
+		};
+	}
+}
+
+#endif /* HYPER_LOGIC_TERM_HH_ */
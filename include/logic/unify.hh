@@ -6,6 +6,11 @@
 
 #include <logic/expression.hh>
 
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 105800
+#include <boost/container/small_vector.hpp>
+#endif
+
 namespace hyper {
 	namespace logic {
 		typedef std::map<std::string, expression> unifyM;
@@ -27,6 +32,42 @@ namespace hyper {
 		unify_res unify(const function_call& f1, const function_call& f2, const unifyM& ctx);
 
 		std::ostream& operator << (std::ostream& os, const unifyM& m);
+
+		/*
+		 * Substitution for the variables of a rule. The variables of a rule
+		 * are numbered by rules::add (their rank in rule::symbols), and the
+		 * binding of the variable i is stored in the slot i. An unbound
+		 * variable holds an empty expression. Rules have few variables, so
+		 * the slots are stored inline when Boost.Container is available.
+		 */
+#if BOOST_VERSION >= 105800
+		typedef boost::container::small_vector<expression, 8> substitution;
+#else
+		typedef std::vector<expression> substitution;
+#endif
+
+		inline bool is_bound(const expression& e)
+		{
+			return e.expr.which() != 0;
+		}
+
+		/*
+		 * Same thing than unify, but f1 is the condition of a rule, and
+		 * slots[i] is the number of the variable of its argument i, or -1 if
+		 * it is not a variable. s is updated in place, and is undefined if
+		 * the unification fails.
+		 */
+		bool unify(const function_call& f1, const std::vector<int>& slots,
+				   const function_call& f2, substitution& s);
+
+		/*
+		 * Replace the variables of f by their binding in s. symbols is the
+		 * sorted list of the variables of the rule. Unbound variables are
+		 * kept as is.
+		 */
+		function_call substitute(const function_call& f, 
+								 const std::vector<std::string>& symbols,
+								 const substitution& s);
 	}
 }
 
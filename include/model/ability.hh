@@ -21,6 +21,22 @@ namespace hyper {
 
 			boost::asio::io_service io_s;
 
+			/*
+			 * If HYPER_WORKER_THREADS is set, run() starts this number of
+			 * threads on workers_s, which run the logic inferences (see
+			 * logic_layer::async_logic). The other handlers stay in io_s,
+			 * run by a single thread.
+			 */
+			boost::asio::io_service workers_s;
+			size_t nb_workers;
+
+			/*
+			 * If HYPER_PARALLEL_PRECONDITIONS is set, the tasks evaluate
+			 * the preconditions of all their electable recipes at once,
+			 * instead of one after the other (see task::execute)
+			 */
+			bool parallel_preconditions;
+
 			model::discover_root discover;
 			actor_impl* actor;
 
@@ -78,6 +94,7 @@ namespace hyper {
 			protected:
 			void register_name();
 			void start();
+			void run_io_s();
 
 			private:
 			template <typename T>
@@ -3,6 +3,7 @@
 
 #include <deque>
 #include <string>
+#include <vector>
 
 #include <boost/function/function0.hpp>
 #include <boost/function/function1.hpp>
@@ -29,8 +30,19 @@ namespace hyper {
 					task_logic_evaluation which can fullfill #condition */
 			std::set<std::string> task_used; /**< tasks used so far to achieve this state */
 
-			cond_logic_evaluation() {}
-			cond_logic_evaluation(const logic::function_call& condition) : condition(condition) {}
+			/* 
+			 * In streaming mode, the execution of the condition starts as
+			 * soon as it is evaluated, see
+			 * compute_task_tree::stream_execute_cond. exec_waiting are the
+			 * handlers waiting for the end of this execution.
+			 */
+			bool exec_started;
+			boost::optional<bool> exec_res;
+			std::vector<boost::function<void (bool)> > exec_waiting;
+
+			cond_logic_evaluation() : exec_started(false) {}
+			cond_logic_evaluation(const logic::function_call& condition) : 
+				condition(condition), exec_started(false) {}
 
 			bool all_tasks_evaluated() const;
 			bool all_tasks_executed() const;
@@ -44,11 +56,14 @@ namespace hyper {
 			std::vector<cond_logic_evaluation> conds; /**< its requiered condition */
 			boost::optional<bool> res_exec; /**< execution state */
 			std::set<std::string> task_used; /**< tasks used so far to achieve this state */
+			bool rejected; /**< part of a rejected alternative, see cancel_streams */
+			std::vector<logic::function_call> hyps; /**< if chosen on hypothesis,
+					one of them must hold to keep this task, see async_eval_plan */
 
-			task_logic_evaluation() : cond_evaluated(false), res_exec(boost::none) {}
+			task_logic_evaluation() : cond_evaluated(false), res_exec(boost::none), rejected(false) {}
 			task_logic_evaluation(const std::string& name, const cond_logic_evaluation& cond) : 
 				name(name), cond_evaluated(false), res_exec(boost::none),
-				task_used(cond.task_used)
+				task_used(cond.task_used), rejected(false)
 			{
 				task_used.insert(name);
 			}
@@ -80,9 +95,15 @@ namespace hyper {
 		 * false otherwise
 		 *
 		 * The async_execute just execute the previously tree computed. It is
-		 * only valid if it finds a combinaison of tasks. It is probably not
-		 * The Right Way to Do, it is probably more efficient to really mix
-		 * "evaluation / execution". Will do it later.
+		 * only valid if it finds a combinaison of tasks.
+		 *
+		 * If logic_layer::streaming_planner is set, evaluation and
+		 * execution are mixed : as soon as a precondition of a task is
+		 * solved, the execution of its subtree starts, while the following
+		 * preconditions are still evaluated. async_execute then only waits
+		 * for the parts already started. If the task is finally rejected,
+		 * the tasks of its subtree still running are aborted, and the ones
+		 * not started yet are skipped.
 		 */
 		class compute_task_tree {
 			private:
@@ -100,6 +121,19 @@ namespace hyper {
 
 				std::vector<std::string> failed_tasks;
 
+				/* streamed executions not terminated yet, see end_streams */
+				size_t nb_streamed;
+				std::vector<resume_fun> streams_waiting;
+
+				/* validation of a cached tree, see async_eval_plan */
+				size_t expected_fingerprint;
+				std::vector<boost::shared_ptr<task_logic_evaluation> > plan_tasks;
+				std::vector<size_t> plan_fingerprints;
+				size_t pending_plan_tasks;
+				bool plan_error;
+				boost::optional<bool> plan_hyp_res;
+				hyper::network::error_context plan_hyp_err;
+
 			friend struct async_eval_all_preconditions;
 			friend struct async_exec_all_tasks;
 			friend struct async_exec_all_conditions;
@@ -140,6 +174,28 @@ namespace hyper {
 				 */
 				void async_eval_cond(const logic::function_call& f, cb_type cb);
 
+				/**
+				 * reuse a task tree computed previously for the same
+				 * condition (see logic_layer::plan_cache). The preconditions
+				 * of each task of the tree are evaluated again, and the tree
+				 * is only valid if their results match the ones of the
+				 * original computation, compared through a fingerprint, and
+				 * if, for each task chosen on hypothesis, one of these
+				 * hypothesis still holds.
+				 *
+				 * @param plan : a tree returned by plan()
+				 * @param cb : the callback to use when computed
+				 *
+				 * @return nothing. Update #cond_root in success case. 
+				 */
+				void async_eval_plan(const cond_logic_evaluation& plan, cb_type cb);
+
+				/**
+				 * @return a copy of the tree computed by the last
+				 * successful evaluation, without its execution state
+				 */
+				cond_logic_evaluation plan() const;
+
 				/**
 				 * execute a computed tree. The caller must be sure that there
 				 * is a valid tree, i.e. that async_eval_task() or
@@ -189,14 +245,56 @@ namespace hyper {
 
 				void async_eval_constraint(cond_logic_evaluation& cond, cb_type cb);
 
-				void start_eval_constraint(task_logic_evaluation& task, cb_type cb);
-				void handle_eval_constraint(task_logic_evaluation& task, 
+				/* 
+				 * The inference of async_eval_constraint, which may run in a
+				 * worker thread, see logic_layer::async_logic
+				 */
+				struct infer_result {
+					std::set<std::string> unusable_tasks;
+					std::vector<std::string> res;
+					std::vector<logic::engine::plausible_hypothesis> hyps;
+				};
+
+				void infer_constraint(const logic::function_call& condition, 
+									  boost::shared_ptr<infer_result> r);
+				void handle_infer_constraint(cond_logic_evaluation& cond, 
+											 boost::shared_ptr<infer_result> r, cb_type cb);
+
+				void start_eval_constraint(boost::shared_ptr<task_logic_evaluation> task, 
+										   cb_type cb);
+				void handle_eval_constraint(boost::shared_ptr<task_logic_evaluation> task, 
 											  size_t i, bool res,  cb_type cb);
 
+				/* 
+				 * Streaming mode : start the execution of task->conds[i],
+				 * keeping task alive until its end, even if it is rejected
+				 * in between. end_streams calls handler(res) once no streamed
+				 * execution is running anymore, so that the context is
+				 * not released under their feet. A successful evaluation is
+				 * not delayed unless wait_success is set, as the execution
+				 * goes on.
+				 *
+				 * cancel_streams marks the subtree of a rejected task, so
+				 * that its tasks are not started, and aborts the ones
+				 * already running. Their failure is not recorded in
+				 * failed_tasks, so the other alternatives can still use
+				 * them.
+				 */
+				void stream_execute_cond(boost::shared_ptr<task_logic_evaluation> task, size_t i);
+				void handle_stream_execute_cond(boost::shared_ptr<task_logic_evaluation> task,
+												size_t i, bool res);
+				void end_streams(cb_type handler, bool wait_success, bool res);
+				void cancel_streams(task_logic_evaluation& task);
+
 				void async_evaluate_preconditions(task_logic_evaluation&, 
 												 condition_execution_callback );
+				void handle_eval_plan(size_t i, const boost::system::error_code&,
+									  conditionV, cb_type);
+				void async_eval_plan_hypothesis(size_t i, size_t j, cb_type);
+				void handle_eval_plan_hypothesis(size_t i, size_t j, cb_type);
 
 				void async_execute_cond(cond_logic_evaluation& cond, cb_type, bool);
+				void execute_cond(cond_logic_evaluation& cond, cb_type, bool);
 				void async_execute_task(task_logic_evaluation& task, cb_type, bool);
 				void handle_execute_cond(task_logic_evaluation& task, cb_type, bool);
 				void handle_execute_task(cond_logic_evaluation& cond,
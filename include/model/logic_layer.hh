@@ -5,6 +5,7 @@
 
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/placeholders.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/bind.hpp>
 #include <boost/system/error_code.hpp>
 
@@ -86,6 +87,40 @@ namespace hyper {
 
 		struct logic_layer {
 			logic::engine engine;
+			/*
+			 * Serialize the accesses to the engine made by the worker
+			 * threads of the ability, see async_logic
+			 */
+			boost::asio::io_service::strand logic_strand;
+			/* 
+			 * If HYPER_LOGIC_TRACE is set, the calls to the engine are
+			 * recorded in ${HYPER_LOGIC_TRACE}/${ability}.trace, to be
+			 * replayed by bench_logic
+			 */
+			boost::shared_ptr<std::ostream> trace;
+			/*
+			 * Bound the inference of each constraint of compute_task_tree,
+			 * so that a pathological query does not block the agent. They
+			 * are set from HYPER_LOGIC_INFER_TIMEOUT (in ms) and
+			 * HYPER_LOGIC_INFER_MAX_NODES, and are unlimited by default.
+			 */
+			boost::posix_time::time_duration infer_timeout;
+			size_t infer_max_nodes;
+			/*
+			 * If HYPER_STREAMING_PLANNER is set, compute_task_tree starts
+			 * the execution of a subtree as soon as it is evaluated
+			 */
+			bool streaming_planner;
+			/*
+			 * If HYPER_PLAN_CACHE is set, the task tree computed for a
+			 * constraint is kept in plan_cache, and tried first the next
+			 * time the same constraint is not satisfied (typically for an
+			 * ensure). It is dropped, and a full computation done, as soon
+			 * as it is outdated (including when the hypothesis it relies on
+			 * do not hold anymore) or fails.
+			 */
+			bool use_plan_cache;
+			std::map<logic::function_call, cond_logic_evaluation> plan_cache;
 			ability& a_;
 			std::map<std::string, task_ptr> tasks;
 			std::map<std::string, logic_ctx_ptr> running_ctx;
@@ -112,6 +147,13 @@ namespace hyper {
 				engine.add_rule(s, premises, conclusions);
 			}
 
+			void add_rules(const std::string& s, const std::vector<logic::function_call>& premises, 
+												 const std::vector<logic::function_call>& conclusions,
+												 const logic::rule::matcher_type& m)
+			{
+				engine.add_rule(s, premises, conclusions, m);
+			}
+
 			void async_exec(const logic_constraint& ctr, 
 							const std::string& constraint, 
 							const unify_pair_list&, logic_layer_cb cb);
@@ -127,12 +169,32 @@ namespace hyper {
 
 			logic::function_call generate(const logic::function_call& f);
 
+			/* The budget of an inference started now, see infer_timeout */
+			logic::infer_budget infer_budget() const;
+
+			/* 
+			 * Called once the ability has been declared : apply the rules
+			 * added since the creation of the layer, in one pass
+			 */
+			void end_declarations();
+
+			/*
+			 * Call job, an access to the engine, and then handler in
+			 * a_.io_s. If the ability has worker threads (see
+			 * ability::nb_workers), job runs in one of them, in
+			 * logic_strand, so a slow inference does not stall the other
+			 * handlers of the ability. Otherwise both are called directly.
+			 */
+			void async_logic(boost::function<void ()> job, boost::function<void ()> handler);
+
 			private:
 			void handle_unification_computation(const boost::system::error_code& e,
 												logic_ctx_ptr logic_ctx);
 			void handle_exec_computation(const boost::system::error_code&e,
 										 logic_ctx_ptr logic_ctx);
 			void handle_eval_task_tree(bool success, logic_ctx_ptr ptr);
+			void handle_eval_cond_tree(bool success, logic_ctx_ptr ptr);
+			void handle_eval_cached_tree(bool success, logic_ctx_ptr ptr);
 			void handle_exec_task_tree(bool success, logic_ctx_ptr ptr);
 			void handle_success(logic_ctx_ptr ptr);
 			void handle_failure(logic_ctx_ptr ptr, const boost::system::error_code&);
@@ -51,6 +51,14 @@ namespace hyper {
 				bool must_interrupt;
 				bool must_pause;
 
+				/* 
+				 * Number of recipes whose preconditions are being
+				 * evaluated, and if one of them has failed, when they are
+				 * evaluated in parallel
+				 */
+				size_t pending_recipes;
+				bool recipe_error;
+
 			private:
 				std::vector<ctx_cb> pending_cb;
 
@@ -69,7 +77,8 @@ namespace hyper {
 			public:
 				task(ability& a_, const std::string& name_) 
 					: a(a_), name(name_), is_running(false), executing_recipe(false),
-										  must_interrupt(false), must_pause(false) 
+										  must_interrupt(false), must_pause(false),
+										  pending_recipes(0), recipe_error(false)
 				{}
 
 				void add_recipe(recipe_ptr ptr);
@@ -92,6 +101,9 @@ namespace hyper {
 				void handle_execute(boost::optional<hyper::network::runtime_failure>);
 				void handle_final_postcondition_handle(const boost::system::error_code&, conditionV failed);
 				void async_evaluate_recipe_preconditions(const boost::system::error_code&, conditionV, size_t i);
+				void async_evaluate_all_recipe_preconditions();
+				void handle_recipe_preconditions(const boost::system::error_code&, conditionV, size_t i);
+				void select_recipe();
 				void end_execute(bool res);
 		};
 	}
@@ -0,0 +1,356 @@
+#include <compiler/native_rule_output.hh>
+#include <compiler/expression_ast.hh>
+#include <compiler/output.hh>
+#include <compiler/rules_def_parser.hh>
+
+#include <cassert>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <boost/variant/apply_visitor.hpp>
+
+using namespace hyper::compiler;
+
+namespace {
+
+	/*
+	 * Collect the variables of a rule. They are numbered by the logic
+	 * engine in their lexical order (rule::symbols), so a sorted set gives
+	 * the same numbering.
+	 */
+	struct collect_symbols : public boost::static_visitor<void>
+	{
+		std::set<std::string>& s;
+
+		collect_symbols(std::set<std::string>& s) : s(s) {}
+
+		template <typename T>
+		void operator() (const T&) const {}
+
+		void operator() (const std::string& sym) const { s.insert(sym); }
+
+		void operator() (const expression_ast& e) const
+		{
+			boost::apply_visitor(*this, e.expr);
+		}
+
+		void operator() (const function_call& f) const
+		{
+			for (size_t i = 0; i < f.args.size(); ++i)
+				boost::apply_visitor(*this, f.args[i].expr);
+		}
+
+		void operator() (const binary_op& op) const
+		{
+			boost::apply_visitor(*this, op.left.expr);
+			boost::apply_visitor(*this, op.right.expr);
+		}
+
+		void operator() (const unary_op& op) const
+		{
+			boost::apply_visitor(*this, op.subject.expr);
+		}
+	};
+
+	/*
+	 * An argument of a premise, as seen by the native matcher : a variable,
+	 * a constant, or something it can't deal with.
+	 */
+	struct native_arg {
+		enum kind_type { variable, constant, unsupported };
+		kind_type kind;
+		std::string value; // the variable name, or the C++ literal
+		std::string type;  // the C++ type of the constant
+
+		native_arg() : kind(unsupported) {}
+	};
+
+	struct compute_native_arg : public boost::static_visitor<native_arg>
+	{
+		template <typename T>
+		native_arg operator() (const T&) const { return native_arg(); }
+
+		native_arg constant(const std::string& type, const std::string& value) const
+		{
+			native_arg res;
+			res.kind = native_arg::constant;
+			res.type = type;
+			res.value = value;
+			return res;
+		}
+
+		native_arg operator() (const Constant<int>& c) const
+		{
+			std::ostringstream oss;
+			oss << c.value;
+			return constant("int", oss.str());
+		}
+
+		/* Same representation than generate_logic_expression */
+		native_arg operator() (const Constant<double>& c) const
+		{
+			std::ostringstream oss;
+			oss.precision(6);
+			oss << std::fixed << c.value;
+			return constant("double", oss.str());
+		}
+
+		native_arg operator() (const Constant<std::string>& c) const
+		{
+			return constant("std::string", "\"" + c.value + "\"");
+		}
+
+		native_arg operator() (const Constant<bool>& c) const
+		{
+			return constant("bool", c.value ? "true" : "false");
+		}
+
+		native_arg operator() (const std::string& s) const
+		{
+			native_arg res;
+			res.kind = native_arg::variable;
+			res.value = s;
+			return res;
+		}
+
+		native_arg operator() (const expression_ast& e) const
+		{
+			return boost::apply_visitor(*this, e.expr);
+		}
+
+		native_arg operator() (const unary_op& op) const
+		{
+			return boost::apply_visitor(*this, op.subject.expr);
+		}
+	};
+
+	typedef std::vector<native_arg> native_premise;
+
+	/*
+	 * Compute the arguments of a premise. Returns false if the premise is
+	 * not a predicate
+	 */
+	struct compute_native_premise : public boost::static_visitor<bool>
+	{
+		native_premise& res;
+
+		compute_native_premise(native_premise& res) : res(res) {}
+
+		template <typename T>
+		bool operator() (const T&) const { return false; }
+
+		bool operator() (const expression_ast& e) const
+		{
+			return boost::apply_visitor(*this, e.expr);
+		}
+
+		bool operator() (const unary_op& op) const
+		{
+			return boost::apply_visitor(*this, op.subject.expr);
+		}
+
+		bool operator() (const function_call& f) const
+		{
+			for (size_t i = 0; i < f.args.size(); ++i)
+				res.push_back(boost::apply_visitor(compute_native_arg(), f.args[i].expr));
+			return true;
+		}
+
+		bool operator() (const binary_op& op) const
+		{
+			res.push_back(boost::apply_visitor(compute_native_arg(), op.left.expr));
+			res.push_back(boost::apply_visitor(compute_native_arg(), op.right.expr));
+			return true;
+		}
+	};
+
+	bool compute_premises(const rule_decl& r, std::vector<native_premise>& premises)
+	{
+		if (r.premises.empty())
+			return false;
+
+		premises.resize(r.premises.size());
+		for (size_t i = 0; i < r.premises.size(); ++i) {
+			if (!boost::apply_visitor(compute_native_premise(premises[i]), r.premises[i].expr))
+				return false;
+			for (size_t j = 0; j < premises[i].size(); ++j)
+				if (premises[i][j].kind == native_arg::unsupported)
+					return false;
+		}
+
+		return true;
+	}
+
+	size_t nb_known_args(const native_premise& p, const std::set<std::string>& bound)
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < p.size(); ++i)
+			if (p[i].kind == native_arg::constant || bound.count(p[i].value))
+				res++;
+		return res;
+	}
+
+	/*
+	 * Static version of the ordering of the engine : start by the premise
+	 * first, and then prefer the premises with the more known arguments.
+	 */
+	std::vector<size_t> order_premises(const std::vector<native_premise>& premises, size_t first)
+	{
+		std::vector<size_t> order(1, first);
+		std::vector<bool> done(premises.size(), false);
+		std::set<std::string> bound;
+
+		while (true) {
+			size_t current = order.back();
+			done[current] = true;
+			for (size_t i = 0; i < premises[current].size(); ++i)
+				if (premises[current][i].kind == native_arg::variable)
+					bound.insert(premises[current][i].value);
+
+			if (order.size() == premises.size())
+				return order;
+
+			size_t best = premises.size();
+			for (size_t i = 0; i < premises.size(); ++i) {
+				if (done[i])
+					continue;
+				if (best == premises.size() ||
+					nb_known_args(premises[i], bound) > nb_known_args(premises[best], bound))
+					best = i;
+			}
+			order.push_back(best);
+		}
+	}
+
+	struct dump_nest
+	{
+		std::ostream& oss;
+		const std::vector<native_premise>& premises;
+		const std::map<std::string, size_t>& slots;
+		std::map<std::string, std::string> bound;
+
+		dump_nest(std::ostream& oss, const std::vector<native_premise>& premises,
+				  const std::map<std::string, size_t>& slots) :
+			oss(oss), premises(premises), slots(slots) {}
+
+		void dump_candidates(const std::string& indent, size_t k)
+		{
+			const native_premise& p = premises[k];
+			oss << indent << "logic::native::candidates c" << k;
+			oss << "(fs, delta, delta_cond, " << k << ", r.condition[" << k << "].id";
+			for (size_t i = 0; i < p.size(); ++i) {
+				if (p[i].kind == native_arg::constant) {
+					oss << ", " << i << ", r.condition[" << k << "].args[" << i << "]";
+					break;
+				}
+				std::map<std::string, std::string>::const_iterator it = bound.find(p[i].value);
+				if (it != bound.end()) {
+					oss << ", " << i << ", " << it->second;
+					break;
+				}
+			}
+			oss << ");\n";
+		}
+
+		void operator() (const std::vector<size_t>& order, size_t level, const std::string& indent)
+		{
+			if (level == order.size()) {
+				oss << indent << "logic::substitution s(" << slots.size() << ");\n";
+				std::map<std::string, std::string>::const_iterator it;
+				for (it = bound.begin(); it != bound.end(); ++it) {
+					std::map<std::string, size_t>::const_iterator it_slot = slots.find(it->first);
+					oss << indent << "s[" << it_slot->second << "] = " << it->second << ";\n";
+				}
+				oss << indent << "res.push_back(s);\n";
+				return;
+			}
+
+			size_t k = order[level];
+			const native_premise& p = premises[k];
+			dump_candidates(indent, k);
+			oss << indent << "const logic::function_call* f" << k << ";\n";
+			oss << indent << "while (c" << k << ".next(f" << k << ")) {\n";
+
+			std::string inner = indent + "\t";
+			std::vector<std::string> new_vars;
+			for (size_t i = 0; i < p.size(); ++i) {
+				std::ostringstream arg;
+				arg << "f" << k << "->args[" << i << "]";
+				if (p[i].kind == native_arg::constant) {
+					oss << inner << "if (!logic::native::is_constant<" << p[i].type << ">(";
+					oss << arg.str() << ", " << p[i].value << ")) continue;\n";
+					continue;
+				}
+
+				std::map<std::string, std::string>::const_iterator it = bound.find(p[i].value);
+				if (it != bound.end()) {
+					oss << inner << "if (!logic::native::same(" << arg.str() << ", ";
+					oss << it->second << ")) continue;\n";
+					continue;
+				}
+
+				std::ostringstream var;
+				var << "v" << slots.find(p[i].value)->second;
+				oss << inner << "const logic::expression& " << var.str() << " = " << arg.str() << ";\n";
+				bound[p[i].value] = var.str();
+				new_vars.push_back(p[i].value);
+			}
+
+			(*this)(order, level + 1, inner);
+			oss << indent << "}\n";
+
+			for (size_t i = 0; i < new_vars.size(); ++i)
+				bound.erase(new_vars[i]);
+		}
+	};
+}
+
+namespace hyper {
+	namespace compiler {
+		bool has_native_matcher(const rule_decl& r)
+		{
+			std::vector<native_premise> premises;
+			return compute_premises(r, premises);
+		}
+
+		void dump_native_matcher(std::ostream& oss, const rule_decl& r, const std::string& name)
+		{
+			std::vector<native_premise> premises;
+			bool valid = compute_premises(r, premises);
+			assert(valid);
+			(void) valid;
+
+			std::set<std::string> symbols;
+			for (size_t i = 0; i < r.premises.size(); ++i)
+				boost::apply_visitor(collect_symbols(symbols), r.premises[i].expr);
+			for (size_t i = 0; i < r.conclusions.size(); ++i)
+				boost::apply_visitor(collect_symbols(symbols), r.conclusions[i].expr);
+
+			std::map<std::string, size_t> slots;
+			for (std::set<std::string>::const_iterator it = symbols.begin(); it != symbols.end(); ++it)
+				slots.insert(std::make_pair(*it, slots.size()));
+
+			oss << "\t\t\t/* native matcher for rule " << r.name << " */\n";
+			oss << "\t\t\tvoid " << name << "(const logic::rule& r, const logic::facts& fs,\n";
+			oss << "\t\t\t\t\tconst logic::facts::delta_type* delta, size_t delta_cond,\n";
+			oss << "\t\t\t\t\tstd::vector<logic::substitution>& res)\n";
+			oss << "\t\t\t{\n";
+			oss << "\t\t\t\tassert(r.symbols.size() == " << slots.size() << ");\n";
+			oss << "\t\t\t\tswitch (delta ? delta_cond : 0) {\n";
+
+			/*
+			 * One nest for each premise, starting by it, so that the delta
+			 * premise is always the outer loop
+			 */
+			for (size_t i = 0; i < premises.size(); ++i) {
+				oss << "\t\t\t\t\tcase " << i << ": {\n";
+				dump_nest(oss, premises, slots)(order_premises(premises, i), 0, "\t\t\t\t\t\t");
+				oss << "\t\t\t\t\t\tbreak;\n";
+				oss << "\t\t\t\t\t}\n";
+			}
+			oss << "\t\t\t\t}\n";
+			oss << "\t\t\t}\n\n";
+		}
+	}
+}
@@ -8,6 +8,7 @@
 #include <compiler/ability_parser.hh>
 #include <compiler/extension.hh>
 #include <compiler/logic_expression_output.hh>
+#include <compiler/native_rule_output.hh>
 #include <compiler/output.hh>
 #include <compiler/universe.hh>
 #include <compiler/scope.hh>
@@ -809,15 +810,30 @@ struct dump_rule {
 	}
 };
 
+/*
+ * The name of the native matcher of the rule i, if any
+ */
+std::string native_matcher_name(const std::vector<rule_decl>& rules, size_t i, bool native)
+{
+	if (!native || !has_native_matcher(rules[i]))
+		return "";
+
+	std::ostringstream oss;
+	oss << "native_matcher_" << i;
+	return oss.str();
+}
+
 struct output_logic_rules {
 	std::ostream& oss;
 	const ability& a;
 	const universe& u;
+	std::string matcher;
 
 	output_logic_rules(std::ostream& oss,
 					   const ability &a,
-					   const universe& u) : 
-		oss(oss), a(a), u(u) {}
+					   const universe& u,
+					   const std::string& matcher = "") : 
+		oss(oss), a(a), u(u), matcher(matcher) {}
 
 	void operator() (const rule_decl& r) {
 		oss << "\t\t\t\ta.logic().add_rules(" << quoted_string(r.name) << ",\n";
@@ -828,13 +844,17 @@ struct output_logic_rules {
 			std::for_each(r.premises.begin(), r.premises.end(), dump_rule(oss, a, u));
 			oss << ",\n";
 		};
-		if (r.conclusions.empty()) 
-			oss << "\t\t\t\t\tstd::vector<std::string>());\n";
+		if (r.conclusions.empty() && !matcher.empty())
+			oss << "\t\t\t\t\tstd::vector<logic::function_call>()";
+		else if (r.conclusions.empty()) 
+			oss << "\t\t\t\t\tstd::vector<std::string>()";
 		else {
 			oss << "\t\t\t\t\tboost::assign::list_of";
 			std::for_each(r.conclusions.begin(), r.conclusions.end(), dump_rule(oss, a, u));
-			oss << ");\n";
 		};
+		if (!matcher.empty())
+			oss << ",\n\t\t\t\t\t&" << matcher;
+		oss << ");\n";
 	}
 };
 
@@ -851,7 +871,8 @@ struct import_types {
 };
 
 void
-universe::dump_ability_import_module_impl(std::ostream& oss, const std::string& name) const
+universe::dump_ability_import_module_impl(std::ostream& oss, const std::string& name,
+										  bool native_rules) const
 {
 	abilityMap::const_iterator it = abilities.find(name);
 	if (it == abilities.end()) {
@@ -861,23 +882,34 @@ universe::dump_ability_import_module_impl(std::ostream& oss, const std::string&
 
 	oss << "#include <" << name << "/import.hh>\n\n";
 	oss << "#include <model/logic_layer_impl.hh>\n\n";
+	if (native_rules)
+		oss << "#include <logic/native_rule.hh>\n\n";
 	oss << "#include <boost/assign/list_of.hpp>\n\n";
 
 	//find functions prefixed by name::
 	std::vector<functionDef>  funcs = fList.select(select_ability_funs(name));
 
+	std::vector<rule_decl> rules; 
+	hyper::utils::copy_if(rList.l.begin(), rList.l.end(), std::back_inserter(rules), 
+						  is_local_rules(name));
+
 	namespaces n(oss, name);
+
+	for (size_t i = 0; i < rules.size(); ++i) {
+		std::string matcher = native_matcher_name(rules, i, native_rules);
+		if (!matcher.empty())
+			dump_native_matcher(oss, rules[i], matcher);
+	}
+
 	oss << "\t\t\tvoid import_funcs(model::ability &a) {" << std::endl;
 	std::vector<type> types = tList.select(import_types(name));
 
 	std::for_each(types.begin(), types.end(), output_logic_type(oss));
 	std::for_each(funcs.begin(), funcs.end(), output_import_helper(oss, *this));
 
-	std::vector<rule_decl> rules; 
-	hyper::utils::copy_if(rList.l.begin(), rList.l.end(), std::back_inserter(rules), 
-						  is_local_rules(name));
-
-	std::for_each(rules.begin(), rules.end(), output_logic_rules(oss, *it->second, *this));
+	for (size_t i = 0; i < rules.size(); ++i) 
+		output_logic_rules(oss, *it->second, *this, 
+						   native_matcher_name(rules, i, native_rules))(rules[i]);
 
 	oss << "\t\t\t}" << std::endl;
 }
@@ -336,6 +336,7 @@ int main(int argc, char** argv)
 		("extension,e", po::value <std::vector<std::string> >(),
 		 "extension")
 		("initial,i", "initial files for user_defined function / type")
+		("native-rules,n", "generate native matchers for the logic rules")
 		("output,o", po::value<std::string>(), "output generated file")
 		("version", "print the version of the hyper compiler")
 		("input-file", po::value< std::string >(), "input file")
@@ -524,7 +525,8 @@ int main(int argc, char** argv)
 			{ 
 				std::string fileName = directoryName + "/import.cc";
 				std::ofstream oss(fileName.c_str());
-				u.dump_ability_import_module_impl(oss, abilityName);
+				u.dump_ability_import_module_impl(oss, abilityName, 
+												  vm.count("native-rules") != 0);
 			}
 		}
 	}
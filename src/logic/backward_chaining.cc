@@ -7,6 +7,7 @@
 #include <boost/bimap/bimap.hpp>
 #include <boost/fusion/include/std_pair.hpp> 
 #include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
 
 
 namespace phx = boost::phoenix;
@@ -14,133 +15,125 @@ namespace phx = boost::phoenix;
 namespace {
 	using namespace hyper::logic;
 
-	/*
-	 * Really generate a fact from an expression and a unification map
-	 */
-	struct do_unification : public boost::static_visitor<expression>
-	{
-		const unifyM& m;
+	struct generate_inferred_fact{
+		const rule::list_symbols& symbols;
+		const substitution& m;
 
-		do_unification(const unifyM& m_) : m(m_) {}
+		generate_inferred_fact(const rule::list_symbols& symbols, const substitution& m_) : 
+			symbols(symbols), m(m_) {}
 
-		template <typename T> 
-		expression operator() (const T& t) const
+		function_call operator() (const function_call& f) 
 		{
-			return t;
+			return substitute(f, symbols, m);
 		}
+	};
 
-		expression operator() (const std::string& s) const
-		{
-			unifyM::const_iterator it = m.find(s);
-			if (it == m.end()) 
-				return s; // maybe assert(false) here
-			return it->second;
-		}
+	struct no_candidate {};
 
-		expression operator() (const function_call& f) const
-		{
-			function_call res(f, true);
-            for (size_t i = 0; i < f.args.size(); ++i)
-                res.args[i] = boost::apply_visitor(do_unification(m), f.args[i].expr);
-			return res;
-		}
-	};
+	/* Collect the numbers of the variables of an expression */
+	struct condition_symbols : public boost::static_visitor<void>
+	{
+		const rule::list_symbols& symbols;
+		std::set<size_t>& res;
 
-	struct generate_inferred_fact{
-		const unifyM& m;
+		condition_symbols(const rule::list_symbols& symbols, std::set<size_t>& res) :
+			symbols(symbols), res(res) {}
 
-		generate_inferred_fact(const unifyM& m_) : m(m_) {}
+		template <typename T>
+		void operator() (const T&) const {}
 
-		function_call operator() (const function_call& f) 
+		void operator() (const std::string& s) const
 		{
-			function_call res(f, true);
-            for (size_t i = 0; i < f.args.size(); ++i)
-                res.args[i] = boost::apply_visitor(do_unification(m), f.args[i].expr);
-			return res;
+			rule::list_symbols::const_iterator it;
+			it = std::lower_bound(symbols.begin(), symbols.end(), s);
+			assert(it != symbols.end() && *it == s);
+			res.insert(it - symbols.begin());
 		}
-	};
 
-	struct no_candidate {};
+		void operator() (const function_call& f) const
+		{
+			std::vector<expression>::const_iterator it;
+			for (it = f.args.begin(); it != f.args.end(); ++it)
+				boost::apply_visitor(*this, it->expr);
+		}
+	};
 
+	/*
+	 * The candidates for the unbound variables of a rule. The variables
+	 * are bound one by one, from the last unbound one to the first one, so
+	 * that the complete bindings come in the order of the cartesian
+	 * product of the candidates, the first variable changing first.
+	 *
+	 * checks[i] are the conditions which become fully bound once
+	 * unbounded[i] is bound, and checks[unbounded.size()] the conditions
+	 * bound by the goal itself. A partial binding can be checked against
+	 * these conditions before binding the next variable (see
+	 * generate_node::bind).
+	 */
 	struct unifyM_candidate 
 	{
-		const std::set<std::string>& unbounded;
+		const std::vector<size_t>& unbounded;
 		const facts_ctx::expressionM& possible_symbol;
-		std::vector<std::string> v_symbol;
 
 		struct iter {
 			facts_ctx::expressionS::const_iterator begin;
 			facts_ctx::expressionS::const_iterator end;
-			facts_ctx::expressionS::const_iterator current;
 		};
 
 		std::vector<iter> v;
+		std::vector<std::vector<size_t> > checks;
 
 		/* Throw a no_candidate exception if we don't have any candidate for
 		 * one symbol. It means that the unification can't lead to any
 		 * succesful result
 		 */
-		unifyM_candidate(const std::set<std::string>& unbounded_,
+		unifyM_candidate(const std::vector<size_t>& unbounded_,
+						 const rule& r,
 						 const facts_ctx::expressionM& possible_symbol_):
-			unbounded(unbounded_), possible_symbol(possible_symbol_)
+			unbounded(unbounded_), possible_symbol(possible_symbol_),
+			checks(unbounded_.size() + 1)
 		{
-			std::copy(unbounded.begin(), unbounded.end(), std::back_inserter(v_symbol));
-			for (size_t i = 0; i < v_symbol.size(); ++i) {
-				facts_ctx::expressionM::const_iterator it = possible_symbol.find(v_symbol[i]);
+			for (size_t i = 0; i < unbounded.size(); ++i) {
+				facts_ctx::expressionM::const_iterator it = 
+					possible_symbol.find(r.symbols[unbounded[i]]);
 				assert(it != possible_symbol.end());
 				iter current;
-				current.begin = it->second.begin();
-				current.end = it->second.end();
+				current.begin = it->second->begin();
+				current.end = it->second->end();
 				if (current.begin == current.end)
 					throw no_candidate();
-				current.current = current.begin;
 				v.push_back(current);
 			}
-		}
 
-		/* 
-		 * Compute the next possible combinaison, returns false if it is the
-		 * last one */
-		bool next(unifyM &m)
-		{
-			// generate the current solution
-			for (size_t i = 0; i < v_symbol.size(); ++i)
-				m[v_symbol[i]] = *v[i].current;
-
-			// next one
-			size_t i = 0;
-			bool add = true;
-
-			while (add && i < v_symbol.size()) {
-				++v[i].current;
-				if (v[i].current == v[i].end) {
-					v[i].current = v[i].begin;
-					++i;
-					add = true;
-				} else {
-					add = false;
-				}
-			}
+			for (size_t k = 0; k < r.condition.size(); ++k) {
+				std::set<size_t> symbols;
+				condition_symbols(r.symbols, symbols)(r.condition[k]);
 
-			return !add;
+				size_t bound_at = unbounded.size();
+				for (size_t i = 0; i < unbounded.size() && bound_at == unbounded.size(); ++i)
+					if (symbols.find(unbounded[i]) != symbols.end())
+						bound_at = i;
+				checks[bound_at].push_back(k);
+			}
 		}
 	};
 
 	struct apply_goal_unification 
 	{
 		const function_call &f;
-		std::vector<unifyM>& unify_vect;
+		const rule& r;
+		std::vector<substitution>& unify_vect;
 
-		apply_goal_unification(const function_call& f_, std::vector<unifyM>& unify_vect_):
-			f(f_), unify_vect(unify_vect_)
+		apply_goal_unification(const function_call& f_, const rule& r,
+							   std::vector<substitution>& unify_vect_):
+			f(f_), r(r), unify_vect(unify_vect_)
 		{}
 
-		void operator() (const function_call& f_rule)
+		void operator() (size_t action)
 		{
-			unifyM m;
-			unify_res r = unify(f_rule, f, m);
-			if (r.first)
-				unify_vect.push_back(r.second);
+			substitution m(r.symbols.size());
+			if (unify(r.action[action], r.action_slots[action], f, m))
+				unify_vect.push_back(m);
 		}
 	};
 }
@@ -227,6 +220,28 @@ namespace hyper { namespace logic {
 		return current;
 	}
 
+	facts_ctx& proof_tree::scratch_ctx()
+	{
+		if (!scratch)
+			scratch.reset(new facts_ctx(ctx));
+		return *scratch;
+	}
+
+	const std::vector<function_call>& proof_tree::known_facts(functionId id)
+	{
+		known_factsM::iterator it = known_facts_.find(id);
+		if (it != known_facts_.end())
+			return it->second;
+
+		std::vector<function_call>& res = known_facts_[id];
+		facts::const_iterator it_f;
+		for (it_f = ctx.f.begin(id); it_f != ctx.f.end(id); ++it_f) {
+			std::vector<function_call> v = ctx.f.generate_all(*it_f);
+			res.insert(res.end(), v.begin(), v.end());
+		}
+		return res;
+	}
+
 	void proof_tree::compute_node_state(node& n) 
 	{
 		bm_hyp_type::left_iterator it;
@@ -246,7 +261,13 @@ namespace hyper { namespace logic {
 			}
 
 			if (hyp.state == not_proven_not_explored) {
-				boost::logic::tribool b = ctx.f.matches(hyp.f);
+				boost::optional<bool> tabled = ctx.table_find(hyp.f);
+				boost::logic::tribool b = boost::logic::indeterminate;
+				if (tabled)
+					b = *tabled;
+				else
+					b = ctx.f.matches(hyp.f);
+
 				if (!boost::logic::indeterminate(b)) {
 					if (b)
 						hyp.state = proven_true;
@@ -259,11 +280,15 @@ namespace hyper { namespace logic {
 					bm_hyp_type::right_iterator it3 = bm_hyp.project_right(it);
 					bm_hyp.right.replace_key(it3, hyp);
 				} else {
-					facts_ctx current_facts = ctx;
-					current_facts.add(hyp.f);
-					if (!is_world_consistent(rs, current_facts)) {
+					facts_ctx& current = scratch_ctx();
+					current.begin_transaction();
+					current.add(hyp.f);
+					bool consistent = is_world_consistent(rs, current);
+					current.rollback();
+					if (!consistent) {
 						n.state = proven_false;
 						hyp.state = proven_false;
+						ctx.table_insert(hyp.f, false);
 					}
 					
 					all_true = false;
@@ -279,6 +304,23 @@ namespace hyper { namespace logic {
 			n.state = proven_true;
 	}
 
+	bool proof_tree::is_refuted(const function_call& f) 
+	{
+		bm_hyp_type::right_const_iterator it = bm_hyp.right.find(hypothesis(f));
+		if (it != bm_hyp.right.end() && it->first.state != not_proven_not_explored)
+			return (it->first.state == proven_false || 
+					it->first.state == not_proven_exploring);
+
+		boost::optional<bool> tabled = ctx.table_find(f);
+		if (tabled)
+			return !*tabled;
+
+		boost::logic::tribool b = ctx.f.matches(f);
+		if (!b)
+			return true;
+		return false;
+	}
+
 	struct choose_hypothesis {
 		const proof_tree& t;
 
@@ -331,6 +373,18 @@ namespace hyper { namespace logic {
 	}
 
 	struct found_solution {};
+	struct budget_exhausted {};
+
+	bool proof_tree::new_node()
+	{
+		if (!exhausted && budget.exhausted(nb_nodes))
+			exhausted = true;
+		if (exhausted)
+			return false;
+
+		nb_nodes++;
+		return true;
+	}
 
 	struct generate_node {
 		facts_ctx& ctx;
@@ -343,65 +397,176 @@ namespace hyper { namespace logic {
 			ctx(ctx), t(t), f(f), v(v)
 		{}
 
-		void operator() (const rule& r) const 
+		/* 
+		 * Returns true if one of the conditions conds of r, fully bound
+		 * by m, is already known to be false
+		 */
+		bool refuted(const rule& r, const substitution& m,
+					 const std::vector<size_t>& conds) const
 		{
-			std::vector<unifyM> unify_vect;
+			for (size_t k = 0; k < conds.size(); ++k)
+				if (t.is_refuted(substitute(r.condition[conds[k]], r.symbols, m)))
+					return true;
+			return false;
+		}
 
-			std::for_each(r.action.begin(), r.action.end(),
-						  apply_goal_unification(f, unify_vect));
+		void add_node(const rule& r, const substitution& m) const
+		{
+			std::vector<function_call> v_f;
+			std::transform(r.condition.begin(), r.condition.end(),
+					std::back_inserter(v_f),
+					generate_inferred_fact(r.symbols, m));
 
-			if (unify_vect.empty())
+			add_node(r.identifier, v_f);
+		}
+
+		void add_node(const rule::identifier_type& identifier, 
+					  const std::vector<function_call>& v_f) const
+		{
+			if (!t.new_node())
+				throw budget_exhausted();
+
+			node n;
+			std::vector<hypothesis_id> ids(v_f.size());
+			t.add_hypothesis_to_node(n, v_f.begin(), v_f.end(), ids.begin());
+			t.compute_node_state(n);
+			if (n.state != proven_false) 
+				v.push_back(std::make_pair(identifier, n));
+
+			if (n.state == proven_true) 
+				throw found_solution();
+		}
+
+		/*
+		 * Bind the unbound variables candidates.unbounded[0 .. depth - 1],
+		 * the last one first. Once a condition is fully bound, the partial
+		 * binding is dropped if this condition is known to be false : all
+		 * its completions would only lead to proven_false nodes.
+		 */
+		void bind(const rule& r, const unifyM_candidate& candidates,
+				  substitution& m, size_t depth) const
+		{
+			if (depth == 0) {
+				add_node(r, m);
 				return;
+			}
 
-			typedef std::set<std::string> set_symbols;
-			typedef std::vector<set_symbols> vector_set_symbols;
+			size_t i = depth - 1;
+			facts_ctx::expressionS::const_iterator it;
+			for (it = candidates.v[i].begin; it != candidates.v[i].end; ++it) {
+				m[candidates.unbounded[i]] = *it;
+				if (!refuted(r, m, candidates.checks[i]))
+					bind(r, candidates, m, i);
+			}
+		}
 
-			/* for each bound map, list each bounded key */
-			vector_set_symbols bounded_symbols(unify_vect.size());
-			for (size_t i = 0; i < unify_vect.size(); ++i) 
-				std::transform(unify_vect[i].begin(), unify_vect[i].end(),
-							   std::inserter(bounded_symbols[i], bounded_symbols[i].begin()),
-							   phx::at_c<0>(phx::arg_names::arg1));
+		void operator() (const rule& r) const 
+		{
+			std::vector<substitution> unify_vect;
+
+			apply_goal_unification apply(f, r, unify_vect);
+			for (size_t i = 0; i < r.action.size(); ++i)
+				apply(i);
+
+			if (unify_vect.empty())
+				return;
 
-			/* for each bound map, compute all the unbounded key */
-			vector_set_symbols unbounded_symbols(unify_vect.size());
+			/* for each substitution, compute the unbound variables */
+			std::vector<std::vector<size_t> > unbounded_symbols(unify_vect.size());
 			for (size_t i = 0; i < unify_vect.size(); ++i) 
-				std::set_difference(r.symbols.begin(), r.symbols.end(),
-									bounded_symbols[i].begin(), bounded_symbols[i].end(),
-									std::inserter(unbounded_symbols[i], unbounded_symbols[i].begin()));
+				for (size_t j = 0; j < r.symbols.size(); ++j)
+					if (!is_bound(unify_vect[i][j]))
+						unbounded_symbols[i].push_back(j);
 
 			/* 
-			 * Now, for each bound map, for each unbounded key, try to fill it
-			 * with a valid expression and check if it defines some valid facts
-			 * If we find such a combinaison, goal can be inferred.
+			 * Now, for each substitution, for each unbound variable, try to
+			 * fill it with a valid expression and check if it defines some
+			 * valid facts If we find such a combinaison, goal can be
+			 * inferred.
 			 */
 			for (size_t i = 0; i < unify_vect.size(); ++i) {
-				unifyM m(unify_vect[i]);
+				substitution m(unify_vect[i]);
 				try {
-					unifyM_candidate candidates(unbounded_symbols[i], 
-												(*ctx.symbol_to_possible_expression)[r.identifier]);
-					bool has_next = true;
-					while (has_next)
-					{
-						has_next = candidates.next(m);
-						std::vector<function_call> v_f;
-						std::transform(r.condition.begin(), r.condition.end(),
-								std::back_inserter(v_f),
-								generate_inferred_fact(m));
-
-						node n;
-						std::vector<hypothesis_id> ids(v_f.size());
-						t.add_hypothesis_to_node(n, v_f.begin(), v_f.end(), ids.begin());
-						t.compute_node_state(n);
-						if (n.state != proven_false) 
-							v.push_back(std::make_pair(r.identifier, n));
-
-						if (n.state == proven_true) 
-							throw found_solution();
-					}
+					unifyM_candidate candidates(unbounded_symbols[i], r,
+												ctx.possible_expression(r.identifier));
+					size_t depth = unbounded_symbols[i].size();
+					if (!refuted(r, m, candidates.checks[depth]))
+						bind(r, candidates, m, depth);
 				} catch (no_candidate&) {}
 			}
 		}
+
+		/*
+		 * The nodes given by the congruence of equality for f :
+		 *  - p(.., b, ..) && equal(b, a) for each known fact p(.., b, ..)
+		 *    which only differs from f = p(.., a, ..) by one argument 
+		 *  - equal(a, b) if f = equal(g(.., a, ..), g(.., b, ..))
+		 */
+		void congruence(const congruenceM& c) const
+		{
+			/* f and the facts may refer to logic variables, compare their terms */
+			std::vector<function_call> goals = ctx.f.generate_all(f);
+			for (size_t i = 0; i < goals.size(); ++i) {
+				predicate_congruence(c, goals[i]);
+				function_congruence(c, goals[i]);
+			}
+		}
+
+		void predicate_congruence(const congruenceM& c, const function_call& goal) const
+		{
+			congruenceM::const_iterator it = c.find(goal.id);
+			if (it == c.end() || it->second.size() != goal.args.size())
+				return;
+
+			const std::vector<function_call>& known = t.known_facts(goal.id);
+			for (size_t k = 0; k < known.size(); ++k) {
+				size_t diff = 0, nb_diff = 0;
+				for (size_t i = 0; i < goal.args.size() && nb_diff < 2; ++i)
+					if (known[k].args[i] != goal.args[i]) {
+						diff = i;
+						nb_diff++;
+					}
+				if (nb_diff != 1)
+					continue;
+
+				function_call eq(it->second[diff]);
+				eq.args[0] = known[k].args[diff];
+				eq.args[1] = goal.args[diff];
+				std::vector<function_call> conds(1, known[k]);
+				conds.push_back(eq);
+				add_node("congruence", conds);
+			}
+		}
+
+		void function_congruence(const congruenceM& c, const function_call& goal) const
+		{
+			if (goal.args.size() != 2)
+				return;
+
+			const function_call* g1 = boost::get<function_call>(&goal.args[0].expr);
+			const function_call* g2 = boost::get<function_call>(&goal.args[1].expr);
+			if (!g1 || !g2 || g1->id != g2->id)
+				return;
+
+			congruenceM::const_iterator it = c.find(g1->id);
+			if (it == c.end() || it->second.size() != g1->args.size() + 1 ||
+				it->second.back().id != goal.id)
+				return;
+
+			size_t diff = 0, nb_diff = 0;
+			for (size_t i = 0; i < g1->args.size(); ++i)
+				if (g1->args[i] != g2->args[i]) {
+					diff = i;
+					nb_diff++;
+				}
+			if (nb_diff != 1)
+				return;
+
+			function_call eq(it->second[diff]);
+			eq.args[0] = g1->args[diff];
+			eq.args[1] = g2->args[diff];
+			add_node("congruence", std::vector<function_call>(1, eq));
+		}
 	};
 
 	struct explore_node {
@@ -424,28 +589,52 @@ namespace hyper { namespace logic {
 	{
 		hypothesis h = get_hypothesis(h_id);
 		assert(h.state == not_proven_not_explored);
-		h.state = not_proven_exploring;
-		update_hypothesis(h_id, h);
 
-		// generate all possible <rule, node> combinaison
-		std::vector<std::pair<rule::identifier_type, node> > v;
-		try {
-			std::for_each(rs.begin(), rs.end(), generate_node(ctx, *this, h.f, v));
-		} catch (const found_solution& ) {
-			// the solution is the last one in the vector
-			node_id n_id = insert_node(v.back().second);
-			h.nodes.push_back(n_id);
-			h.state = proven_true;
+		// out of budget, h is just kept as an hypothesis
+		if (exhausted) {
+			h.state = not_proven_explored;
 			update_hypothesis(h_id, h);
 			return;
 		}
 
-		try {
-			std::for_each(v.begin(), v.end(), explore_node(*this, h));
-		} catch(const found_solution& ) {
-			h.state = proven_true;
-			update_hypothesis(h_id, h);
-			return;
+		h.state = not_proven_exploring;
+		update_hypothesis(h_id, h);
+
+		/* 
+		 * generate all possible <rule, node> combinaison, and then the nodes
+		 * given by the congruence of equality. They are always explored
+		 * both, as a rule may apply to h.f while h.f only holds through an
+		 * equality. The congruence nodes come last, so that they do not use
+		 * the budget of a proof by the rules.
+		 */
+		for (size_t phase = 0; phase < 2; ++phase) {
+			std::vector<std::pair<rule::identifier_type, node> > v;
+			try {
+				generate_node gen(ctx, *this, h.f, v);
+				if (phase == 0)
+					std::for_each(rs.begin(), rs.end(), gen);
+				else
+					gen.congruence(congruence);
+			} catch (const budget_exhausted& ) {
+				// only consider the nodes generated so far
+			} catch (const found_solution& ) {
+				// the solution is the last one in the vector
+				node_id n_id = insert_node(v.back().second);
+				h.nodes.push_back(n_id);
+				h.state = proven_true;
+				update_hypothesis(h_id, h);
+				ctx.table_insert(h.f, true);
+				return;
+			}
+
+			try {
+				std::for_each(v.begin(), v.end(), explore_node(*this, h));
+			} catch(const found_solution& ) {
+				h.state = proven_true;
+				update_hypothesis(h_id, h);
+				ctx.table_insert(h.f, true);
+				return;
+			}
 		}
 
 		// no direct solution found ...
@@ -574,7 +763,7 @@ namespace hyper { namespace logic {
 
 	bool backward_chaining::infer(const function_call& f)
 	{
-		details::proof_tree tree(ctx, rs);
+		details::proof_tree tree(ctx, rs, budget, congruence);
 		boost::logic::tribool b = tree.compute(f);
 		return b;
 	}
@@ -582,7 +771,7 @@ namespace hyper { namespace logic {
 	bool backward_chaining::infer(const function_call& f, std::vector<function_call>& hyp)
 	{
 		hyp.clear();
-		details::proof_tree tree(ctx, rs);
+		details::proof_tree tree(ctx, rs, budget, congruence);
 		boost::logic::tribool b = tree.compute(f);
 		if (boost::logic::indeterminate(b)) 
 			tree.fill_hypothesis(f, hyp);
@@ -3,10 +3,14 @@
 #include <logic/eval.hh>
 #include <logic/backward_chaining.hh>
 
-#include <boost/assign/list_of.hpp>
+#include <boost/asio/io_service.hpp>
 #include <boost/bind.hpp>
 #include <boost/logic/tribool_io.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
 
 #include <set>
 #include <sstream>
@@ -16,31 +20,76 @@
 namespace {
 	using namespace hyper::logic;
 
+	/*
+	 * Compute the value that the argument i of a rule condition f requires,
+	 * considering the substitution s. Returns false if the argument is still
+	 * free.
+	 */
+	bool bound_value(const function_call& f, const std::vector<int>& slots, size_t i,
+					 const substitution& s, expression& res)
+	{
+		if (slots[i] >= 0) {
+			if (!is_bound(s[slots[i]]))
+				return false;
+			res = s[slots[i]];
+			return true;
+		}
+
+		if (!is_bound(f.args[i]) || boost::get<function_call>(&f.args[i].expr))
+			return false;
+		res = f.args[i];
+		return true;
+	}
+
 	/*
 	 * Try to find unification between one condition of a rule and one fact
+	 * of the sequence [begin, end)
 	 * If the unification is succesful, it is addede to unify_vect
 	 * Otherwise, there is no effect
+	 *
+	 * If index is not null, [begin, end) is the whole category of f, and the
+	 * facts are looked up through the argument index of the first bound
+	 * argument of f, if any.
 	 */
 	struct apply_unification_ 
 	{
-		const facts& facts_;
-		std::vector<unifyM>& unify_vect;
+		facts::const_iterator begin, end;
+		std::vector<substitution>& unify_vect;
 		const function_call &f;
-
-		apply_unification_(const facts& facts__, std::vector<unifyM>& unify_vect__,
-						   const function_call &f_):
-			facts_(facts__), unify_vect(unify_vect__), f(f_)
+		const std::vector<int>& slots;
+		const facts* index;
+
+		apply_unification_(facts::const_iterator begin, facts::const_iterator end,
+						   std::vector<substitution>& unify_vect__, const function_call &f_,
+						   const std::vector<int>& slots, const facts* index = 0):
+			begin(begin), end(end), unify_vect(unify_vect__), f(f_), slots(slots),
+			index(index)
 		{}
 
-		void operator() (const  unifyM& m)
+		void try_unify(const function_call& fact, const substitution& m)
 		{
-			functionId id = f.id;
-			for (facts::const_iterator it = facts_.begin(id) ; it != facts_.end(id); ++it)
-			{
-				unify_res r = unify(f, *it, m);
-				if (r.first)
-					unify_vect.push_back(r.second);
+			substitution s(m);
+			if (unify(f, slots, fact, s))
+				unify_vect.push_back(s);
+		}
+
+		void operator() (const substitution& m)
+		{
+			if (index) {
+				expression value;
+				for (size_t i = 0; i < f.args.size(); ++i) {
+					if (!bound_value(f, slots, i, m, value))
+						continue;
+
+					const facts::const_iteratorV& v = index->find(f.id, i, value);
+					for (size_t j = 0; j < v.size(); ++j)
+						try_unify(*v[j], m);
+					return;
+				}
 			}
+
+			for (facts::const_iterator it = begin; it != end; ++it)
+				try_unify(*it, m);
 		}
 	};
 
@@ -50,93 +99,122 @@ namespace {
 	struct apply_unification 
 	{
 		const facts& facts_;
-		std::vector<unifyM>& unify_vect;
+		std::vector<substitution>& unify_vect;
 
-		apply_unification(const facts& facts__, std::vector<unifyM>& unify_vect__):
+		apply_unification(const facts& facts__, std::vector<substitution>& unify_vect__):
 			facts_(facts__), unify_vect(unify_vect__)
 		{}
 
-		void operator() (const function_call& f)
+		void operator() (const function_call& f, const std::vector<int>& slots)
 		{
-			std::vector<unifyM> tmp;
+			std::vector<substitution> tmp;
 			std::for_each(unify_vect.begin(), unify_vect.end(), 
-						  apply_unification_(facts_, tmp, f));
-
-			unify_vect = tmp;
-		}
-	};
+						  apply_unification_(facts_.begin(f.id), facts_.end(f.id), 
+											 tmp, f, slots, &facts_));
 
-	/*
-	 * Really generate a fact from an expression and a unification map
-	 */
-	struct do_unification : public boost::static_visitor<expression>
-	{
-		const unifyM& m;
-
-		do_unification(const unifyM& m_) : m(m_) {}
-
-		template <typename T> 
-		expression operator() (const T& t) const
-		{
-			return t;
+			std::swap(unify_vect, tmp);
 		}
 
-		expression operator() (const std::string& s) const
+		/* Only consider the facts in the sequence [begin, end) */
+		void operator() (const function_call& f, const std::vector<int>& slots,
+						 facts::const_iterator begin, facts::const_iterator end)
 		{
-			unifyM::const_iterator it = m.find(s);
-			if (it == m.end()) {
-				assert(false);
-				return s; // maybe assert(false) here
-			}
-			return it->second;
-		}
+			std::vector<substitution> tmp;
+			std::for_each(unify_vect.begin(), unify_vect.end(), 
+						  apply_unification_(begin, end, tmp, f, slots));
 
-		expression operator() (const function_call& f) const
-		{
-			function_call res(f, true);
-            for (size_t i = 0; i < f.args.size(); ++i)
-                res.args[i] = boost::apply_visitor(do_unification(m), f.args[i].expr);
-			return res;
+			std::swap(unify_vect, tmp);
 		}
 	};
 
 	/*
-	 * Generate a fact from a rule and a unification map
+	 * Generate a fact from a rule and a substitution
 	 */
 	struct generate_fact
 	{
 		const function_call& f;
+		const rule::list_symbols& symbols;
 
-		generate_fact(const function_call& f_) : f(f_) {}
+		generate_fact(const function_call& f_, const rule::list_symbols& symbols) : 
+			f(f_), symbols(symbols) {}
 
-		function_call operator() (const unifyM& m) const
+		function_call operator() (const substitution& m) const
 		{
-			function_call res(f, true);
-            for (size_t i = 0; i < f.args.size(); ++i)
-                res.args[i] = boost::apply_visitor(do_unification(m), f.args[i].expr);
-			return res;
+			return substitute(f, symbols, m);
 		}
 	};
 
+	typedef boost::optional<facts::support_type> optional_support;
+
+	/*
+	 * Compute the support of the application of the rule r with the
+	 * substitution s : the union of the supports of the facts matched by its
+	 * conditions. It is unknown if one of them is unknown.
+	 */
+	optional_support rule_support(const rule& r, const substitution& s, const facts& f)
+	{
+		facts::support_type res;
+		for (size_t i = 0; i < r.condition.size(); ++i) {
+			const facts::support_type* support;
+			support = f.support(substitute(r.condition[i], r.symbols, s));
+			if (!support)
+				return boost::none;
+
+			facts::support_type tmp;
+			std::set_union(res.begin(), res.end(), support->begin(), support->end(),
+						   std::back_inserter(tmp));
+			std::swap(res, tmp);
+		}
+		return res;
+	}
+
+	void add_supported_fact(facts& facts_, const function_call& f, const optional_support& s)
+	{
+		if (s)
+			facts_.add(f, *s);
+		else
+			facts_.add(f);
+	}
+
 	/*
 	 * Add a fact from a rule and each unification we can find
+	 *
+	 * If the facts database tracks the supports, they are computed before
+	 * adding anything : a new fact may rewrite the logic variables, and so
+	 * the premises of the next unifications.
 	 */
 	struct add_facts
 	{
 		facts& facts_;
-		const std::vector<unifyM>& unify_vect;
+		const std::vector<substitution>& unify_vect;
+		const rule& r;
+		std::vector<optional_support> supports;
 
-		add_facts(facts& facts__, const std::vector<unifyM>& unify_vect_):
-			facts_(facts__), unify_vect(unify_vect_)
-		{}
+		add_facts(facts& facts__, const std::vector<substitution>& unify_vect_,
+				  const rule& r):
+			facts_(facts__), unify_vect(unify_vect_), r(r)
+		{
+			if (facts_.tracks_support())
+				std::transform(unify_vect.begin(), unify_vect.end(),
+							   std::back_inserter(supports),
+							   boost::bind(&rule_support, boost::cref(r), _1, 
+										   boost::cref(facts_)));
+		}
 
 		void operator() (const function_call& f)
 		{
+			if (facts_.tracks_support()) {
+				for (size_t i = 0; i < unify_vect.size(); ++i)
+					add_supported_fact(facts_, substitute(f, r.symbols, unify_vect[i]),
+									   supports[i]);
+				return;
+			}
+
 			std::set<function_call> s;
 
 			std::transform(unify_vect.begin(), unify_vect.end(),
 						   std::inserter(s, s.begin()),
-						   generate_fact(f));
+						   generate_fact(f, r.symbols));
 
 			bool (facts::*add_f) (const function_call& f) = & facts::add;
 			std::for_each(s.begin(), s.end(), 
@@ -144,18 +222,121 @@ namespace {
 		}
 	};
 
-	std::vector<unifyM> 
+	/*
+	 * Returns true if one argument of f is a constant, or a variable already
+	 * bound, so that apply_unification can use the facts index
+	 */
+	bool has_bound_argument(const function_call& f, const std::set<std::string>& bound)
+	{
+		for (size_t i = 0; i < f.args.size(); ++i) {
+			const std::string* s = boost::get<std::string>(&f.args[i].expr);
+			if (!s && !boost::get<function_call>(&f.args[i].expr))
+				return true;
+			if (s && bound.find(*s) != bound.end())
+				return true;
+		}
+		return false;
+	}
+
+	/*
+	 * Compute the order in which the conditions of r are unified. The order
+	 * does not change the result, but the size of the intermediate
+	 * std::vector<substitution> depends a lot of it. It is a greedy choice : at
+	 * each step, prefer the conditions with a bound argument, and then the
+	 * conditions with the fewest facts. If first is a valid condition
+	 * number, it is always unified first.
+	 */
+	std::vector<size_t>
+	order_conditions(const rule& r, const facts& facts_, size_t first)
+	{
+		std::vector<size_t> order;
+		std::vector<bool> done(r.condition.size(), false);
+		std::set<std::string> bound;
+
+		while (order.size() < r.condition.size()) {
+			size_t best = first;
+			if (best >= r.condition.size() || done[best]) {
+				bool best_bound = false;
+				best = r.condition.size();
+				for (size_t i = 0; i < r.condition.size(); ++i) {
+					if (done[i])
+						continue;
+					bool i_bound = has_bound_argument(r.condition[i], bound);
+					if (best == r.condition.size() || (i_bound && !best_bound) ||
+						(i_bound == best_bound && 
+						 facts_.size(r.condition[i].id) < facts_.size(r.condition[best].id))) {
+						best = i;
+						best_bound = i_bound;
+					}
+				}
+			}
+
+			done[best] = true;
+			order.push_back(best);
+
+			const function_call& cond = r.condition[best];
+			for (size_t i = 0; i < cond.args.size(); ++i) {
+				const std::string* s = boost::get<std::string>(&cond.args[i].expr);
+				if (s)
+					bound.insert(*s);
+			}
+		}
+
+		return order;
+	}
+
+	std::vector<substitution> 
 	compute_rule_unification(const rule& r, const facts_ctx& facts)
 	{
-		// generate an empty ctx for starting the algorithm
-		std::vector<unifyM> unify_vect(1);
+		if (r.matcher) {
+			std::vector<substitution> res;
+			r.matcher(r, facts.f, 0, r.condition.size(), res);
+			return res;
+		}
+
+		// generate an empty substitution for starting the algorithm
+		std::vector<substitution> unify_vect(1, substitution(r.symbols.size()));
 
 		/* 
 		 * apply_unification will try to find some unification between facts
-		 * and one condition, refining unifyM context at each condition. 
+		 * and one condition, refining the substitution at each condition. 
 		 */
-		std::for_each(r.condition.begin(), r.condition.end(), 
-					  apply_unification(facts.f, unify_vect));
+		apply_unification apply(facts.f, unify_vect);
+		std::vector<size_t> order = order_conditions(r, facts.f, r.condition.size());
+		for (size_t i = 0; i < order.size() && !unify_vect.empty(); ++i) 
+			apply(r.condition[order[i]], r.condition_slots[order[i]]);
+
+		return unify_vect;
+	}
+
+	/*
+	 * Same thing than compute_rule_unification, but the condition number
+	 * delta_cond is only unified with the facts from delta. It is the basic
+	 * step of the semi-naive evaluation : a new unification must rely on at
+	 * least one new fact.
+	 */
+	std::vector<substitution>
+	compute_rule_unification(const rule& r, const facts_ctx& facts,
+							 const facts::delta_type& delta, size_t delta_cond)
+	{
+		if (r.matcher) {
+			std::vector<substitution> res;
+			r.matcher(r, facts.f, &delta, delta_cond, res);
+			return res;
+		}
+
+		std::vector<substitution> unify_vect(1, substitution(r.symbols.size()));
+		apply_unification apply(facts.f, unify_vect);
+
+		std::vector<size_t> order = order_conditions(r, facts.f, delta_cond);
+		for (size_t i = 0; i < order.size() && !unify_vect.empty(); ++i) {
+			const function_call& cond = r.condition[order[i]];
+			const std::vector<int>& slots = r.condition_slots[order[i]];
+			if (order[i] == delta_cond)
+				apply(cond, slots, delta.begin(cond.id), delta.end(cond.id));
+			else
+				apply(cond, slots);
+		}
 
 		return unify_vect;
 	}
@@ -167,12 +348,37 @@ namespace {
 
 		bool operator() (const rule& r)
 		{
-			std::vector<unifyM> vec = compute_rule_unification(r, facts);
+			std::vector<substitution> vec = compute_rule_unification(r, facts);
 			return !vec.empty();
 		}
 	};
 
 
+	/*
+	 * Same thing than lead_to_inconsistency, but only consider the
+	 * unifications which rely on at least one fact of delta
+	 */
+	struct lead_to_inconsistency_delta {
+		const facts_ctx& facts;
+		const facts::delta_type& delta;
+
+		lead_to_inconsistency_delta(const facts_ctx& facts, const facts::delta_type& delta) :
+			facts(facts), delta(delta) {}
+
+		bool operator() (const rule& r)
+		{
+			for (size_t i = 0; i < r.condition.size(); ++i) {
+				functionId id = r.condition[i].id;
+				if (delta.begin(id) == delta.end(id))
+					continue;
+
+				if (!compute_rule_unification(r, facts, delta, i).empty())
+					return true;
+			}
+			return false;
+		}
+	};
+
 	/*
 	 * Try to apply a rule to a set of facts
 	 *
@@ -190,24 +396,59 @@ namespace {
 
 		bool operator() (const rule& r)
 		{
-			std::vector<unifyM> unify_vect = compute_rule_unification(r, facts);
+			std::vector<substitution> unify_vect = compute_rule_unification(r, facts);
 
 			// generating new fact
 			size_t facts_size = facts.f.size();
 			std::for_each(r.action.begin(), r.action.end(),
-						  add_facts(facts.f, unify_vect));
+						  add_facts(facts.f, unify_vect, r));
 
 			return (facts.f.size() != facts_size);
 		}
 	};
 
+	/*
+	 * Apply a rule considering only the unifications which rely on at least
+	 * one fact of delta.
+	 */
+	struct apply_rule_delta
+	{
+		facts_ctx& facts;
+		const facts::delta_type& delta;
+
+		apply_rule_delta(facts_ctx& facts, const facts::delta_type& delta) :
+			facts(facts), delta(delta) {}
+
+		void operator() (const rule& r)
+		{
+			// inconsistency rules never produce any fact
+			if (r.inconsistency())
+				return;
+
+			std::vector<substitution> unify_vect;
+			for (size_t i = 0; i < r.condition.size(); ++i) {
+				functionId id = r.condition[i].id;
+				if (delta.begin(id) == delta.end(id))
+					continue;
+
+				std::vector<substitution> v = compute_rule_unification(r, facts, delta, i);
+				unify_vect.insert(unify_vect.end(), v.begin(), v.end());
+			}
+
+			std::for_each(r.action.begin(), r.action.end(),
+						  add_facts(facts.f, unify_vect, r));
+		}
+	};
+
 	struct compute_possible_expression
 	{
 		const rule& r;
-		facts_ctx& ctx;
+		const facts_ctx& ctx;
+		facts_ctx::expressionM& possible;
 
-		compute_possible_expression(const rule& r, facts_ctx& ctx) : 
-			r(r), ctx(ctx) 
+		compute_possible_expression(const rule& r, const facts_ctx& ctx,
+									facts_ctx::expressionM& possible) : 
+			r(r), ctx(ctx), possible(possible)
 		{}
 
 		void operator() (const std::string& s)
@@ -223,40 +464,189 @@ namespace {
 			 * initialize the expressionS with the sub_expression from the
 			 * first fct category
 			 */
-			facts_ctx::expressionS res;
-			res.insert(ctx.f.sub_begin(*it_id), ctx.f.sub_end(*it_id));
+			boost::shared_ptr<facts_ctx::expressionS> res(new facts_ctx::expressionS());
+			res->insert(ctx.f.sub_begin(*it_id), ctx.f.sub_end(*it_id));
 			++it_id;
 
 			/*
-			 * And now compute the intersection with the other sub_expression
+			 * And now compute the intersection with the other sub_expression.
+			 * They are not ordered with HYPER_LOGIC_HASH, so look each
+			 * candidate up instead of merging them.
 			 */
 			while (it_id != f_id.end())
 			{
-				facts_ctx::expressionS tmp;
-				std::set_intersection(res.begin(), res.end(),
-									  ctx.f.sub_begin(*it_id),
-									  ctx.f.sub_end(*it_id),
-									  std::inserter(tmp, tmp.begin()));
-				std::swap(res, tmp);
+				facts_ctx::expressionS::iterator it_e = res->begin();
+				while (it_e != res->end()) {
+					if (ctx.f.has_sub_expression(*it_id, *it_e))
+						++it_e;
+					else
+						res->erase(it_e++);
+				}
 				++it_id;
 			}
 
-			(*ctx.symbol_to_possible_expression)[r.identifier][s] = res;
+			possible[s] = res;
 		}
 	};
 
 	struct compute_possible_expression_helper 
 	{
-		facts_ctx& ctx;
+		const facts_ctx& ctx;
+		facts_ctx::expressionMM& possible;
 
-		compute_possible_expression_helper(facts_ctx& ctx) : ctx(ctx) {}
+		compute_possible_expression_helper(const facts_ctx& ctx, 
+										   facts_ctx::expressionMM& possible) :
+			ctx(ctx), possible(possible) {}
 
 		void operator() (const rule &r) 
 		{
-			std::for_each(r.symbols.begin(), r.symbols.end(), compute_possible_expression(r, ctx));
+			boost::shared_ptr<facts_ctx::expressionM> m(new facts_ctx::expressionM());
+			std::for_each(r.symbols.begin(), r.symbols.end(), 
+						  compute_possible_expression(r, ctx, *m));
+			possible[r.identifier] = m;
 		}
 	};
 
+	/* The sub-expressions of a sub delta, grouped by category */
+	typedef std::map<functionId, std::vector<expression> > sub_deltaM;
+
+	/*
+	 * Add to the possible expressions of the symbols of r the new
+	 * sub-expressions of delta. A new sub-expression of category id can
+	 * only be a candidate for the symbols of r which appear in id, and it
+	 * was not one before. It is one now if it is a sub-expression of all
+	 * the categories of the symbol.
+	 *
+	 * The sets and the maps are shared with the previous version of
+	 * possible, so only the ones which change are copied.
+	 */
+	struct update_possible_expression
+	{
+		const facts_ctx& ctx;
+		const sub_deltaM& delta;
+		facts_ctx::expressionMM& possible;
+
+		update_possible_expression(const facts_ctx& ctx, const sub_deltaM& delta,
+								   facts_ctx::expressionMM& possible) :
+			ctx(ctx), delta(delta), possible(possible) {}
+
+		bool is_candidate(const std::set<functionId>& f_id, const expression& e) const
+		{
+			std::set<functionId>::const_iterator it;
+			for (it = f_id.begin(); it != f_id.end(); ++it)
+				if (!ctx.f.has_sub_expression(*it, e))
+					return false;
+			return true;
+		}
+
+		void operator() (const rule& r)
+		{
+			boost::shared_ptr<const facts_ctx::expressionM> current;
+			facts_ctx::expressionMM::const_iterator it_r = possible.find(r.identifier);
+			if (it_r != possible.end())
+				current = it_r->second;
+			boost::shared_ptr<facts_ctx::expressionM> m;
+
+			rule::list_symbols::const_iterator it_s;
+			for (it_s = r.symbols.begin(); it_s != r.symbols.end(); ++it_s) {
+				rule::map_symbol::const_iterator it = r.symbol_to_fun.find(*it_s);
+				assert(it != r.symbol_to_fun.end());
+				const std::set<functionId> & f_id = it->second;
+
+				boost::shared_ptr<facts_ctx::expressionS> res;
+				std::set<functionId>::const_iterator it_id;
+				for (it_id = f_id.begin(); it_id != f_id.end(); ++it_id) {
+					sub_deltaM::const_iterator it_d = delta.find(*it_id);
+					if (it_d == delta.end())
+						continue;
+
+					std::vector<expression>::const_iterator it_e;
+					for (it_e = it_d->second.begin(); it_e != it_d->second.end(); ++it_e) {
+						if (!is_candidate(f_id, *it_e))
+							continue;
+
+						if (!res) {
+							res.reset(new facts_ctx::expressionS());
+							facts_ctx::expressionM::const_iterator it_p;
+							if (current && (it_p = current->find(*it_s)) != current->end())
+								*res = *it_p->second;
+						}
+						res->insert(*it_e);
+					}
+				}
+
+				if (!res)
+					continue;
+
+				if (!m) 
+					m.reset(current ? new facts_ctx::expressionM(*current) 
+									: new facts_ctx::expressionM());
+				(*m)[*it_s] = res;
+			}
+
+			if (m)
+				possible[r.identifier] = m;
+		}
+	};
+
+
+	/*
+	 * The progress of a call to engine::parallel_infer_ : the next
+	 * identifier to handle, and the number of identifiers being handled.
+	 * It is shared with the workers, as a worker may only start once the
+	 * call has returned.
+	 */
+	struct infer_work
+	{
+		boost::mutex m;
+		boost::condition_variable done;
+		size_t next;
+		size_t size;
+		size_t running;
+
+		infer_work(size_t size) : next(0), size(size), running(0) {}
+	};
+
+	/*
+	 * Worker of engine::parallel_infer_ : take the next identifier not yet
+	 * handled, until there is no more work. ids, res and hyps are only
+	 * accessed while the call is waiting for the end of the work.
+	 */
+	struct infer_worker
+	{
+		boost::shared_ptr<infer_work> w;
+		const std::vector<std::string>& ids;
+		boost::function<tribool (const std::string&, std::vector<function_call>&)> task;
+		std::vector<tribool>& res;
+		std::vector<std::vector<function_call> >& hyps;
+
+		infer_worker(boost::shared_ptr<infer_work> w,
+					 const std::vector<std::string>& ids,
+					 boost::function<tribool (const std::string&, std::vector<function_call>&)> task,
+					 std::vector<tribool>& res, std::vector<std::vector<function_call> >& hyps) :
+			w(w), ids(ids), task(task), res(res), hyps(hyps)
+		{}
+
+		void operator() ()
+		{
+			while (true) {
+				size_t i;
+				{
+					boost::mutex::scoped_lock lock(w->m);
+					if (w->next == w->size)
+						return;
+					i = w->next++;
+					w->running++;
+				}
+				res[i] = task(ids[i], hyps[i]);
+				{
+					boost::mutex::scoped_lock lock(w->m);
+					w->running--;
+				}
+				w->done.notify_all();
+			}
+		}
+	};
 
 	struct are_equal : public boost::static_visitor<tribool>
 	{
@@ -281,25 +671,118 @@ namespace {
 			return boost::apply_visitor(are_equal(), e1.expr, e2.expr);
 		}
 	};
+
+	/*
+	 * Print an expression in the syntax accepted by generate. It differs
+	 * from operator << for double, bool and string constants.
+	 */
+	struct trace_print : public boost::static_visitor<void>
+	{
+		std::ostream& oss;
+
+		trace_print(std::ostream& oss) : oss(oss) {}
+
+		template <typename T>
+		void operator() (const Constant<T>& c) const { oss << c.value; }
+
+		void operator() (const Constant<double>& c) const
+		{
+			std::ostringstream tmp;
+			tmp.precision(6);
+			tmp << std::fixed << c.value;
+			oss << tmp.str();
+		}
+
+		void operator() (const Constant<bool>& c) const
+		{
+			oss << (c.value ? "true" : "false");
+		}
+
+		/* 
+		 * The constants parsed by generate keep their quotes, the other
+		 * ones are quoted and escaped
+		 */
+		void operator() (const Constant<std::string>& c) const
+		{
+			const std::string& v = c.value;
+			if (v.size() >= 2 && v[0] == '"' && v[v.size() - 1] == '"') {
+				oss << v;
+				return;
+			}
+
+			oss << '"';
+			for (size_t i = 0; i < v.size(); ++i) {
+				if (v[i] == '"' || v[i] == '\\')
+					oss << '\\';
+				oss << v[i];
+			}
+			oss << '"';
+		}
+
+		void operator() (const empty&) const {}
+
+		void operator() (const std::string& s) const { oss << s; }
+
+		void operator() (const function_call& f) const
+		{
+			oss << f.name << "(";
+			for (size_t i = 0; i < f.args.size(); ++i) {
+				if (i != 0) oss << ", ";
+				boost::apply_visitor(*this, f.args[i].expr);
+			}
+			oss << ")";
+		}
+	};
+
+	std::string trace_declaration(const std::string& kind, const std::string& name,
+								  size_t arity, const std::vector<std::string>& args_type)
+	{
+		std::ostringstream oss;
+		oss << kind << " " << name << " " << arity;
+		for (size_t i = 0; i < args_type.size(); ++i)
+			oss << " " << args_type[i];
+		return oss.str();
+	}
 }
 
 namespace hyper {
 	namespace logic {
-		engine::engine() : rules_(funcs_) 
+		engine::engine() : base_(funcs_), rules_(funcs_), strategy_(semi_naive_chaining),
+			parallelism_(std::max(1u, boost::thread::hardware_concurrency())),
+			parallel_threshold_(64),
+			trace_(0), truth_maintenance_(false), declaring_(false)
 		{}
 
-		bool engine::add_type(const std::string& name)
+		void engine::record(const std::string& line)
 		{
-			funcs_.add("equal_" + name, 2, new eval<equal, 2>(), true);
-
-			add_rule<std::string>("equal_" + name + "_reflexivity", 
-					 boost::assign::list_of<std::string>("equal_" + name + "(X, Y)"),
-					 boost::assign::list_of<std::string>("equal_" + name + "(Y, X)"));
+			// infer may be called concurrently by parallel_infer_all
+			boost::mutex::scoped_lock lock(trace_mutex_);
+			if (trace_)
+				*trace_ << line << std::endl;
+		}
 
-			add_rule<std::string>("equal_" + name + "_transitiviy", 
-					  boost::assign::list_of<std::string>("equal_" + name + "(X, Y)")("equal_" + name +"(Y,Z)"),
-					  boost::assign::list_of<std::string>("equal_" + name + "(X, Z)"));
+		std::string engine::trace_string(const function_call& f)
+		{
+			std::ostringstream oss;
+			trace_print print(oss);
+			print(f);
+			return oss.str();
+		}
 
+		/*
+		 * Equality is not encoded as rules : the equal_${type} predicates
+		 * are unification predicates, so facts merges the equivalence
+		 * classes of its logic variables (see logic_var_db) when adding such
+		 * fact. Reflexivity, symmetry and transitivity are then implicit,
+		 * and so is the congruence of predicates and functions, as their
+		 * arguments are stored as logic variables. The backward chaining
+		 * still proposes congruence hypotheses, see congruenceM.
+		 */
+		bool engine::add_type(const std::string& name)
+		{
+			if (trace_)
+				record("type " + name);
+			funcs_.add("equal_" + name, 2, new eval<equal, 2>(), true);
 			return true;
 		}
 
@@ -307,171 +790,100 @@ namespace hyper {
 							  const std::vector<std::string>& args_type,
 							  eval_predicate* eval)
 		{
-			funcs_.add(name, arity, eval);
-			/*
-			 * For each function f of arity n, state that 
-			 * if f(X1, X2, ..., XN) and equal(X1, Y1) then f(Y1, X2, ..., XN)
-			 */
-			typedef std::vector<std::string> statement;
-			std::vector<statement> conds;
-			for (size_t i = 0; i < arity; ++i) {
-				statement s;
-				std::ostringstream oss;
-				oss << name << "(";
-				for (size_t j = 0; j < arity; ++j) {
-					oss << "X" << j;
-					if (j != arity - 1)
-						oss << ",";
-				}
-				oss << ")";
-				s.push_back(oss.str());
-
-				oss.str("");
-				oss << "equal_" << args_type[i] << "(X" << i << ",Y" << i << ")";
-				s.push_back(oss.str());
-				conds.push_back(s);
-			}
-
-			std::vector<statement> action;
-			for (size_t i = 0; i < arity; ++i) {
-				statement s;
-				std::ostringstream oss;
-				oss << name << "(";
-				for (size_t j = 0; j < arity; ++j) {
-					if ( i == j ) 
-						oss << "Y" << j;
-					else 
-						oss << "X" << j;
-					if (j != arity - 1)
-						oss << ",";
-				}
-				oss << ")";
-				s.push_back(oss.str());
-				action.push_back(s);
-			}
-
-			for (size_t i = 0; i < arity; ++i) {
-				std::ostringstream oss;
-				oss << name << "_unify" << i;
-
-				add_rule(oss.str(), conds[i], action[i]);
-			}
+			if (trace_)
+				record(trace_declaration("predicate", name, arity, args_type));
 
+			functionId id = funcs_.add(name, arity, eval);
+			add_congruence(id, std::vector<std::string>(args_type.begin(), 
+							args_type.begin() + std::min(arity, args_type.size())));
 			return true; // XXX
 		}
 
 		bool engine::add_func(const std::string& name, size_t arity,
 							  const std::vector<std::string>& args_type)
 		{
-			funcs_.add(name, arity, 0);
-			/*
-			 * For each function f of arity n, state that 
-			 * if f(X1, X2, ..., XN) and equal(X1, Y1) then 
-			 *	equal(f(X1, X2, ..., XN), f(Y1, X2, ....));
-			 */
-			typedef std::vector<std::string> statement;
-			std::vector<statement> conds;
-			for (size_t i = 0; i < arity; ++i) {
-				statement s;
-				std::ostringstream oss;
-				oss << name << "(";
-				for (size_t j = 0; j < arity; ++j) {
-					oss << "X" << j;
-					if (j != arity - 1)
-						oss << ",";
-				}
-				oss << ")";
-				s.push_back(oss.str());
-
-				oss.str("");
-				oss << "equal_" << args_type[i] << "(X" << i << ",Y" << i << ")";
-				s.push_back(oss.str());
-				conds.push_back(s);
-			}
-
-			std::vector<statement> action;
-			for (size_t i = 0; i < arity; ++i) {
-				statement s;
-				std::ostringstream oss;
-				oss << "equal_" << args_type[arity] << "(";
-				oss << name << "(";
-				for (size_t j = 0; j < arity; ++j) {
-						oss << "X" << j;
-					if (j != arity - 1)
-						oss << ",";
-				}
-				oss << "),";
-				oss << name << "(";
-				for (size_t j = 0; j < arity; ++j) {
-					if ( i == j ) 
-						oss << "Y" << j;
-					else 
-						oss << "X" << j;
-					if (j != arity - 1)
-						oss << ",";
-				}
-				oss << "))";
-				s.push_back(oss.str());
-				action.push_back(s);
-			}
+			if (trace_)
+				record(trace_declaration("func", name, arity, args_type));
 
-			for (size_t i = 0; i < arity; ++i) {
-				std::ostringstream oss;
-				oss << name << "_equal" << i;
+			functionId id = funcs_.add(name, arity, 0);
+			add_congruence(id, std::vector<std::string>(args_type.begin(), 
+							args_type.begin() + std::min(arity + 1, args_type.size())));
+			return true; // XXX
+		}
 
-				add_rule(oss.str(), conds[i], action[i]);
+		void engine::add_congruence(functionId id, const std::vector<std::string>& types)
+		{
+			std::vector<function_call> equal;
+			for (size_t i = 0; i < types.size(); ++i) {
+				function_call f("equal_" + types[i], expression(), expression());
+				boost::optional<functionId> equal_id = funcs_.getId(f.name);
+				if (!equal_id)
+					return;
+				f.id = *equal_id;
+				equal.push_back(f);
 			}
-
-			return true; // XXX
+			congruence_[id] = equal;
 		}
 
 		facts_ctx & engine::get_facts(const std::string& identifier)
 		{
 			factsMap::iterator it = facts_.find(identifier);
 			if (it == facts_.end()) {
+				/* 
+				 * the new context shares the possible expressions of the
+				 * base, and only updates them with its own facts
+				 */
+				base_.compute_possible_expression(rules_);
 				std::pair<factsMap::iterator, bool> p;
-				p = facts_.insert(std::make_pair(identifier, facts_ctx(funcs_)));
+				p = facts_.insert(std::make_pair(identifier, base_));
 				assert(p.second);
 				return p.first->second;
 			}
 			return it->second;
 		}
 
-		void engine::set_facts(const std::string& identifier, const facts_ctx& ctx)
-		{
-			factsMap::iterator it = facts_.find(identifier);
-			if (it != facts_.end()) 
-				facts_.erase(it);
-			facts_.insert(std::make_pair(identifier, ctx));
-		}
-
-		bool engine::generate_theory(facts_ctx& current_facts, const std::string& identifier) {
+		bool engine::generate_theory(facts_ctx& current_facts) {
 			apply_rules(current_facts);
 
 			/* If the new fact does not lead to any inconstency, really commit
 			 * it */
 			if (is_world_consistent(rules_, current_facts)) {
-				set_facts(identifier, current_facts);
+				current_facts.commit();
 				return true;
-			} else 
+			} else {
+				current_facts.rollback();
 				return false;
+			}
+		}
+
+		bool engine::add_base_fact_(const function_call& fact)
+		{
+			base_.begin_transaction();
+			base_.add(fact);
+			if (!generate_theory(base_))
+				return false;
+
+			for (factsMap::iterator it = facts_.begin(); it != facts_.end(); ++it) {
+				it->second.begin_transaction();
+				it->second.add(fact);
+				generate_theory(it->second);
+			}
+			return true;
 		}
 
 		bool engine::add_fact(const std::vector<std::string>& exprs, 
 							  const std::string& identifier)
 		{
+			record("fact", identifier, exprs);
+
 			// help the compiler to choose right overload
 			bool (facts_ctx::*f) (const std::string& s) = &facts_ctx::add;
-			facts_ctx current_facts = get_facts(identifier);
-				std::for_each(exprs.begin(), exprs.end(), 
+			facts_ctx& current_facts = get_facts(identifier);
+			current_facts.begin_transaction();
+			std::for_each(exprs.begin(), exprs.end(), 
 						  boost::bind(f, boost::ref(current_facts), _1));
-			apply_rules(current_facts);
 
-			if (is_world_consistent(rules_, current_facts)) {
-				set_facts(identifier, current_facts);
-				return true;
-			} else 
-				return false;
+			return generate_theory(current_facts);
 		}
 
 		/*
@@ -481,6 +893,19 @@ namespace hyper {
 		void engine::apply_rules(facts_ctx& current_facts)
 		{
 			current_facts.new_rule();
+
+			switch (strategy_) {
+				case naive_chaining:
+					return apply_rules_naive(current_facts);
+				case semi_naive_chaining:
+					return apply_rules_semi_naive(current_facts);
+				case rete_chaining:
+					return apply_rules_rete(current_facts);
+			}
+		}
+
+		void engine::apply_rules_naive(facts_ctx& current_facts)
+		{
 			rules::const_iterator it = rules_.begin();
 
 			while (it != rules_.end())
@@ -491,10 +916,220 @@ namespace hyper {
 				else
 					++it;
 			}
+
+			// forget the facts added in the meantime, they have been handled
+			facts::delta_type delta;
+			current_facts.f.take_delta(delta);
+		}
+
+		/*
+		 * Each round only computes the unifications which involve at least
+		 * one fact produced by the previous round. When the logic variables
+		 * database has been rewritten, the delta is meaningless, so the
+		 * round considers all the facts, as the naive algorithm does.
+		 */
+		void engine::apply_rules_semi_naive(facts_ctx& current_facts)
+		{
+			facts::delta_type delta;
+			current_facts.f.take_delta(delta);
+
+			while (!delta.empty()) 
+			{
+				if (delta.all) 
+					std::for_each(rules_.begin(), rules_.end(), apply_rule(current_facts));
+				else
+					std::for_each(rules_.begin(), rules_.end(), 
+								  apply_rule_delta(current_facts, delta));
+
+				current_facts.f.take_delta(delta);
+			}
+		}
+
+		bool engine::is_consistent(const std::string& identifier)
+		{
+			return is_world_consistent(rules_, get_facts(identifier));
+		}
+
+		std::vector<function_call> engine::known_facts(const std::string& identifier)
+		{
+			const facts& f = get_facts(identifier).f;
+			std::vector<function_call> res;
+			for (functionId id = 0; id < f.max_id(); ++id)
+				for (facts::const_iterator it = f.begin(id); it != f.end(id); ++it) {
+					std::vector<function_call> v = f.generate_all(*it);
+					res.insert(res.end(), v.begin(), v.end());
+				}
+
+			std::sort(res.begin(), res.end());
+			res.erase(std::unique(res.begin(), res.end()), res.end());
+			return res;
+		}
+
+		void engine::set_truth_maintenance(bool b)
+		{
+			base_.f.track_support(b);
+			for (factsMap::iterator it = facts_.begin(); it != facts_.end(); ++it)
+				it->second.f.track_support(b);
+			truth_maintenance_ = b;
+		}
+
+		/*
+		 * The facts database was closed under the rules before the
+		 * retraction, and the remaining facts still hold. So the removed
+		 * facts which can be derived differently are produced by the rules
+		 * whose action is one of the removed categories, applied on the
+		 * whole database. The following rounds only rely on their new
+		 * facts, as usual.
+		 */
+		bool engine::retract_fact_(const function_call& fact, const std::string& identifier)
+		{
+			facts_ctx& current_facts = get_facts(identifier);
+
+			std::set<functionId> removed;
+			bool rebuilt;
+			if (!current_facts.retract(fact, removed, rebuilt))
+				return false;
+
+			if (!rebuilt) {
+				apply_rule apply(current_facts);
+				rules::const_iterator it;
+				for (it = rules_.begin(); it != rules_.end(); ++it) {
+					std::vector<function_call>::const_iterator it_a;
+					for (it_a = it->action.begin(); it_a != it->action.end(); ++it_a)
+						if (removed.find(it_a->id) != removed.end())
+							break;
+					if (it_a != it->action.end())
+						apply(*it);
+				}
+			}
+
+			apply_rules(current_facts);
+			return true;
+		}
+
+		void engine::set_chaining_strategy(chaining_strategy s)
+		{
+			base_.rete.invalidate();
+			for (factsMap::iterator it = facts_.begin(); it != facts_.end(); ++it)
+				it->second.rete.invalidate();
+			strategy_ = s;
+		}
+
+		/*
+		 * The network only gives the matches of the new facts, which are
+		 * then added as for the other strategies. New rules are compiled
+		 * lazily, the memories are then out of date and rebuilt by update.
+		 */
+		void engine::apply_rules_rete(facts_ctx& current_facts)
+		{
+			rete_.compile(rules_);
+
+			facts::delta_type delta;
+			current_facts.f.take_delta(delta);
+
+			while (!delta.empty())
+			{
+				rete_network::matchV matches;
+				rete_.update(current_facts.rete, current_facts.f, delta, matches);
+
+				rete_network::matchV::const_iterator it;
+				if (current_facts.f.tracks_support()) {
+					// see add_facts
+					std::vector<optional_support> supports;
+					for (it = matches.begin(); it != matches.end(); ++it)
+						supports.push_back(rule_support(*(rules_.begin() + it->rule), it->s,
+														current_facts.f));
+
+					for (size_t i = 0; i < matches.size(); ++i) {
+						const rule& r = *(rules_.begin() + matches[i].rule);
+						std::vector<function_call>::const_iterator it_a;
+						for (it_a = r.action.begin(); it_a != r.action.end(); ++it_a)
+							add_supported_fact(current_facts.f,
+											   substitute(*it_a, r.symbols, matches[i].s),
+											   supports[i]);
+					}
+
+					current_facts.f.take_delta(delta);
+					continue;
+				}
+
+				// a fact is often produced by several matches
+				std::set<function_call> s;
+				for (it = matches.begin(); it != matches.end(); ++it) {
+					const rule& r = *(rules_.begin() + it->rule);
+					std::vector<function_call>::const_iterator it_a;
+					for (it_a = r.action.begin(); it_a != r.action.end(); ++it_a)
+						s.insert(substitute(*it_a, r.symbols, it->s));
+				}
+
+				bool (facts::*add_f) (const function_call& f) = & facts::add;
+				std::for_each(s.begin(), s.end(), 
+							  boost::bind(add_f, boost::ref(current_facts.f), _1));
+
+				current_facts.f.take_delta(delta);
+			}
+		}
+
+		struct infer_pool
+		{
+			boost::asio::io_service io_s;
+			boost::asio::io_service::work work;
+			boost::thread_group threads;
+
+			infer_pool(size_t nb_threads) : work(io_s)
+			{
+				std::size_t (boost::asio::io_service::*run)() = &boost::asio::io_service::run;
+				for (size_t i = 0; i < nb_threads; ++i)
+					threads.create_thread(boost::bind(run, &io_s));
+			}
+
+			~infer_pool()
+			{
+				io_s.stop();
+				threads.join_all();
+			}
+		};
+
+		void engine::parallel_infer_(const std::vector<std::string>& ids, infer_task task,
+									 std::vector<boost::logic::tribool>& res,
+									 std::vector<std::vector<function_call> >& hyps)
+		{
+			size_t nb_facts = 0;
+			for (size_t i = 0; i < ids.size() && nb_facts < parallel_threshold_; ++i)
+				nb_facts += get_facts(ids[i]).f.size();
+
+			size_t nb_threads = std::min(parallelism_, ids.size());
+			if (nb_threads <= 1 || nb_facts < parallel_threshold_) {
+				for (size_t i = 0; i < ids.size(); ++i)
+					res[i] = task(ids[i], hyps[i]);
+				return;
+			}
+
+			boost::shared_ptr<infer_pool> pool;
+			{
+				boost::mutex::scoped_lock lock(pool_mutex_);
+				if (!pool_ || pool_->threads.size() != parallelism_ - 1)
+					pool_.reset(new infer_pool(parallelism_ - 1));
+				pool = pool_;
+			}
+
+			/* 
+			 * The calling thread takes its part of the work, so the call
+			 * ends even if the threads of the pool are busy
+			 */
+			boost::shared_ptr<infer_work> w(new infer_work(ids.size()));
+			for (size_t i = 0; i < nb_threads - 1; ++i)
+				pool->io_s.post(infer_worker(w, ids, task, res, hyps));
+			infer_worker(w, ids, task, res, hyps)();
+
+			boost::mutex::scoped_lock lock(w->m);
+			while (w->running > 0)
+				w->done.wait(lock);
 		}
 
 		boost::logic::tribool engine::infer_(const function_call& f,
-											const std::string& identifier)
+											const std::string& identifier,
+											const infer_budget& budget)
 		{
 			facts_ctx& current_facts = get_facts(identifier);
 
@@ -506,7 +1141,7 @@ namespace hyper {
 
 			current_facts.compute_possible_expression(rules_);
 
-			backward_chaining chaining(rules_, current_facts);
+			backward_chaining chaining(rules_, current_facts, budget, congruence_);
 			has_concluded = chaining.infer(f);
 			
 			if (has_concluded)
@@ -517,7 +1152,8 @@ namespace hyper {
 
 		boost::logic::tribool engine::infer_(const function_call& f,
 										    std::vector<function_call>& hyps,
-											const std::string& identifier)
+											const std::string& identifier,
+											const infer_budget& budget)
 		{
 			facts_ctx& current_facts = get_facts(identifier);
 			boost::logic::tribool b = current_facts.f.matches(f);
@@ -528,13 +1164,23 @@ namespace hyper {
 
 			current_facts.compute_possible_expression(rules_);
 
-			backward_chaining chaining(rules_, current_facts);
+			backward_chaining chaining(rules_, current_facts, budget, congruence_);
 			std::vector<function_call> hyps_;
 			has_concluded = chaining.infer(f, hyps_);
 
 			if (has_concluded)
 				return true;
 
+			/*
+			 * No rule deals with equality. equal(x, y) is true if any term
+			 * unified with x is proved equal to any term unified with y.
+			 * equal_candidates and generate_all enumerate these terms for us.
+			 */
+			if (funcs_.get(f.id).unify_predicate) {
+				std::vector<function_call> v = current_facts.f.equal_candidates(f);
+				hyps_.insert(hyps_.end(), v.begin(), v.end());
+			}
+
 			hyps.clear();
 			for (size_t i = 0; i < hyps_.size(); ++i)
 			{
@@ -557,10 +1203,27 @@ namespace hyper {
 			hyper::utils::copy_if(rs.begin(), rs.end(), std::back_inserter(rules),
 						 boost::bind(&rule::inconsistency, _1));
 
+			/*
+			 * In a transaction, the previous state was consistent. So only
+			 * check the unifications which rely on a new fact, and the facts
+			 * whose evaluation may have changed.
+			 */
+			facts::delta_type delta;
+			std::vector<function_call> to_match;
+			if (facts.f.transaction_changes(delta, to_match)) {
+				std::vector<boost::logic::tribool> matches;
+				facts.f.matches(to_match, matches);
+
+				bool res = ! hyper::utils::any(rules.begin(), rules.end(), 
+										lead_to_inconsistency_delta(facts, delta));
+				res = res and hyper::utils::all(matches.begin(), matches.end(),
+											   std::bind2nd(std::equal_to<bool>(), true));
+				return res;
+			}
+
 			std::vector<boost::logic::tribool> matches;
 			for (size_t i = 0; i < facts.f.max_id(); ++i)
-				std::transform(facts.f.begin(i), facts.f.end(i), std::back_inserter(matches),
-						boost::bind(&facts::matches, &facts.f, _1));
+				facts.f.matches(i, matches);
 
 			bool res = ! hyper::utils::any(rules.begin(), rules.end(), 
 									 lead_to_inconsistency(facts));
@@ -587,13 +1250,101 @@ namespace hyper {
 			return os;
 		}
 
+		bool facts_ctx::retract(const function_call& fact, std::set<functionId>& removed,
+								bool& rebuilt)
+		{
+			generate_return r = generate(fact, funcs_);
+			if (!r.res)
+				return false;
+
+			facts::support_type s;
+			assertionM::iterator it = assertions_.begin();
+			while (it != assertions_.end()) {
+				if (it->second == r.e) {
+					s.push_back(it->first);
+					assertions_.erase(it++);
+				} else
+					++it;
+			}
+
+			if (s.empty())
+				return false;
+
+			ctx_rules_update = false;
+			new_version();
+			rete.invalidate();
+
+			rebuilt = !f.retract(s, removed);
+			if (rebuilt) {
+				f.clear();
+				for (it = assertions_.begin(); it != assertions_.end(); ++it)
+					f.add(it->second, facts::support_type(1, it->first));
+			}
+			return true;
+		}
+
+		boost::optional<bool> facts_ctx::table_find(const function_call& f)
+		{
+			if (table_version_ != version_)
+				return boost::none;
+
+			tableM::const_iterator it = table_.find(f);
+			if (it == table_.end())
+				return boost::none;
+			return it->second;
+		}
+
+		void facts_ctx::table_insert(const function_call& f, bool proved)
+		{
+			if (table_version_ != version_) {
+				table_.clear();
+				table_version_ = version_;
+			}
+			table_[f] = proved;
+		}
+
 		void facts_ctx::compute_possible_expression(const rules& rs) 
 		{
 			if (ctx_rules_update)
 				return;
 
-			std::for_each(rs.begin(), rs.end(), compute_possible_expression_helper(*this));
+			facts::sub_delta_type d;
+			f.take_sub_delta(d);
+
+			/* 
+			 * Never modify the current map in place, it may be shared with
+			 * another facts_ctx
+			 */
+			if (d.all || possible_rules_ != rs.size()) {
+				boost::shared_ptr<expressionMM> possible(new expressionMM());
+				std::for_each(rs.begin(), rs.end(), 
+							  compute_possible_expression_helper(*this, *possible));
+				symbol_to_possible_expression = possible;
+			} else if (!d.list.empty()) {
+				sub_deltaM delta;
+				facts::sub_logV::const_iterator it;
+				for (it = d.list.begin(); it != d.list.end(); ++it)
+					delta[it->first].push_back(it->second);
+
+				boost::shared_ptr<expressionMM> possible(
+						new expressionMM(*symbol_to_possible_expression));
+				std::for_each(rs.begin(), rs.end(), 
+							  update_possible_expression(*this, delta, *possible));
+				symbol_to_possible_expression = possible;
+			}
+
+			possible_rules_ = rs.size();
 			ctx_rules_update = true;
 		}
+
+		const facts_ctx::expressionM&
+		facts_ctx::possible_expression(const rule::identifier_type& id) const
+		{
+			static const expressionM empty;
+			expressionMM::const_iterator it = symbol_to_possible_expression->find(id);
+			if (it == symbol_to_possible_expression->end())
+				return empty;
+			return *it->second;
+		}
 	}
 }
@@ -1,5 +1,6 @@
 #include <logic/expression.hh>
 
+#include <cassert>
 #include <iostream>
 
 #include <boost/spirit/include/qi.hpp>
@@ -12,6 +13,7 @@
 #include <boost/spirit/include/phoenix_object.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/fusion/include/adapt_struct.hpp>
+#include <boost/functional/hash.hpp>
 
 using boost::phoenix::function;
 using boost::phoenix::ref;
@@ -54,7 +56,8 @@ struct expression_lexer : lex::lexer<Lexer>
 	expression_lexer() 
 	{
 		scoped_identifier = "[a-zA-Z_][a-zA-Z0-9_]*(::[a-zA-Z_][a-zA-Z0-9_]*)*";
-		constant_string = "\\\".*\\\"";
+		// a string ends at its first unescaped quote, not at the last one of the line
+		constant_string = "\\\"([^\\\"\\\\]|\\\\.)*\\\"";
 		constant_int = "[0-9]+";
 		// XXX We don't support local, nor scientific notation atm
 		constant_double = "[0-9]*\\.[0-9]*";
@@ -270,44 +273,67 @@ struct  grammar_expression : qi::grammar<Iterator, function_call(), qi::in_state
 	grammar_node<Iterator, Lexer> node;
 };
 
-struct are_expression_equal : public boost::static_visitor<bool>
+/*
+ * Three-way comparison of two expressions. The expressions are first ordered
+ * by kind (the index of the variant), then by value.
+ */
+struct compare_expression : public boost::static_visitor<int>
 {
 	template <typename U, typename V>
-	bool operator() ( const U& u, const V& v) const
+	int operator() ( const U&, const V&) const
 	{
-		(void) u; (void) v;
-		return false;
+		// only reached for different kinds, handled by hyper::logic::compare
+		assert(false);
+		return 0;
 	}
 
-	bool operator() (const empty&, const empty&) const 
+	int operator() (const empty&, const empty&) const 
 	{
-		return true;
+		return 0;
 	}
 
 	template <typename U>
-	bool operator() (const Constant<U>& u, const Constant<U>& v) const
+	int operator() (const Constant<U>& u, const Constant<U>& v) const
 	{
-		return (u.value == v.value);
+		if (u.value < v.value)
+			return -1;
+		if (v.value < u.value)
+			return 1;
+		return 0;
 	}
 
-	bool operator() (const std::string& u, const std::string& v) const
+	int operator() (const std::string& u, const std::string& v) const
 	{
-		return (u == v);
+		return u.compare(v);
 	}
 
-	bool operator() (const function_call& f1, const function_call& f2) const
+	int operator() (const function_call& f1, const function_call& f2) const
 	{
-		if (f1.id != f2.id)
-			return false;
-		bool same_args = true;
-		size_t i = 0;
-		while (same_args && i < f1.args.size())
-		{
-			same_args = same_args && 
-				boost::apply_visitor(are_expression_equal(), f1.args[i].expr, f2.args[i].expr);
-			++i;
-		}
-		return same_args;
+		return hyper::logic::compare(f1, f2);
+	}
+};
+
+struct hash_expression : public boost::static_visitor<std::size_t>
+{
+	std::size_t operator() (const empty&) const
+	{
+		return 0;
+	}
+
+	template <typename U>
+	std::size_t operator() (const Constant<U>& u) const
+	{
+		return boost::hash<U>()(u.value);
+	}
+
+	std::size_t operator() (const std::string& u) const
+	{
+		return boost::hash<std::string>()(u);
+	}
+
+	std::size_t operator() (const function_call& f) const
+	{
+		return hyper::logic::hash_value(f);
 	}
 };
 
@@ -475,37 +501,64 @@ namespace hyper {
 			return oss;
 		}
 
+		int compare(const expression& e1, const expression& e2)
+		{
+			int w1 = e1.expr.which();
+			int w2 = e2.expr.which();
+			if (w1 != w2)
+				return w1 < w2 ? -1 : 1;
+			return boost::apply_visitor(compare_expression(), e1.expr, e2.expr);
+		}
+
+		int compare(const function_call& f1, const function_call& f2)
+		{
+			if (f1.id != f2.id)
+				return f1.id < f2.id ? -1 : 1;
+			if (f1.args.size() != f2.args.size())
+				return f1.args.size() < f2.args.size() ? -1 : 1;
+
+			for (size_t i = 0; i < f1.args.size(); ++i) {
+				int res = compare(f1.args[i], f2.args[i]);
+				if (res != 0)
+					return res;
+			}
+
+			return 0;
+		}
+
 		bool operator == (const expression& e1, const expression& e2)
 		{
-			return boost::apply_visitor(are_expression_equal(), e1.expr, e2.expr);
+			return compare(e1, e2) == 0;
 		}
 
 		bool operator < (const expression& e1, const expression& e2)
 		{
-			return e1.expr < e2.expr;
+			return compare(e1, e2) < 0;
 		}
 
-		bool operator < (const function_call& f1, const function_call & f2)
+		bool operator == (const function_call& f1, const function_call & f2)
 		{
-			if (f1.id < f2.id)
-				return true;
-			if (f1.id > f2.id)
-				return false;
-			std::vector<expression>::const_iterator it1, it2;
-			it1 = f1.args.begin();
-			it2 = f2.args.begin();
-			while (it1 != f1.args.end())
-			{
-				if (*it1 < *it2)
-					return true;
-				if (*it1 == *it2) {
-					++it1;
-					++it2;
-				} else
-					return false;
-			}
+			return compare(f1, f2) == 0;
+		}
 
-			return false;
+		std::size_t hash_value(const expression& e)
+		{
+			std::size_t seed = e.expr.which();
+			boost::hash_combine(seed, boost::apply_visitor(hash_expression(), e.expr));
+			return seed;
+		}
+
+		std::size_t hash_value(const function_call& f)
+		{
+			std::size_t seed = f.id;
+			for (size_t i = 0; i < f.args.size(); ++i)
+				boost::hash_combine(seed, hash_value(f.args[i]));
+			return seed;
+		}
+
+		bool operator < (const function_call& f1, const function_call & f2)
+		{
+			return compare(f1, f2) < 0;
 		}
 			
 	}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sstream>
 
 #include <logic/facts.hh>
@@ -5,31 +6,83 @@
 
 #include <boost/bind.hpp>
 #include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
 
 namespace {
 	using namespace hyper::logic;
 
-	struct set_inserter : public boost::static_visitor<void>
+	/*
+	 * Make p the only owner of its set, copying it if it is shared (see
+	 * facts::shared_factsV). Returns true if the set has been copied.
+	 */
+	template <typename T>
+	bool unshare(boost::shared_ptr<T>& p, term_table& terms)
+	{
+		if (!p) {
+			p.reset(new T(&terms));
+			return false;
+		}
+
+		if (p.unique())
+			return false;
+
+		p.reset(new T(*p));
+		return true;
+	}
+
+	/*
+	 * Insert an expression and its sub-expressions in list. Each real
+	 * insertion is recorded in delta, and in log if it is not null.
+	 */
+	struct set_inserter
 	{
 		facts::sub_expressionV& list;
-		facts::sub_expressionS& set;
+		functionId id;
+		facts::sub_logV* log;
+		facts::sub_logV& delta;
+		term_table& terms;
 
-		set_inserter(facts::sub_expressionV& list_, facts::sub_expressionS& set_) :
-			list(list_), set(set_) {}
+		set_inserter(facts::sub_expressionV& list_, functionId id, facts::sub_logV* log,
+					 facts::sub_logV& delta, term_table& terms) :
+			list(list_), id(id), log(log), delta(delta), terms(terms) {}
 
-		template <typename T>
-		void operator() (const T& t) const
+		void insert(const expression& e, term t) const
 		{
-			set.insert(t);
+			if (list[id] && list[id]->find(t) != list[id]->end())
+				return;
+
+			unshare(list[id], terms);
+			list[id]->insert(t, e);
+			delta.push_back(std::make_pair(id, e));
+			if (log)
+				log->push_back(std::make_pair(id, e));
 		}
 
-		void operator() (const function_call& f) const
+		/* Insert e, whose term is t */
+		void operator() (const expression& e, term t) const
 		{
-			set.insert(f);
-			set_inserter inserter(list, list[f.id]);
-			std::vector<expression>::const_iterator it;
-			for (it = f.args.begin(); it != f.args.end(); ++it)
-				boost::apply_visitor(inserter, it->expr);
+			insert(e, t);
+
+			const function_call* f = boost::get<function_call>(&e.expr);
+			if (!f)
+				return;
+
+			std::vector<term> args;
+			terms.args(t, args);
+			(*this)(*f, args);
+		}
+
+		void operator() (const expression& e) const
+		{
+			(*this)(e, terms.make(e));
+		}
+
+		/* Insert the arguments of f, whose terms are args */
+		void operator() (const function_call& f, const std::vector<term>& args) const
+		{
+			set_inserter inserter(list, f.id, log, delta, terms);
+			for (size_t i = 0; i < f.args.size(); ++i)
+				inserter(f.args[i], args[i]);
 		}
 	};
 
@@ -173,6 +226,16 @@ namespace {
 		}
 	};
 
+	/* Returns true if the support contains one of the asserted facts of s */
+	bool depends_on(const facts::support_type& support, const facts::support_type& s)
+	{
+		facts::support_type::const_iterator it;
+		for (it = s.begin(); it != s.end(); ++it)
+			if (std::binary_search(support.begin(), support.end(), *it))
+				return true;
+		return false;
+	}
+
 	function_call prepare_function_to_exec(const function_call& f, logic_var_db& db);
 
 	struct prepare_exec_helper : public boost::static_visitor<expression>
@@ -215,6 +278,8 @@ namespace {
 
 namespace hyper {
 	namespace logic {
+		const size_t facts::no_support;
+
 		struct handle_adapt_res : boost::static_visitor<bool> {
 
 			facts& facts_;
@@ -224,8 +289,9 @@ namespace hyper {
 				facts_(facts_), f(f) {}
 
 			bool operator() (const adapt_res::ok& ok) const {
-				set_inserter inserter(facts_.sub_list, facts_.sub_list[f.id]);
-				boost::apply_visitor(inserter, ok.sym.expr);
+				set_inserter inserter(facts_.sub_list, f.id, facts_.sub_log(),
+									  facts_.sub_delta_.list, facts_.terms());
+				inserter(ok.sym);
 
 				return true; 
 			}
@@ -237,8 +303,9 @@ namespace hyper {
 			}
 
 			bool operator() (const adapt_res::require_permutation& perm) const {
-				set_inserter inserter(facts_.sub_list, facts_.sub_list[f.id]);
-				boost::apply_visitor(inserter, perm.sym.expr);
+				set_inserter inserter(facts_.sub_list, f.id, facts_.sub_log(),
+									  facts_.sub_delta_.list, facts_.terms());
+				inserter(perm.sym);
 
 				return facts_.apply_permutations(perm.seq);
 			}
@@ -254,28 +321,84 @@ namespace hyper {
 			return add_(r.e);
 		}
 
+		bool facts::add(const function_call& f, const support_type& s)
+		{
+			support_ = &s;
+			bool res = add(f);
+			support_ = 0;
+			return res;
+		}
+
+		bool facts::add(const std::string& f, const support_type& s)
+		{
+			support_ = &s;
+			bool res = add(f);
+			support_ = 0;
+			return res;
+		}
+
 		bool facts::add_(const function_call& f)
 		{
-			resize(f.id, sub_list);
+			resize(f.id);
+			if (!track_support_)
+				untracked_ = true;
+			else if (funcs.get(f.id).unify_predicate) {
+				if (support_)
+					unify_support_.insert(unify_support_.end(), support_->begin(), support_->end());
+				else
+					unify_support_.push_back(no_support);
+			}
+
 			adapt_res res = db.adapt_and_unify(f);
 			return  boost::apply_visitor(handle_adapt_res(*this, f), res.res);
 		}
 
 		bool facts::add_new_facts(const function_call& f) 
 		{
-			resize(f.id, list);
+			resize(f.id);
+			term t = terms().make(f);
 			std::pair< expressionS::iterator, bool> p;
-			p = list[f.id].insert(f);
+			// don't copy a shared category for a fact already known
+			if (list[f.id] && !list[f.id].unique() && list[f.id]->find(t) != list[f.id]->end())
+				p = std::make_pair(list[f.id]->find(t), false);
+			else {
+				expressionS& c = own_category(f.id);
+#if HYPER_LOGIC_HASH
+				// a rehash invalidates the iterators of the indexes
+				size_t buckets = c.bucket_count();
+				p = c.insert(t, f);
+				if (c.bucket_count() != buckets && f.id < index_.v.size())
+					index_.v[f.id].clear();
+#else
+				p = c.insert(t, f);
+#endif
+			}
+			if (track_support_)
+				record_support(f, p.second);
 			if (p.second) {
 				size__++;
-				resize(f.id, sub_list);
-				set_inserter inserter(sub_list, sub_list[f.id]);
-				std::vector<expression>::const_iterator it;
-				for (it = f.args.begin(); it != f.args.end(); ++it)
-					boost::apply_visitor(inserter, it->expr);
+				if (transaction_.active && !transaction_.saved)
+					transaction_.new_facts.push_back(f);
+				if (!delta_.all) {
+					if (f.id >= delta_.list.size())
+						delta_.list.resize(funcs.size(), expressionS(&terms()));
+					delta_.list[f.id].insert(t, f);
+					delta_.size++;
+				}
+				std::vector<term> args;
+				terms().args(t, args);
+				if (f.id < index_.v.size()) {
+					std::vector<arg_index>& idx = index_.v[f.id];
+					for (size_t i = 0; i < idx.size(); ++i)
+						if (idx[i].built)
+							idx[i].m[args[i]].push_back(p.first);
+				}
+				set_inserter inserter(sub_list, f.id, sub_log(), sub_delta_.list, terms());
+				inserter(f, args);
 
 				/* Insert sub_fact */
 				std::vector<function_call> s;
+				std::vector<expression>::const_iterator it;
 				for (it = f.args.begin(); it != f.args.end(); ++it)
 					boost::apply_visitor(inner_function_call(db, s), it->expr);
 
@@ -285,29 +408,350 @@ namespace hyper {
 			return p.second;
 		}
 
+		void facts::record_support(const function_call& f, bool inserted)
+		{
+			// without support, the fact depends on all the asserted facts
+			if (!support_)
+				return;
+
+			if (inserted) {
+				supports_[f] = *support_;
+				return;
+			}
+
+			supportM::iterator it = supports_.find(f);
+			if (it != supports_.end() && it->second.size() <= support_->size())
+				return;
+
+			if (transaction_.active && !transaction_.saved) {
+				boost::optional<support_type> previous;
+				if (it != supports_.end())
+					previous = it->second;
+				transaction_.replaced_supports.push_back(std::make_pair(f, previous));
+			}
+			supports_[f] = *support_;
+		}
+
 		bool facts::apply_permutations(const adapt_res::permutationSeq& seq)
 		{
+			/*
+			 * The whole database is rewritten, it is simpler to save it than
+			 * to log each change
+			 */
+			if (transaction_.active && !transaction_.saved) {
+				transaction_.saved = true;
+				transaction_.list = list;
+				transaction_.sub_list = sub_list;
+				transaction_.supports = supports_;
+			}
+
+			/* the categories which don't change are still shared */
 			for (size_t i = 0; i < list.size(); ++i) {
-				expressionS tmp;
-				std::transform(list[i].begin(), list[i].end(), 
-							   std::inserter(tmp, tmp.begin()),
-							   boost::bind(&apply_permutation_f, _1,
-										 boost::cref(seq)));
-				std::swap(list[i], tmp);
+				if (!list[i])
+					continue;
+				boost::shared_ptr<expressionS> tmp(new expressionS(&terms()));
+				for (const_iterator it = list[i]->begin(); it != list[i]->end(); ++it)
+					tmp->insert(apply_permutation_f(*it, seq));
+				if (*tmp != *list[i])
+					std::swap(list[i], tmp);
 			}
 
 			for (size_t i = 0; i < sub_list.size(); ++i) {
-				sub_expressionS tmp;	
-				std::transform(sub_list[i].begin(), sub_list[i].end(),
-							   std::inserter(tmp, tmp.begin()),
-							   boost::bind(&apply_permutation_e, _1,
-										 boost::cref(seq)));
-				std::swap(sub_list[i], tmp);
+				if (!sub_list[i])
+					continue;
+				boost::shared_ptr<sub_expressionS> tmp(new sub_expressionS(&terms()));
+				sub_const_iterator it;
+				for (it = sub_list[i]->begin(); it != sub_list[i]->end(); ++it)
+					tmp->insert(apply_permutation_e(*it, seq));
+				if (*tmp != *sub_list[i])
+					std::swap(sub_list[i], tmp);
+			}
+
+			/* two facts may become the same one, keep the smallest support */
+			supportM supports;
+			for (supportM::const_iterator it = supports_.begin(); it != supports_.end(); ++it) {
+				std::pair<supportM::iterator, bool> p;
+				p = supports.insert(std::make_pair(apply_permutation_f(it->first, seq), it->second));
+				if (!p.second && it->second.size() < p.first->second.size())
+					p.first->second = it->second;
+			}
+			std::swap(supports_, supports);
+
+			invalidate_delta();
+			sub_delta_.all = true;
+			sub_delta_.list.clear();
+			index_.v.clear();
+			generation_++;
+			return true;
+		}
+
+		facts::expressionS& facts::own_category(functionId id)
+		{
+			resize(id);
+			if (!list[id]) {
+				list[id].reset(new expressionS(&terms()));
+			} else if (!list[id].unique()) {
+				// rollback gives back the shared copy
+				if (transaction_.active && !transaction_.saved)
+					transaction_.copied.push_back(std::make_pair(id, list[id]));
+				list[id].reset(new expressionS(*list[id]));
+
+				// the index and the pointers on the facts refer to the shared copy
+				if (id < index_.v.size())
+					index_.v[id].clear();
+				generation_++;
+			}
+			return *list[id];
+		}
+
+		facts::arg_index& facts::get_index(functionId id, size_t pos) const
+		{
+			const expressionS& c = category(id);
+			if (id >= index_.v.size())
+				index_.v.resize(funcs.size());
+			if (index_.v[id].empty())
+				index_.v[id].resize(funcs.get(id).arity);
+			assert(pos < index_.v[id].size());
+
+			arg_index& idx = index_.v[id][pos];
+			if (!idx.built) {
+				std::vector<term> args;
+				for (const_iterator it = c.begin(); it != c.end(); ++it) {
+					args.clear();
+					terms().args(it.key(), args);
+					idx.m[args[pos]].push_back(it);
+				}
+				idx.built = true;
+			}
+			return idx;
+		}
+
+		void facts::unindex(const_iterator it)
+		{
+			if (it->id >= index_.v.size())
+				return;
+
+			std::vector<arg_index>& idx = index_.v[it->id];
+			std::vector<term> args;
+			terms().args(it.key(), args);
+			for (size_t i = 0; i < idx.size(); ++i) {
+				if (!idx[i].built)
+					continue;
+				const_iteratorV& v = idx[i].m[args[i]];
+				v.erase(std::remove(v.begin(), v.end(), it), v.end());
+				if (v.empty())
+					idx[i].m.erase(args[i]);
+			}
+		}
+
+		const facts::const_iteratorV& 
+		facts::find(functionId id, size_t pos, const expression& e) const
+		{
+			static const const_iteratorV empty;
+
+			const arg_index& idx = get_index(id, pos);
+			boost::optional<term> t = terms().find(e);
+			if (!t)
+				return empty;
+			arg_index::map_type::const_iterator it = idx.m.find(*t);
+			if (it == idx.m.end())
+				return empty;
+			return it->second;
+		}
+
+		void facts::begin_transaction()
+		{
+			assert(!transaction_.active);
+			transaction_ = transaction_type();
+			transaction_.active = true;
+			transaction_.size = size__;
+			transaction_.delta = delta_;
+			transaction_.unify_support_size = unify_support_.size();
+			transaction_.sub_delta_size = sub_delta_.list.size();
+			db.begin_transaction();
+		}
+
+		void facts::commit()
+		{
+			assert(transaction_.active);
+			transaction_ = transaction_type();
+			db.commit();
+		}
+
+		void facts::rollback()
+		{
+			assert(transaction_.active);
+
+			if (transaction_.saved) {
+				std::swap(list, transaction_.list);
+				std::swap(sub_list, transaction_.sub_list);
+				std::swap(supports_, transaction_.supports);
+				index_.v.clear();
+				generation_++;
+			}
+
+			std::vector<std::pair<function_call, boost::optional<support_type> > >::reverse_iterator it_s;
+			for (it_s = transaction_.replaced_supports.rbegin(); 
+				 it_s != transaction_.replaced_supports.rend(); ++it_s) {
+				if (it_s->second)
+					supports_[it_s->first] = *it_s->second;
+				else
+					supports_.erase(it_s->first);
+			}
+
+			std::vector<function_call>::const_iterator it;
+			for (it = transaction_.new_facts.begin(); it != transaction_.new_facts.end(); ++it) {
+				expressionS& c = own_category(it->id);
+				expressionS::iterator it_f = c.find(*it);
+				assert(it_f != c.end());
+				unindex(it_f);
+				c.erase(it_f);
+				supports_.erase(*it);
+			}
+			unify_support_.resize(transaction_.unify_support_size);
+
+			if (transaction_.saved || transaction_.sub_delta_taken) {
+				sub_delta_.all = true;
+				sub_delta_.list.clear();
+			} else
+				sub_delta_.list.resize(transaction_.sub_delta_size);
+
+			sub_logV::const_iterator it_sub;
+			for (it_sub = transaction_.new_sub_expressions.begin(); 
+				 it_sub != transaction_.new_sub_expressions.end(); ++it_sub) {
+				unshare(sub_list[it_sub->first], terms());
+				sub_list[it_sub->first]->erase(it_sub->second);
+			}
+
+			std::vector<std::pair<functionId, boost::shared_ptr<expressionS> > >::reverse_iterator it_c;
+			for (it_c = transaction_.copied.rbegin(); it_c != transaction_.copied.rend(); ++it_c) {
+				list[it_c->first] = it_c->second;
+				if (it_c->first < index_.v.size())
+					index_.v[it_c->first].clear();
+				generation_++;
+			}
+
+			size__ = transaction_.size;
+			std::swap(delta_, transaction_.delta);
+
+			transaction_ = transaction_type();
+			db.rollback();
+		}
+
+		void facts::clear()
+		{
+			assert(!transaction_.active);
+			list.clear();
+			sub_list.clear();
+			db.clear();
+			delta_ = delta_type();
+			sub_delta_ = sub_delta_type();
+			sub_delta_.all = true;
+			index_.v.clear();
+			supports_.clear();
+			unify_support_.clear();
+			untracked_ = false;
+			size__ = 0;
+			generation_++;
+		}
+
+		bool facts::retract(const support_type& s, std::set<functionId>& removed)
+		{
+			assert(!transaction_.active);
+			if (!complete_support())
+				return false;
+
+			std::vector<size_t>::const_iterator it_u;
+			for (it_u = unify_support_.begin(); it_u != unify_support_.end(); ++it_u)
+				if (*it_u == no_support || std::binary_search(s.begin(), s.end(), *it_u))
+					return false;
+
+			for (functionId id = 0; id < list.size(); ++id) {
+				std::vector<function_call> to_remove;
+				const expressionS& current = category(id);
+				for (const_iterator it = current.begin(); it != current.end(); ++it) {
+					supportM::const_iterator it_s = supports_.find(*it);
+					if (it_s == supports_.end() || depends_on(it_s->second, s))
+						to_remove.push_back(*it);
+				}
+
+				if (to_remove.empty())
+					continue;
+
+				expressionS& c = own_category(id);
+				std::vector<function_call>::const_iterator it;
+				for (it = to_remove.begin(); it != to_remove.end(); ++it) {
+					supports_.erase(*it);
+					if (!delta_.all && id < delta_.list.size() && delta_.list[id].erase(*it))
+						delta_.size--;
+					expressionS::iterator it_f = c.find(*it);
+					unindex(it_f);
+					c.erase(it_f);
+					size__--;
+				}
+				removed.insert(id);
+			}
+
+			if (!removed.empty())
+				generation_++;
+			return true;
+		}
+
+		bool facts::transaction_changes(delta_type& d, std::vector<function_call>& to_match) const
+		{
+			std::vector<logic_var::identifier_type> vars;
+			if (!transaction_.active || transaction_.saved || !db.transaction_changes(vars))
+				return false;
+
+			d = delta_type();
+			d.list.resize(funcs.size(), expressionS(&terms()));
+
+			std::vector<function_call>::const_iterator it;
+			for (it = transaction_.new_facts.begin(); it != transaction_.new_facts.end(); ++it) {
+				d.list[it->id].insert(*it);
+				d.size++;
 			}
 
+			std::set<function_call> s(transaction_.new_facts.begin(), 
+									  transaction_.new_facts.end());
+
+			/*
+			 * An old fact can only be evaluated differently if its
+			 * predicate has an evaluation, otherwise it is just known. So
+			 * only these categories are searched, and indexed, for the
+			 * bound logic variables.
+			 */
+			if (!vars.empty())
+				for (functionId id = 0; id < list.size(); ++id) {
+					if (!funcs.evaluable(id) || category(id).empty())
+						continue;
+					for (size_t pos = 0; pos < funcs.get(id).arity; ++pos)
+						for (size_t i = 0; i < vars.size(); ++i) {
+							const const_iteratorV& v = find(id, pos, vars[i]);
+							for (size_t j = 0; j < v.size(); ++j)
+								s.insert(*v[j]);
+						}
+				}
+
+			std::copy(s.begin(), s.end(), std::back_inserter(to_match));
 			return true;
 		}
 
+		void facts::take_delta(delta_type& d)
+		{
+			d = delta_type();
+			std::swap(d, delta_);
+			d.list.resize(funcs.size(), expressionS(&terms()));
+		}
+
+		void facts::take_sub_delta(sub_delta_type& d)
+		{
+			if (transaction_.active)
+				transaction_.sub_delta_taken = true;
+			d = sub_delta_type();
+			std::swap(d, sub_delta_);
+		}
+
 		bool facts::add(const std::string& s)
 		{
 			generate_return r = hyper::logic::generate(s, funcs);
@@ -326,7 +770,45 @@ namespace hyper {
 			if (!boost::logic::indeterminate(res)) 
 				return res;
 			
-			// we don't have conclusion from evaluation, check in the know fact
+			return known(f);
+		}
+
+		void facts::matches(const std::vector<function_call>& v, 
+							std::vector<boost::logic::tribool>& res)
+		{
+			matches_(v.begin(), v.end(), res);
+		}
+
+		void facts::matches(functionId id, std::vector<boost::logic::tribool>& res)
+		{
+			const expressionS& c = category(id);
+			matches_(c.begin(), c.end(), res);
+		}
+
+		template <typename Iterator>
+		void facts::matches_(Iterator begin, Iterator end, 
+							 std::vector<boost::logic::tribool>& res)
+		{
+			std::vector<function_call> to_exec;
+			while (begin != end) {
+				functionId id = begin->id;
+				Iterator it = begin;
+				to_exec.clear();
+				for (; it != end && it->id == id; ++it)
+					to_exec.push_back(prepare_function_to_exec(db.adapt(*it), db));
+
+				size_t first = res.size();
+				funcs.get(id).eval_pred->eval_all(to_exec, res);
+
+				for (size_t i = first; begin != it; ++begin, ++i)
+					if (boost::logic::indeterminate(res[i]))
+						res[i] = known(*begin);
+			}
+		}
+
+		// we don't have conclusion from evaluation, check in the know fact
+		boost::logic::tribool facts::known(const function_call& f)
+		{
 			function_call adapted(db.adapt(f));
 			const function_def& def = funcs.get(adapted.id);
 
@@ -334,31 +816,37 @@ namespace hyper {
 				return boost::apply_visitor(unified_helper(db), adapted.args[0].expr,
 																adapted.args[1].expr);
 			
-			if (adapted.id >= list.size())
+			if (adapted.id >= list.size() || !list[adapted.id])
 				return boost::logic::indeterminate;
 
-			expressionS::const_iterator it = list[adapted.id].begin();
-			bool has_matched = false;
-			while (!has_matched && it != list[adapted.id].end())
-			{
-				has_matched = (adapted == *it);
-				++it;
-			}
-			
-			if (has_matched) 
-				return has_matched;
+			if (list[adapted.id]->find(adapted) != list[adapted.id]->end())
+				return true;
 			return boost::logic::indeterminate;
 		}
 
+		/* 
+		 * The facts are in the order of their terms, which depends on the
+		 * history of the term table, so sort them before dumping them, the
+		 * dump being compared between runs
+		 */
+		template <typename S>
+		void dump_sorted(std::ostream& os, const S& s, const char* sep)
+		{
+			std::vector<expression> v(s.begin(), s.end());
+			std::sort(v.begin(), v.end());
+			std::copy(v.begin(), v.end(), std::ostream_iterator<expression> (os, sep));
+		}
+
 		struct dump_facts
 		{
 			std::ostream& os;
 
 			dump_facts(std::ostream& os_) : os(os_) {}
 
-			void operator() (const facts::expressionS& s) const
+			void operator() (const boost::shared_ptr<facts::expressionS>& s) const
 			{
-				std::copy(s.begin(), s.end(), std::ostream_iterator<expression> ( os, "\n"));
+				if (s)
+					dump_sorted(os, *s, "\n");
 			}
 		};
 
@@ -367,9 +855,10 @@ namespace hyper {
 
 			dump_sublist_facts(std::ostream& os) : os(os) {}
 
-			void operator() (const facts::sub_expressionS& s) const
+			void operator() (const boost::shared_ptr<facts::sub_expressionS>& s) const
 			{
-				std::copy(s.begin(), s.end(), std::ostream_iterator<expression> (os, ", "));
+				if (s)
+					dump_sorted(os, *s, ", ");
 				os << "\n";
 			}
 		};
@@ -391,6 +880,32 @@ namespace hyper {
 			}
 		};
 
+		std::vector<function_call> facts::equal_candidates(const function_call& f)
+		{
+			function_call adapted(db.adapt(f));
+			assert(adapted.args.size() == 2);
+
+			std::vector<expression> terms[2];
+			for (size_t i = 0; i < 2; ++i) {
+				terms[i].push_back(adapted.args[i]);
+				std::vector<logic_var::identifier_type> vars = db.bound_to(adapted.args[i]);
+				std::copy(vars.begin(), vars.end(), std::back_inserter(terms[i]));
+			}
+
+			std::vector<function_call> res;
+			for (size_t i = 0; i < terms[0].size(); ++i) 
+				for (size_t j = 0; j < terms[1].size(); ++j) {
+					function_call current(adapted);
+					current.args[0] = terms[0][i];
+					current.args[1] = terms[1][j];
+					res.push_back(current);
+					std::swap(current.args[0], current.args[1]);
+					res.push_back(current);
+				}
+
+			return res;
+		}
+
 		std::vector<function_call> facts::generate_all(const function_call& f) const
 		{
 			return  db.deadapt(f);
@@ -1,11 +1,12 @@
 #include <logic/function_def.hh>
 #include <logic/eval.hh>
+#include <logic/term.hh>
 
 #include <boost/optional/optional.hpp>
 
 namespace hyper {
 	namespace logic {
-		funcDefList::funcDefList()
+		funcDefList::funcDefList() : terms_(new term_table(*this))
 		{
 			list_eval.push_back(new eval<notAPredicate, 0>());
 		}
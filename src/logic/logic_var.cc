@@ -6,17 +6,29 @@
 #include <utils/algorithm.hh>
 
 #include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
 
+/*
+ * The generator is shared by all the logic_var_db, which may live in
+ * different threads (see engine::parallel_infer_all).
+ */
 static int generator;
+static boost::mutex generator_mutex;
 
 
 namespace {
 	using namespace hyper::logic;
 	logic_var::identifier_type new_identifier() 
 	{
+		int id;
+		{
+			boost::mutex::scoped_lock lock(generator_mutex);
+			id = generator++;
+		}
 		std::ostringstream oss;
-		oss << "__L" << generator++;
+		oss << "__L" << id;
 		return oss.str();
 	}
 
@@ -155,6 +167,17 @@ namespace {
 		}
 	};
 
+	/* Follow the chain of permutations starting from id */
+	logic_var::identifier_type final_name(const adapt_res::permutationSeq& seq,
+										  const logic_var::identifier_type& id)
+	{
+		logic_var::identifier_type res = id;
+		adapt_res::permutationSeq::const_iterator it;
+		while ((it = std::find_if(seq.begin(), seq.end(), find_predicate(res))) != seq.end())
+			res = it->second;
+		return res;
+	}
+
 	struct apply_perms {
 		const adapt_res::permutationSeq& perms;
 
@@ -173,15 +196,39 @@ namespace {
 		}
 	};
 
+	/* Keep logic_var_db::values in sync with the value of var id */
+	void index_value(logic_var_db::value_index_type& values,
+					 const logic_var::identifier_type& id, const logic_var& var)
+	{
+		if (var.value)
+			values[*var.value].insert(id);
+	}
+
+	void unindex_value(logic_var_db::value_index_type& values,
+					   const logic_var::identifier_type& id, const logic_var& var)
+	{
+		if (!var.value)
+			return;
+
+		logic_var_db::value_index_type::iterator it = values.find(*var.value);
+		if (it == values.end())
+			return;
+		it->second.erase(id);
+		if (it->second.empty())
+			values.erase(it);
+	}
+
 	struct unify_helper : public boost::static_visitor<bool>
 	{
 		logic_var_db::bm_type& bm;
 		logic_var_db::map_type& m;
+		logic_var_db::value_index_type& values;
 		adapt_res::permutationSeq& seq;
 
 		unify_helper(logic_var_db::bm_type& bm, logic_var_db::map_type& m,
+					 logic_var_db::value_index_type& values,
 					 adapt_res::permutationSeq& seq) : 
-			bm(bm), m(m), seq(seq) {}
+			bm(bm), m(m), values(values), seq(seq) {}
 
 		template <typename U>
 		bool do_unify(const std::string& s, const Constant<U>& u) const
@@ -195,6 +242,7 @@ namespace {
 	
 			it->second.value = u;
 			it->second.unified.push_back(u);
+			index_value(values, s, it->second);
 			return true;
 		}
 
@@ -224,15 +272,28 @@ namespace {
 
 		void apply_permutations(std::vector<adapt_res::permutation>& perms) const
 		{
+			/* 
+			 * replace_key moves the elements in the view, so iterate on a
+			 * copy of the keys
+			 */
+			std::vector<expression> keys;
 			logic_var_db::bm_type::right_iterator it;
-			for (it = bm.right.begin(); it != bm.right.end(); ++it) {
+			for (it = bm.right.begin(); it != bm.right.end(); ++it)
+				keys.push_back(it->first);
+
+			for (size_t i = 0; i < keys.size(); ++i) {
+				it = bm.right.find(keys[i]);
 				expression e = apply_permutation_on_facts(it->first, perms);
 				bool success = bm.right.replace_key(it, e);
 				// it means that the same fact appears twice, so we need to aggregate them
 				if (!success) {
 					logic_var_db::bm_type::right_iterator it2 = bm.right.find(e);
 					perms.push_back(std::make_pair(it->second, it2->second));
-					m.erase(it->second);
+					logic_var_db::map_type::iterator it_var = m.find(it->second);
+					if (it_var != m.end()) {
+						unindex_value(values, it_var->first, it_var->second);
+						m.erase(it_var);
+					}
 					bm.right.erase(it);
 					return apply_permutations(perms);
 				}
@@ -261,22 +322,30 @@ namespace {
 			std::copy(it2->second.unified.begin(), it2->second.unified.end(),
 					  std::back_inserter(var.unified));
 
+			unindex_value(values, s1, it1->second);
+			unindex_value(values, s2, it2->second);
 			m.erase(it2);
 			it1->second = var;
+			index_value(values, s1, var);
 
 			seq.push_back(std::make_pair(s2, s1));
 			apply_permutations(seq);
 
-			logic_var_db::bm_type::left_iterator it = bm.left.begin();
-			while (it != bm.left.end()) {
-				adapt_res::permutationSeq::const_iterator it2;
-				it2 = std::find_if(seq.begin(), seq.end(), find_predicate(it->first));
-				if (it2 != seq.end()) {
-					bm.left.replace_key(it, it2->second);
-					it = bm.left.begin();
-				} else {
-					++it;
-				}
+			/*
+			 * Rename the merged logic variables. Only the entries of the
+			 * renamed variables are touched, so the cost of a merge is
+			 * proportional to the size of the merged classes.
+			 */
+			adapt_res::permutationSeq::const_iterator p;
+			for (p = seq.begin(); p != seq.end(); ++p) {
+				typedef logic_var_db::bm_type::left_iterator left_iterator;
+				logic_var::identifier_type target = final_name(seq, p->first);
+				std::pair<left_iterator, left_iterator> range = bm.left.equal_range(p->first);
+				std::vector<left_iterator> to_rename;
+				for (left_iterator it = range.first; it != range.second; ++it)
+					to_rename.push_back(it);
+				for (size_t i = 0; i < to_rename.size(); ++i)
+					bm.left.replace_key(to_rename[i], target);
 			}
 
 			// update facts stored in logic_var with the permutations
@@ -286,10 +355,11 @@ namespace {
 	};
 
 	bool unify(logic_var_db::bm_type& bm, logic_var_db::map_type& m, 
+			   logic_var_db::value_index_type& values,
 			   const expression& e1, const expression& e2,
 			   adapt_res::permutationSeq& seq)
 	{
-		return boost::apply_visitor(unify_helper(bm, m, seq), e1.expr, e2.expr);
+		return boost::apply_visitor(unify_helper(bm, m, values, seq), e1.expr, e2.expr);
 	}
 
 	struct are_newly_introduced {
@@ -402,9 +472,11 @@ namespace {
 		template <typename T>
 	    expression operator() (const T& t) const { return t; }
 
+		/* symbols which are not logic variables are kept as is */
 		expression operator() (const std::string& sym) const {
 			logic_mappingM::const_iterator it = m.find(sym);
-			assert(it != m.end());
+			if (it == m.end())
+				return sym;
 			return it->second;
 		}
 
@@ -499,7 +571,109 @@ function_call
 logic_var_db::adapt(const function_call& f)
 {
 	std::vector<logic_var::identifier_type> v;
-	return adapt_function_call(bm, m_logic_var, v, f);
+	function_call res = adapt_function_call(bm, m_logic_var, v, f);
+	log_new_vars(v);
+	return res;
+}
+
+void
+logic_var_db::log_new_vars(const std::vector<logic_var::identifier_type>& v)
+{
+	if (!transaction_.active || transaction_.saved)
+		return;
+
+	std::copy(v.begin(), v.end(), std::back_inserter(transaction_.new_vars));
+}
+
+void
+logic_var_db::log_unify(const expression& e1, const expression& e2)
+{
+	if (!transaction_.active || transaction_.saved)
+		return;
+
+	const std::string* s1 = boost::get<std::string>(&e1.expr);
+	const std::string* s2 = boost::get<std::string>(&e2.expr);
+
+	if (s1 && s2 && *s1 != *s2) {
+		transaction_.saved = true;
+		transaction_.bm = bm;
+		transaction_.m_logic_var = m_logic_var;
+		transaction_.values = values;
+		return;
+	}
+
+	const std::string* s = s1 ? s1 : s2;
+	if (!s) 
+		return;
+
+	// newly introduced variables are simply removed on rollback
+	if (std::find(transaction_.new_vars.begin(), transaction_.new_vars.end(), *s) 
+			!= transaction_.new_vars.end())
+		return;
+
+	if (transaction_.modified_vars.find(*s) == transaction_.modified_vars.end())
+		transaction_.modified_vars.insert(std::make_pair(*s, get(*s)));
+}
+
+void
+logic_var_db::begin_transaction()
+{
+	assert(!transaction_.active);
+	transaction_ = transaction_type();
+	transaction_.active = true;
+}
+
+void
+logic_var_db::commit()
+{
+	assert(transaction_.active);
+	transaction_ = transaction_type();
+}
+
+bool
+logic_var_db::transaction_changes(std::vector<logic_var::identifier_type>& vars) const
+{
+	if (!transaction_.active || transaction_.saved)
+		return false;
+
+	map_type::const_iterator it;
+	for (it = transaction_.modified_vars.begin(); it != transaction_.modified_vars.end(); ++it)
+		vars.push_back(it->first);
+	return true;
+}
+
+void
+logic_var_db::rollback()
+{
+	assert(transaction_.active);
+
+	if (transaction_.saved) {
+		std::swap(bm, transaction_.bm);
+		std::swap(m_logic_var, transaction_.m_logic_var);
+		std::swap(values, transaction_.values);
+	}
+
+	std::vector<logic_var::identifier_type>::const_iterator it;
+	for (it = transaction_.new_vars.begin(); it != transaction_.new_vars.end(); ++it) {
+		bm.left.erase(*it);
+		map_type::iterator it_var = m_logic_var.find(*it);
+		if (it_var != m_logic_var.end()) {
+			unindex_value(values, it_var->first, it_var->second);
+			m_logic_var.erase(it_var);
+		}
+	}
+
+	map_type::const_iterator it_var;
+	for (it_var = transaction_.modified_vars.begin(); 
+		 it_var != transaction_.modified_vars.end(); ++it_var) {
+		map_type::iterator current = m_logic_var.find(it_var->first);
+		if (current != m_logic_var.end())
+			unindex_value(values, current->first, current->second);
+		m_logic_var[it_var->first] = it_var->second;
+		index_value(values, it_var->first, it_var->second);
+	}
+
+	transaction_ = transaction_type();
 }
 
 adapt_res 
@@ -508,11 +682,13 @@ logic_var_db::adapt_and_unify(const function_call& f)
 	// track newly introduced logic variable
 	std::vector<logic_var::identifier_type> v;
 	function_call f_res = adapt_function_call(bm, m_logic_var, v, f);
+	log_new_vars(v);
 	const function_def& def = funcs.get(f_res.id);
 
 	adapt_res::permutationSeq perms;
 	if (def.unify_predicate) {
-		bool res = unify(bm, m_logic_var, f_res.args[0], f_res.args[1], perms);
+		log_unify(f_res.args[0], f_res.args[1]);
+		bool res = unify(bm, m_logic_var, values, f_res.args[0], f_res.args[1], perms);
 		if (!res)
 			return adapt_res::conflicting_facts();
 		else {
@@ -526,6 +702,15 @@ logic_var_db::adapt_and_unify(const function_call& f)
 	return f_res;
 }
 
+void
+logic_var_db::clear()
+{
+	assert(!transaction_.active);
+	bm.clear();
+	m_logic_var.clear();
+	values.clear();
+}
+
 const logic_var&
 logic_var_db::get(const logic_var::identifier_type& id) const
 {
@@ -535,6 +720,15 @@ logic_var_db::get(const logic_var::identifier_type& id) const
 	return it->second;
 }
 
+std::vector<logic_var::identifier_type>
+logic_var_db::bound_to(const expression& e) const
+{
+	value_index_type::const_iterator it = values.find(e);
+	if (it == values.end())
+		return std::vector<logic_var::identifier_type>();
+	return std::vector<logic_var::identifier_type>(it->second.begin(), it->second.end());
+}
+
 std::vector<function_call> 
 logic_var_db::deadapt(const function_call& f) const
 {
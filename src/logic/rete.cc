@@ -0,0 +1,468 @@
+#include <logic/rete.hh>
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+#include <boost/variant/get.hpp>
+
+namespace {
+	using namespace hyper::logic;
+
+	/*
+	 * Compute the shape of a condition : its variables are renamed in the
+	 * order of their first occurrence, so that conditions which only differ
+	 * by the name of their variables share the same alpha node.
+	 */
+	function_call alpha_pattern(const function_call& cond, bool& nested)
+	{
+		function_call res(cond);
+		std::map<std::string, std::string> renamed;
+		nested = false;
+
+		for (size_t i = 0; i < res.args.size(); ++i) {
+			if (boost::get<function_call>(&res.args[i].expr)) {
+				nested = true;
+				continue;
+			}
+
+			const std::string* s = boost::get<std::string>(&res.args[i].expr);
+			if (!s)
+				continue;
+
+			std::map<std::string, std::string>::const_iterator it = renamed.find(*s);
+			if (it == renamed.end()) {
+				std::ostringstream oss;
+				oss << "_" << renamed.size();
+				it = renamed.insert(std::make_pair(*s, oss.str())).first;
+			}
+			res.args[i] = it->second;
+		}
+
+		return res;
+	}
+
+	/*
+	 * Check the constants of the pattern, and the repeated variables, as
+	 * unify does
+	 */
+	bool match_alpha(const function_call& pattern, const function_call& f)
+	{
+		std::map<std::string, size_t> first;
+		for (size_t i = 0; i < pattern.args.size(); ++i) {
+			const std::string* s = boost::get<std::string>(&pattern.args[i].expr);
+			if (!s) {
+				if (compare(pattern.args[i], f.args[i]) != 0)
+					return false;
+				continue;
+			}
+
+			std::map<std::string, size_t>::const_iterator it = first.find(*s);
+			if (it == first.end())
+				first.insert(std::make_pair(*s, i));
+			else if (compare(f.args[it->second], f.args[i]) != 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	struct deeper {
+		const std::vector<size_t>& depth;
+
+		deeper(const std::vector<size_t>& depth) : depth(depth) {}
+
+		bool operator() (size_t n1, size_t n2) const
+		{
+			return depth[n1] > depth[n2];
+		}
+	};
+}
+
+namespace hyper {
+	namespace logic {
+		const size_t rete_network::root;
+
+		size_t rete_network::get_alpha(const function_call& cond)
+		{
+			bool nested;
+			function_call pattern = alpha_pattern(cond, nested);
+
+			std::map<function_call, size_t>::const_iterator it = alpha_map_.find(pattern);
+			if (it != alpha_map_.end())
+				return it->second;
+
+			alpha_node a;
+			a.id = cond.id;
+			a.pattern = pattern;
+			a.never = nested;
+			alpha_.push_back(a);
+
+			size_t res = alpha_.size() - 1;
+			alpha_map_.insert(std::make_pair(pattern, res));
+			if (cond.id >= alpha_by_id_.size())
+				alpha_by_id_.resize(cond.id + 1);
+			alpha_by_id_[cond.id].push_back(res);
+			return res;
+		}
+
+		size_t rete_network::get_beta(size_t parent, const function_call& cond)
+		{
+			std::pair<size_t, function_call> key(parent, cond);
+			std::map<std::pair<size_t, function_call>, size_t>::const_iterator it;
+			it = beta_map_.find(key);
+			if (it != beta_map_.end())
+				return it->second;
+
+			beta_node b;
+			b.parent = parent;
+			b.alpha = get_alpha(cond);
+			b.depth = 1;
+			if (parent != root) {
+				b.depth = beta_[parent].depth + 1;
+				b.vars = beta_[parent].vars;
+			}
+			size_t parent_size = b.vars.size();
+
+			b.join_pos.resize(cond.args.size(), -1);
+			b.key_arg = -1;
+			b.key_token = -1;
+			for (size_t i = 0; i < cond.args.size(); ++i) {
+				const std::string* s = boost::get<std::string>(&cond.args[i].expr);
+				if (!s)
+					continue;
+				std::vector<std::string>::const_iterator it_var;
+				it_var = std::find(b.vars.begin(), b.vars.end(), *s);
+				if (it_var == b.vars.end()) {
+					b.vars.push_back(*s);
+					b.new_args.push_back(i);
+				} else if (size_t(it_var - b.vars.begin()) < parent_size) {
+					b.join_pos[i] = it_var - b.vars.begin();
+					if (b.key_arg < 0) {
+						b.key_arg = i;
+						b.key_token = b.join_pos[i];
+					}
+				}
+				/* else the equality is checked by the alpha node */
+			}
+
+			beta_.push_back(b);
+			size_t res = beta_.size() - 1;
+			beta_map_.insert(std::make_pair(key, res));
+
+			if (parent == root)
+				root_children_.push_back(res);
+			else
+				beta_[parent].children.push_back(res);
+
+			/*
+			 * The deepest successors must be activated first, otherwise a
+			 * fact used by two conditions of the same rule would be joined
+			 * twice with itself.
+			 */
+			std::vector<size_t> depth(beta_.size());
+			for (size_t i = 0; i < beta_.size(); ++i)
+				depth[i] = beta_[i].depth;
+			std::vector<size_t>& succ = alpha_[b.alpha].successors;
+			succ.push_back(res);
+			std::stable_sort(succ.begin(), succ.end(), deeper(depth));
+
+			return res;
+		}
+
+		void rete_network::compile(const rules& rs)
+		{
+			rules::const_iterator it = rs.begin() + nb_rules_;
+			for (; it != rs.end(); ++it) {
+				size_t id = it - rs.begin();
+				terminals_.push_back(terminal());
+
+				/* inconsistency rules never produce any fact */
+				if (it->inconsistency())
+					continue;
+
+				terminal& t = terminals_.back();
+				t.token_pos.resize(it->symbols.size(), -1);
+
+				if (it->condition.empty()) {
+					t.node = root;
+					empty_rules_.push_back(id);
+					continue;
+				}
+
+				size_t node = root;
+				for (size_t i = 0; i < it->condition.size(); ++i)
+					node = get_beta(node, it->condition[i]);
+
+				t.node = node;
+				beta_[node].rules.push_back(id);
+				const std::vector<std::string>& vars = beta_[node].vars;
+				for (size_t i = 0; i < it->symbols.size(); ++i) {
+					std::vector<std::string>::const_iterator it_var;
+					it_var = std::find(vars.begin(), vars.end(), it->symbols[i]);
+					if (it_var != vars.end())
+						t.token_pos[i] = it_var - vars.begin();
+				}
+			}
+
+			nb_rules_ = rs.size();
+		}
+
+		bool rete_network::is_valid(const rete_memory& m, const facts& fs) const
+		{
+			return m.valid && m.generation == fs.generation() &&
+				   m.alpha.size() == alpha_.size() && m.beta.size() == beta_.size();
+		}
+
+		void rete_network::emit(size_t node, const substitution& token, matchV& res) const
+		{
+			const std::vector<size_t>& rs = beta_[node].rules;
+			for (size_t i = 0; i < rs.size(); ++i) {
+				const terminal& t = terminals_[rs[i]];
+				match m;
+				m.rule = rs[i];
+				m.s = substitution(t.token_pos.size());
+				for (size_t j = 0; j < t.token_pos.size(); ++j)
+					if (t.token_pos[j] >= 0)
+						m.s[j] = token[t.token_pos[j]];
+				res.push_back(m);
+			}
+		}
+
+		bool rete_network::join(size_t node, const substitution& token, const function_call& f,
+								substitution& new_token) const
+		{
+			const beta_node& b = beta_[node];
+			for (size_t i = 0; i < b.join_pos.size(); ++i)
+				if (b.join_pos[i] >= 0 && compare(f.args[i], token[b.join_pos[i]]) != 0)
+					return false;
+
+			new_token = token;
+			for (size_t i = 0; i < b.new_args.size(); ++i)
+				new_token.push_back(f.args[b.new_args[i]]);
+			return true;
+		}
+
+		void rete_network::left_activate(rete_memory& m, size_t node, const substitution& token,
+										 matchV& res) const
+		{
+			emit(node, token, res);
+
+			const std::vector<size_t>& children = beta_[node].children;
+			if (children.empty())
+				return;
+
+			m.beta[node].push_back(token);
+			size_t pos = m.beta[node].size() - 1;
+			for (size_t i = 0; i < children.size(); ++i) {
+				const beta_node& child = beta_[children[i]];
+				if (child.key_arg >= 0)
+					m.index(true, children[i], token[child.key_token], pos);
+			}
+
+			for (size_t i = 0; i < children.size(); ++i) {
+				const beta_node& child = beta_[children[i]];
+				const std::vector<const function_call*>& facts_ = m.alpha[child.alpha];
+				substitution new_token;
+
+				if (child.key_arg < 0) {
+					size_t size = facts_.size();
+					for (size_t j = 0; j < size; ++j)
+						if (join(children[i], token, *facts_[j], new_token))
+							left_activate(m, children[i], new_token, res);
+					continue;
+				}
+
+				rete_memory::indexM::const_iterator it;
+				it = m.right[children[i]].find(token[child.key_token]);
+				if (it == m.right[children[i]].end())
+					continue;
+				const std::vector<size_t>& candidates = it->second;
+				size_t size = candidates.size();
+				for (size_t j = 0; j < size; ++j)
+					if (join(children[i], token, *facts_[candidates[j]], new_token))
+						left_activate(m, children[i], new_token, res);
+			}
+		}
+
+		void rete_network::right_activate(rete_memory& m, size_t node, const function_call& f,
+										  matchV& res) const
+		{
+			const beta_node& b = beta_[node];
+			substitution new_token;
+
+			if (b.parent == root) {
+				if (join(node, substitution(), f, new_token))
+					left_activate(m, node, new_token, res);
+				return;
+			}
+
+			const std::vector<substitution>& tokens = m.beta[b.parent];
+			if (b.key_arg < 0) {
+				size_t size = tokens.size();
+				for (size_t k = 0; k < size; ++k)
+					if (join(node, tokens[k], f, new_token))
+						left_activate(m, node, new_token, res);
+				return;
+			}
+
+			rete_memory::indexM::const_iterator it = m.left[node].find(f.args[b.key_arg]);
+			if (it == m.left[node].end())
+				return;
+			const std::vector<size_t>& candidates = it->second;
+			size_t size = candidates.size();
+			for (size_t k = 0; k < size; ++k)
+				if (join(node, tokens[candidates[k]], f, new_token))
+					left_activate(m, node, new_token, res);
+		}
+
+		void rete_network::add_fact(rete_memory& m, const function_call& f, matchV& res) const
+		{
+			if (f.id >= alpha_by_id_.size())
+				return;
+
+			const std::vector<size_t>& alphas = alpha_by_id_[f.id];
+			for (size_t i = 0; i < alphas.size(); ++i) {
+				const alpha_node& a = alpha_[alphas[i]];
+				if (a.never || !match_alpha(a.pattern, f))
+					continue;
+
+				m.alpha[alphas[i]].push_back(&f);
+				size_t pos = m.alpha[alphas[i]].size() - 1;
+				for (size_t j = 0; j < a.successors.size(); ++j) {
+					const beta_node& b = beta_[a.successors[j]];
+					if (b.key_arg >= 0)
+						m.index(false, a.successors[j], f.args[b.key_arg], pos);
+				}
+
+				for (size_t j = 0; j < a.successors.size(); ++j)
+					right_activate(m, a.successors[j], f, res);
+			}
+		}
+
+		void rete_network::reset(rete_memory& m, const facts& fs, matchV& res) const
+		{
+			m.alpha.assign(alpha_.size(), std::vector<const function_call*>());
+			m.beta.assign(beta_.size(), std::vector<substitution>());
+			m.right.assign(beta_.size(), rete_memory::indexM());
+			m.left.assign(beta_.size(), rete_memory::indexM());
+			m.log.clear();
+			m.valid = true;
+			m.generation = fs.generation();
+			if (m.in_transaction)
+				m.rebuilt = true;
+
+			for (size_t i = 0; i < empty_rules_.size(); ++i) {
+				match mt;
+				mt.rule = empty_rules_[i];
+				mt.s = substitution(terminals_[empty_rules_[i]].token_pos.size());
+				res.push_back(mt);
+			}
+
+			for (functionId id = 0; id < alpha_by_id_.size(); ++id) {
+				if (alpha_by_id_[id].empty())
+					continue;
+				for (facts::const_iterator it = fs.begin(id); it != fs.end(id); ++it)
+					add_fact(m, *it, res);
+			}
+		}
+
+		void rete_network::update(rete_memory& m, const facts& fs,
+								  const facts::delta_type& delta, matchV& res) const
+		{
+			/* allocate the categories before taking pointers on the facts */
+			for (functionId id = 0; id < alpha_by_id_.size(); ++id)
+				fs.size(id);
+
+			if (delta.all || !is_valid(m, fs)) {
+				reset(m, fs, res);
+				return;
+			}
+
+			for (functionId id = 0; id < alpha_by_id_.size() && id < delta.list.size(); ++id) {
+				if (alpha_by_id_[id].empty())
+					continue;
+				for (facts::const_iterator it = delta.begin(id); it != delta.end(id); ++it) {
+					facts::const_iterator it_f = fs.find(*it);
+					assert(it_f != fs.end(id));
+					add_fact(m, *it_f, res);
+				}
+			}
+		}
+
+		void rete_memory::clear()
+		{
+			valid = false;
+			generation = 0;
+			alpha.clear();
+			beta.clear();
+			right.clear();
+			left.clear();
+			log.clear();
+			in_transaction = false;
+			rebuilt = false;
+			saved_alpha.clear();
+			saved_beta.clear();
+		}
+
+		void rete_memory::index(bool is_left, size_t node, const expression& key, size_t pos)
+		{
+			std::vector<indexM>& v = is_left ? left : right;
+			v[node][key].push_back(pos);
+
+			if (in_transaction && !rebuilt) {
+				index_log l;
+				l.is_left = is_left;
+				l.node = node;
+				l.key = key;
+				log.push_back(l);
+			}
+		}
+
+		void rete_memory::begin_transaction()
+		{
+			in_transaction = true;
+			log.clear();
+			rebuilt = false;
+			saved_valid = valid;
+			saved_alpha.resize(alpha.size());
+			for (size_t i = 0; i < alpha.size(); ++i)
+				saved_alpha[i] = alpha[i].size();
+			saved_beta.resize(beta.size());
+			for (size_t i = 0; i < beta.size(); ++i)
+				saved_beta[i] = beta[i].size();
+		}
+
+		void rete_memory::commit()
+		{
+			in_transaction = false;
+			log.clear();
+		}
+
+		void rete_memory::rollback()
+		{
+			in_transaction = false;
+			if (!saved_valid || rebuilt) {
+				valid = false;
+				log.clear();
+				return;
+			}
+
+			std::vector<index_log>::const_reverse_iterator it;
+			for (it = log.rbegin(); it != log.rend(); ++it) {
+				indexM& idx = it->is_left ? left[it->node] : right[it->node];
+				indexM::iterator it_key = idx.find(it->key);
+				assert(it_key != idx.end());
+				it_key->second.pop_back();
+				if (it_key->second.empty())
+					idx.erase(it_key);
+			}
+			log.clear();
+
+			for (size_t i = 0; i < alpha.size(); ++i)
+				alpha[i].resize(saved_alpha[i]);
+			for (size_t i = 0; i < beta.size(); ++i)
+				beta[i].erase(beta[i].begin() + saved_beta[i], beta[i].end());
+		}
+	}
+}
@@ -1,6 +1,8 @@
 #include <logic/rules.hh>
 #include <algorithm>
+#include <cassert>
 #include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
 
 namespace {
 	using namespace hyper::logic;
@@ -80,14 +82,40 @@ namespace {
 		}
 	};
 
+	struct compute_slots
+	{
+		const rule::list_symbols& symbols;
+		rule::slots_type& slots;
+
+		compute_slots(const rule::list_symbols& symbols, rule::slots_type& slots) :
+			symbols(symbols), slots(slots) {}
+
+		void operator() (const function_call& f)
+		{
+			std::vector<int> v(f.args.size(), -1);
+			for (size_t i = 0; i < f.args.size(); ++i) {
+				const std::string* s = boost::get<std::string>(&f.args[i].expr);
+				if (!s) 
+					continue;
+				rule::list_symbols::const_iterator it;
+				it = std::lower_bound(symbols.begin(), symbols.end(), *s);
+				assert(it != symbols.end() && *it == *s);
+				v[i] = it - symbols.begin();
+			}
+			slots.push_back(v);
+		}
+	};
+
 	template <typename FactT>
 	bool add_helper(const std::string& identifier,
 				    const typename std::vector<FactT>& cond,
 				    const typename std::vector<FactT>& action,
 				    const funcDefList& funcs,
-				    std::vector<rule>& r_)
+				    std::vector<rule>& r_,
+					const rule::matcher_type& m = rule::matcher_type())
 	{
 		rule r;
+		r.matcher = m;
 		{
 		bool res = true;
 		converter c(res, funcs, r.condition);
@@ -108,6 +136,11 @@ namespace {
 
 		std::for_each(r.symbol_to_fun.begin(), r.symbol_to_fun.end(), list_keys(r.symbols));
 
+		std::for_each(r.condition.begin(), r.condition.end(), 
+					  compute_slots(r.symbols, r.condition_slots));
+		std::for_each(r.action.begin(), r.action.end(), 
+					  compute_slots(r.symbols, r.action_slots));
+
 		r_.push_back(r);
 		return true;
 	}
@@ -141,6 +174,14 @@ namespace hyper {
 			return add_helper(identifier, cond, action, funcs, r_);
 		}
 
+		bool rules::add(const std::string& identifier,
+						const std::vector<function_call>& cond,
+						const std::vector<function_call>& action,
+						const rule::matcher_type& m)
+		{
+			return add_helper(identifier, cond, action, funcs, r_, m);
+		}
+
 		std::ostream& operator << (std::ostream& os, const rules& r)
 		{
 			std::copy(r.begin(), r.end(), std::ostream_iterator<rule> ( os, "\n"));
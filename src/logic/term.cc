@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cstring>
+
+#include <logic/term.hh>
+
+#include <boost/functional/hash.hpp>
+#include <boost/variant/apply_visitor.hpp>
+
+namespace hyper {
+	namespace logic {
+		namespace {
+			boost::uint64_t double_bits(double d)
+			{
+				// 0.0 and -0.0 are equal for compare, so they have the same term
+				if (d == 0.0)
+					d = 0.0;
+				boost::uint64_t res;
+				std::memcpy(&res, &d, sizeof(res));
+				return res;
+			}
+
+			double bits_double(boost::uint64_t bits)
+			{
+				double res;
+				std::memcpy(&res, &bits, sizeof(res));
+				return res;
+			}
+
+			/* The terms of the arguments of a function_call, not allocated for usual arities */
+			class args_buffer {
+				private:
+					term small[8];
+					std::vector<term> large;
+					term* p;
+
+				public:
+					explicit args_buffer(size_t n) : p(small) {
+						if (n > sizeof(small) / sizeof(small[0])) {
+							large.resize(n);
+							p = &large[0];
+						}
+					}
+
+					term& operator[] (size_t i) { return p[i]; }
+					const term* data() const { return p; }
+			};
+		}
+
+		std::size_t term_table::node_hash::operator() (const node_ref& r) const
+		{
+			std::size_t seed = r.kind;
+			boost::hash_combine(seed, r.value);
+			boost::hash_range(seed, r.args, r.args + r.size);
+			return seed;
+		}
+
+		std::size_t term_table::node_hash::operator() (const node& n) const
+		{
+			std::size_t seed = n.kind;
+			boost::hash_combine(seed, n.value);
+			boost::hash_range(seed, n.args.begin(), n.args.end());
+			return seed;
+		}
+
+		bool term_table::node_equal::operator() (const node_ref& r, const node& n) const
+		{
+			return r.kind == n.kind && r.value == n.value && r.size == n.args.size() &&
+				   std::equal(r.args, r.args + r.size, n.args.begin());
+		}
+
+		/*
+		 * Fill the node of an expression, but the terms of the arguments of
+		 * a function_call, which depend on the operation (make or find).
+		 * Returns false if the node refers to an unknown symbol.
+		 */
+		struct fill_node : public boost::static_visitor<bool>
+		{
+			typedef boost::unordered_map<std::string, boost::uint32_t> symbolM;
+
+			/* symbols_m and symbols are null to only find the symbols */
+			const symbolM& known;
+			symbolM* symbols_m;
+			std::vector<const std::string*>* symbols;
+			term_table::kind_type& kind;
+			boost::uint64_t& value;
+
+			fill_node(const symbolM& known, symbolM* symbols_m,
+					  std::vector<const std::string*>* symbols,
+					  term_table::kind_type& kind, boost::uint64_t& value) :
+				known(known), symbols_m(symbols_m), symbols(symbols), kind(kind),
+				value(value) {}
+
+			bool symbol(const std::string& s) const
+			{
+				symbolM::const_iterator it = known.find(s);
+				if (it != known.end()) {
+					value = it->second;
+					return true;
+				}
+
+				if (!symbols_m)
+					return false;
+
+				std::pair<symbolM::iterator, bool> p;
+				p = symbols_m->insert(std::make_pair(s, symbols->size()));
+				symbols->push_back(&p.first->first);
+				value = p.first->second;
+				return true;
+			}
+
+			bool operator() (const empty&) const { kind = term_table::empty_; return true; }
+
+			bool operator() (const Constant<int>& c) const
+			{
+				kind = term_table::int_;
+				value = static_cast<boost::uint32_t>(c.value);
+				return true;
+			}
+
+			bool operator() (const Constant<double>& c) const
+			{
+				kind = term_table::double_;
+				value = double_bits(c.value);
+				return true;
+			}
+
+			bool operator() (const Constant<std::string>& c) const
+			{
+				kind = term_table::string_;
+				return symbol(c.value);
+			}
+
+			bool operator() (const Constant<bool>& c) const
+			{
+				kind = term_table::bool_;
+				value = c.value;
+				return true;
+			}
+
+			bool operator() (const std::string& s) const
+			{
+				kind = term_table::variable_;
+				return symbol(s);
+			}
+
+			bool operator() (const function_call& f) const
+			{
+				kind = term_table::function_;
+				value = f.id;
+				return true;
+			}
+		};
+
+		struct make_term : public boost::static_visitor<term>
+		{
+			term_table& t;
+
+			make_term(term_table& t) : t(t) {}
+
+			template <typename T>
+			term operator() (const T& v) const
+			{
+				term_table::node_ref r = { term_table::empty_, 0, 0, 0 };
+				fill_node fill(t.symbols_m, &t.symbols_m, &t.symbols, r.kind, r.value);
+				fill(v);
+				return t.make_node(r);
+			}
+
+			term operator() (const function_call& f) const
+			{
+				return t.make_(f);
+			}
+		};
+
+		struct find_term : public boost::static_visitor<boost::optional<term> >
+		{
+			const term_table& t;
+
+			find_term(const term_table& t) : t(t) {}
+
+			template <typename T>
+			boost::optional<term> operator() (const T& v) const
+			{
+				term_table::node_ref r = { term_table::empty_, 0, 0, 0 };
+				fill_node fill(t.symbols_m, 0, 0, r.kind, r.value);
+				if (!fill(v))
+					return boost::none;
+				return t.find_node(r);
+			}
+
+			boost::optional<term> operator() (const function_call& f) const
+			{
+				return t.find_(f);
+			}
+		};
+
+		boost::optional<term> term_table::find_node(const node_ref& r) const
+		{
+			nodeM::const_iterator it = m.find(r, node_hash(), node_equal());
+			if (it == m.end())
+				return boost::none;
+			return it->second;
+		}
+
+		term term_table::make_node(const node_ref& r)
+		{
+			boost::optional<term> t = find_node(r);
+			if (t)
+				return *t;
+
+			node n;
+			n.kind = r.kind;
+			n.value = r.value;
+			n.args.assign(r.args, r.args + r.size);
+
+			std::pair<nodeM::iterator, bool> p;
+			p = m.insert(std::make_pair(n, nodes.size()));
+			nodes.push_back(&p.first->first);
+			return p.first->second;
+		}
+
+		term term_table::make_(const expression& e)
+		{
+			return boost::apply_visitor(make_term(*this), e.expr);
+		}
+
+		term term_table::make_(const function_call& f)
+		{
+			args_buffer args(f.args.size());
+			for (size_t i = 0; i < f.args.size(); ++i)
+				args[i] = make_(f.args[i]);
+
+			node_ref r = { function_, f.id, args.data(), f.args.size() };
+			return make_node(r);
+		}
+
+		boost::optional<term> term_table::find_(const expression& e) const
+		{
+			return boost::apply_visitor(find_term(*this), e.expr);
+		}
+
+		boost::optional<term> term_table::find_(const function_call& f) const
+		{
+			args_buffer args(f.args.size());
+			for (size_t i = 0; i < f.args.size(); ++i) {
+				boost::optional<term> arg = find_(f.args[i]);
+				if (!arg)
+					return boost::none;
+				args[i] = *arg;
+			}
+
+			node_ref r = { function_, f.id, args.data(), f.args.size() };
+			return find_node(r);
+		}
+
+		expression term_table::to_expression_(term t) const
+		{
+			assert(t < nodes.size());
+			const node& n = *nodes[t];
+			switch (n.kind) {
+				case int_:
+					return Constant<int>(static_cast<int>(static_cast<boost::uint32_t>(n.value)));
+				case double_:
+					return Constant<double>(bits_double(n.value));
+				case string_:
+					return Constant<std::string>(*symbols[n.value]);
+				case bool_:
+					return Constant<bool>(n.value != 0);
+				case variable_:
+					return *symbols[n.value];
+				case function_:
+					return to_function_call_(t);
+				default:
+					return expression();
+			}
+		}
+
+		function_call term_table::to_function_call_(term t) const
+		{
+			assert(t < nodes.size());
+			const node& n = *nodes[t];
+			assert(n.kind == function_);
+
+			function_call f;
+			f.id = n.value;
+			f.name = funcs.get(f.id).name;
+			f.args.reserve(n.args.size());
+			for (size_t i = 0; i < n.args.size(); ++i)
+				f.args.push_back(to_expression_(n.args[i]));
+			return f;
+		}
+
+		term term_table::make(const expression& e)
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			return make_(e);
+		}
+
+		term term_table::make(const function_call& f)
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			return make_(f);
+		}
+
+		boost::optional<term> term_table::find(const expression& e) const
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			return find_(e);
+		}
+
+		boost::optional<term> term_table::find(const function_call& f) const
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			return find_(f);
+		}
+
+		expression term_table::to_expression(term t) const
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			return to_expression_(t);
+		}
+
+		function_call term_table::to_function_call(term t) const
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			return to_function_call_(t);
+		}
+
+		term_table::kind_type term_table::kind(term t) const
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			assert(t < nodes.size());
+			return nodes[t]->kind;
+		}
+
+		void term_table::args(term t, std::vector<term>& args) const
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			assert(t < nodes.size());
+			args.insert(args.end(), nodes[t]->args.begin(), nodes[t]->args.end());
+		}
+
+		size_t term_table::size() const
+		{
+			boost::mutex::scoped_lock lock(mtx);
+			return nodes.size();
+		}
+	}
+}
@@ -1,4 +1,7 @@
 #include <logic/unify.hh>
+
+#include <algorithm>
+
 #include <boost/variant/apply_visitor.hpp>
 
 namespace {
@@ -85,6 +88,60 @@ namespace {
 	};
 }
 
+namespace {
+	using namespace hyper::logic;
+
+	struct is_constant_helper : public boost::static_visitor<bool>
+	{
+		template <typename T>
+		bool operator() (const T&) const { return false; }
+
+		template <typename T>
+		bool operator() (const Constant<T>&) const { return true; }
+	};
+
+	bool is_constant(const expression& e)
+	{
+		return boost::apply_visitor(is_constant_helper(), e.expr);
+	}
+
+	struct do_substitute : public boost::static_visitor<expression>
+	{
+		const std::vector<std::string>& symbols;
+		const substitution& s;
+
+		do_substitute(const std::vector<std::string>& symbols, const substitution& s) :
+			symbols(symbols), s(s) {}
+
+		template <typename T> 
+		expression operator() (const T& t) const
+		{
+			return t;
+		}
+
+		expression operator() (const std::string& sym) const
+		{
+			std::vector<std::string>::const_iterator it;
+			it = std::lower_bound(symbols.begin(), symbols.end(), sym);
+			if (it == symbols.end() || *it != sym)
+				return sym;
+
+			const expression& e = s[it - symbols.begin()];
+			if (!is_bound(e))
+				return sym;
+			return e;
+		}
+
+		expression operator() (const function_call& f) const
+		{
+			function_call res(f, true);
+			for (size_t i = 0; i < f.args.size(); ++i)
+				res.args[i] = boost::apply_visitor(*this, f.args[i].expr);
+			return res;
+		}
+	};
+}
+
 namespace hyper {
 	namespace logic {
 		unify_res unify(const function_call& f1, const function_call& f2, const unifyM& ctx)
@@ -109,6 +166,40 @@ namespace hyper {
 			return res;
 		}
 
+		bool unify(const function_call& f1, const std::vector<int>& slots,
+				   const function_call& f2, substitution& s)
+		{
+			if (f1.id != f2.id)
+				return false;
+
+			for (size_t i = 0; i < f1.args.size(); ++i) {
+				if (slots[i] < 0) {
+					/* only constants can match, as in do_unify */
+					if (!is_constant(f1.args[i]) || compare(f1.args[i], f2.args[i]) != 0)
+						return false;
+					continue;
+				}
+
+				expression& e = s[slots[i]];
+				if (!is_bound(e))
+					e = f2.args[i];
+				else if (compare(e, f2.args[i]) != 0)
+					return false;
+			}
+
+			return true;
+		}
+
+		function_call substitute(const function_call& f, 
+								 const std::vector<std::string>& symbols,
+								 const substitution& s)
+		{
+			function_call res(f, true);
+			for (size_t i = 0; i < f.args.size(); ++i)
+				res.args[i] = boost::apply_visitor(do_substitute(symbols, s), f.args[i].expr);
+			return res;
+		}
+
 		std::ostream& operator << (std::ostream& os, const unifyM& m)
 		{
 			for (unifyM::const_iterator it = m.begin(); it != m.end(); ++it)
@@ -10,6 +10,10 @@
 
 #include <hyperConfig.hh>
 
+#include <cstdlib>
+
+#include <boost/thread/thread.hpp>
+
 namespace hyper { namespace model {
 	void handle_constraint_answer(hyper::model::ability &, 
 			const boost::system::error_code&, 
@@ -283,6 +287,14 @@ namespace {
 			return boost::mpl::void_();
 		}
 	};
+
+	size_t worker_threads()
+	{
+		const char* workers = std::getenv("HYPER_WORKER_THREADS");
+		if (!workers)
+			return 0;
+		return std::strtoul(workers, 0, 10);
+	}
 }
 
 namespace hyper {
@@ -328,6 +340,8 @@ namespace hyper {
 		{}
 
 		ability::ability(const std::string& name_, int level) : 
+			nb_workers(worker_threads()),
+			parallel_preconditions(std::getenv("HYPER_PARALLEL_PRECONDITIONS") != 0),
 			discover(),
 			actor(new actor_impl(io_s, name_, level, discover)),
 			updater(*this),
@@ -357,6 +371,7 @@ namespace hyper {
 
 		void ability::start()
 		{
+			logic().end_declarations();
 			register_name();
 
 			boost::shared_ptr<get_list_agents> ptr = boost::make_shared<get_list_agents>();
@@ -379,13 +394,30 @@ namespace hyper {
 	
 		void ability::test_run()
 		{
-			io_s.run();
+			run_io_s();
 		}
 		
 		void ability::run()
 		{
 			impl->ping.run();
+			run_io_s();
+		}
+
+		void ability::run_io_s()
+		{
+			if (nb_workers == 0)
+				return (void) io_s.run();
+
+			boost::asio::io_service::work work(workers_s);
+			std::size_t (boost::asio::io_service::*run)() = &boost::asio::io_service::run;
+			boost::thread_group workers;
+			for (size_t i = 0; i < nb_workers; ++i)
+				workers.create_thread(boost::bind(run, &workers_s));
+
 			io_s.run();
+
+			workers_s.stop();
+			workers.join_all();
 		}
 	
 		void ability::stop()
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <numeric>
 
+#include <boost/functional/hash.hpp>
+
 #include <model/ability.hh>
 #include <model/compute_task_tree.hh>
 #include <model/logic_layer.hh>
@@ -80,6 +82,71 @@ namespace {
 			return (b && cond.is_succesfully_executed());
 		}
 	};
+
+	/* 
+	 * Copy of a task tree, without its execution state, so that the
+	 * cached plan is not shared with the running ones
+	 */
+	boost::shared_ptr<task_logic_evaluation> clone_task(const task_logic_evaluation& task);
+
+	cond_logic_evaluation clone_cond(const cond_logic_evaluation& cond)
+	{
+		cond_logic_evaluation res(cond.condition);
+		res.task_used = cond.task_used;
+		for (size_t i = 0; i < cond.tasks.size(); ++i)
+			res.tasks.push_back(clone_task(*cond.tasks[i]));
+		return res;
+	}
+
+	boost::shared_ptr<task_logic_evaluation> clone_task(const task_logic_evaluation& task)
+	{
+		boost::shared_ptr<task_logic_evaluation> res = 
+			boost::make_shared<task_logic_evaluation>();
+		res->name = task.name;
+		res->cond_evaluated = task.cond_evaluated;
+		res->task_used = task.task_used;
+		res->hyps = task.hyps;
+		for (size_t i = 0; i < task.conds.size(); ++i)
+			res->conds.push_back(clone_cond(task.conds[i]));
+		return res;
+	}
+
+	/* All the tasks of a tree, in depth-first order */
+	void collect_tasks(const cond_logic_evaluation& cond,
+					   std::vector<boost::shared_ptr<task_logic_evaluation> >& res)
+	{
+		for (size_t i = 0; i < cond.tasks.size(); ++i) {
+			res.push_back(cond.tasks[i]);
+			for (size_t j = 0; j < cond.tasks[i]->conds.size(); ++j)
+				collect_tasks(cond.tasks[i]->conds[j], res);
+		}
+	}
+
+	size_t task_fingerprint(const std::string& name, const conditionV& failed)
+	{
+		size_t seed = boost::hash_value(name);
+		boost::hash_range(seed, failed.begin(), failed.end());
+		return seed;
+	}
+
+	/* 
+	 * The fingerprint of a tree, computed from the failed preconditions of
+	 * its tasks, i.e. the conditions of their subtrees
+	 */
+	size_t plan_fingerprint(const cond_logic_evaluation& cond)
+	{
+		std::vector<boost::shared_ptr<task_logic_evaluation> > tasks;
+		collect_tasks(cond, tasks);
+
+		size_t seed = 0;
+		for (size_t i = 0; i < tasks.size(); ++i) {
+			conditionV failed;
+			for (size_t j = 0; j < tasks[i]->conds.size(); ++j)
+				failed.push_back(tasks[i]->conds[j].condition);
+			boost::hash_combine(seed, task_fingerprint(tasks[i]->name, failed));
+		}
+		return seed;
+	}
 }
 
 namespace hyper {
@@ -115,7 +182,9 @@ namespace hyper {
 		}
 
 		compute_task_tree::compute_task_tree(logic_layer& layer_,  logic_context& ctx_) :
-			layer(layer_), ctx(ctx_), must_interrupt(false), must_pause(false), resume_handler(boost::none)
+			layer(layer_), ctx(ctx_), must_interrupt(false), must_pause(false), resume_handler(boost::none),
+			nb_streamed(0),
+			expected_fingerprint(0), pending_plan_tasks(0), plan_error(false)
 		{}
 
 #define CHECK_INTERRUPT if (must_interrupt) return handler(false);
@@ -135,11 +204,13 @@ namespace hyper {
 				cond.tasks.erase(cond.tasks.begin() + 1, cond.tasks.end());
 				return handler(res);
 			} else {
+				if (layer.streaming_planner)
+					cancel_streams(*cond.tasks[0]);
 				cond.tasks.pop_front();
 				if (cond.tasks.empty())
 					return handler(false);
 
-				start_eval_constraint(*(cond.tasks[0]), 
+				start_eval_constraint(cond.tasks[0], 
 						boost::bind(&compute_task_tree::handle_eval_all_constraints, 
 							this, boost::ref(cond), _1, handler));
 			}
@@ -169,7 +240,7 @@ namespace hyper {
 
 			std::sort(cond.tasks.begin(), cond.tasks.end(), class_task_evaluation());
 
-			start_eval_constraint(*(cond.tasks[0]), 
+			start_eval_constraint(cond.tasks[0], 
 					boost::bind(&compute_task_tree::handle_eval_all_constraints, 
 						this, boost::ref(cond), _1, handler));
 		}
@@ -228,16 +299,18 @@ namespace hyper {
 
 
 			if (no_more) {
-				std::vector<std::string> res;
+				std::vector<boost::shared_ptr<task_logic_evaluation> > res;
+				generate_task_eval gen(cond);
 				for (size_t k = 0; k < hyp_eval.size(); ++k)
-					if (hyp_eval[k].any_true)
-						res.push_back(hyp_eval[k].hyps.name);
+					if (hyp_eval[k].any_true) {
+						res.push_back(gen(hyp_eval[k].hyps.name));
+						res.back()->hyps = hyp_eval[k].hyps.hyps;
+					}
 
 				if (res.empty())
 					return handler(false);
 				else {
-					std::transform(res.begin(), res.end(), std::back_inserter(cond.tasks),
-							generate_task_eval(cond));
+					std::copy(res.begin(), res.end(), std::back_inserter(cond.tasks));
 
 					std::for_each(cond.tasks.begin(), cond.tasks.end(),
 							async_eval_all_preconditions(*this, handler, cond));
@@ -268,73 +341,162 @@ namespace hyper {
 
 			layer.a_.logger(DEBUG) << ctx.ctr << " Searching to solve ";
 			layer.a_.logger(DEBUG) << cond.condition << std::endl;
-			std::vector<std::string> res;
-			std::vector<logic::engine::plausible_hypothesis> hyps;
 
-			std::set<std::string> unusable_tasks(failed_tasks.begin(), failed_tasks.end());
-			unusable_tasks.insert(cond.task_used.begin(), cond.task_used.end());
+			boost::shared_ptr<infer_result> r(new infer_result());
+			r->unusable_tasks.insert(failed_tasks.begin(), failed_tasks.end());
+			r->unusable_tasks.insert(cond.task_used.begin(), cond.task_used.end());
+
+			layer.async_logic(
+				boost::bind(&compute_task_tree::infer_constraint, this, boost::cref(cond.condition), r),
+				boost::bind(&compute_task_tree::handle_infer_constraint, this, boost::ref(cond), r, handler));
+		}
+
+		void
+		compute_task_tree::infer_constraint(const logic::function_call& condition,
+											boost::shared_ptr<infer_result> r)
+		{
+			layer.engine.parallel_infer_all_in(condition, std::back_inserter(r->res), 
+									  std::back_inserter(r->hyps),
+									  r->unusable_tasks.begin(), r->unusable_tasks.end(), 
+									  layer.infer_budget());
+		}
 
-			layer.engine.infer_all_in(cond.condition, std::back_inserter(res), std::back_inserter(hyps),
-									  unusable_tasks.begin(), unusable_tasks.end());
+		void
+		compute_task_tree::handle_infer_constraint(cond_logic_evaluation& cond,
+												   boost::shared_ptr<infer_result> r,
+												   compute_task_tree::cb_type handler)
+		{
+			CHECK_INTERRUPT
 
-			if (res.empty() && hyps.empty())
+			if (r->res.empty() && r->hyps.empty())
 				return handler(false);
 
-			if (!res.empty()) {
+			if (!r->res.empty()) {
 				cond.tasks.clear();
-				std::transform(res.begin(), res.end(), std::back_inserter(cond.tasks),
+				std::transform(r->res.begin(), r->res.end(), std::back_inserter(cond.tasks),
 						generate_task_eval(cond));
 
 				std::for_each(cond.tasks.begin(), cond.tasks.end(),
 						async_eval_all_preconditions(*this, handler, cond));
 			} else {
 				hyp_eval.clear();
-				std::copy(hyps.begin(), hyps.end(), std::back_inserter(hyp_eval));
+				std::copy(r->hyps.begin(), r->hyps.end(), std::back_inserter(hyp_eval));
 
 				async_evaluate_hypothesis(0, 0, cond, handler);
 			}
 		}
 
 		void 
-		compute_task_tree::handle_eval_constraint(task_logic_evaluation& task, 
+		compute_task_tree::handle_eval_constraint(boost::shared_ptr<task_logic_evaluation> task, 
 				size_t i, bool res, compute_task_tree::cb_type handler)
 		{
 			CHECK_INTERRUPT
 
 			if (!res) {
 				layer.a_.logger(DEBUG) << ctx.ctr << " failed to solve ";
-				layer.a_.logger(DEBUG) << task.conds[i].condition << std::endl;
+				layer.a_.logger(DEBUG) << task->conds[i].condition << std::endl;
 				handler(false);
 			} else {
 				layer.a_.logger(DEBUG) << ctx.ctr << " Has solved ";
-				layer.a_.logger(DEBUG) << task.conds[i].condition << std::endl;
+				layer.a_.logger(DEBUG) << task->conds[i].condition << std::endl;
+
+				if (layer.streaming_planner)
+					stream_execute_cond(task, i);
 
-				if (i+1 == task.conds.size()) {
+				if (i+1 == task->conds.size()) {
 
 					layer.a_.logger(DEBUG) << ctx.ctr << " Deal with all preconds of ";
-					layer.a_.logger(DEBUG) << task.name  << std::endl;
+					layer.a_.logger(DEBUG) << task->name  << std::endl;
 
 					handler(true);
 				} else {
-					async_eval_constraint(task.conds[i+1], 
+					async_eval_constraint(task->conds[i+1], 
 							boost::bind(&compute_task_tree::handle_eval_constraint, 
-								this, boost::ref(task), i+1, _1, handler));
+								this, task, i+1, _1, handler));
 				}
 			}
 		}
 
 		void
-		compute_task_tree::start_eval_constraint(task_logic_evaluation& task, 
+		compute_task_tree::start_eval_constraint(boost::shared_ptr<task_logic_evaluation> task, 
 												 compute_task_tree::cb_type handler)
 		{
 			CHECK_INTERRUPT
 
-			if (task.conds.empty())
+			if (task->conds.empty())
 				handler(true);
 			else {
-				async_eval_constraint(task.conds[0], 
+				async_eval_constraint(task->conds[0], 
 						boost::bind(&compute_task_tree::handle_eval_constraint, 
-							this, boost::ref(task), 0,  _1, handler));
+							this, task, 0,  _1, handler));
+			}
+		}
+
+		void
+		compute_task_tree::stream_execute_cond(boost::shared_ptr<task_logic_evaluation> task,
+											   size_t i)
+		{
+			layer.a_.logger(DEBUG) << ctx.ctr << " Start execution of the subtree of ";
+			layer.a_.logger(DEBUG) << task->conds[i].condition << std::endl;
+
+			nb_streamed++;
+			task->conds[i].exec_started = true;
+			execute_cond(task->conds[i], 
+					boost::bind(&compute_task_tree::handle_stream_execute_cond,
+								this, task, i, _1), false);
+		}
+
+		void
+		compute_task_tree::handle_stream_execute_cond(boost::shared_ptr<task_logic_evaluation> task,
+													  size_t i, bool res)
+		{
+			cond_logic_evaluation& cond = task->conds[i];
+
+			/* on interruption, the handler may be called several times */
+			if (cond.exec_res)
+				return;
+
+			cond.exec_res = res;
+			nb_streamed--;
+
+			std::vector<cb_type> waiting;
+			std::swap(waiting, cond.exec_waiting);
+			for (size_t j = 0; j < waiting.size(); ++j)
+				waiting[j](res);
+
+			if (nb_streamed == 0) {
+				std::vector<resume_fun> handlers;
+				std::swap(handlers, streams_waiting);
+				for (size_t j = 0; j < handlers.size(); ++j)
+					handlers[j]();
+			}
+		}
+
+		void
+		compute_task_tree::end_streams(compute_task_tree::cb_type handler, 
+									   bool wait_success, bool res)
+		{
+			if (nb_streamed == 0 || (res && !wait_success))
+				return handler(res);
+
+			streams_waiting.push_back(boost::bind(handler, res));
+		}
+
+		void
+		compute_task_tree::cancel_streams(task_logic_evaluation& task)
+		{
+			std::vector<boost::shared_ptr<task_logic_evaluation> > tasks;
+			for (size_t i = 0; i < task.conds.size(); ++i)
+				collect_tasks(task.conds[i], tasks);
+
+			for (size_t i = 0; i < tasks.size(); ++i) {
+				tasks[i]->rejected = true;
+				if (running_tasks.find(tasks[i]->name) == running_tasks.end())
+					continue;
+
+				layer.a_.logger(DEBUG) << ctx.ctr << " Abort " << tasks[i]->name;
+				layer.a_.logger(DEBUG) << " as " << task.name << " is rejected" << std::endl;
+				layer.tasks[tasks[i]->name]->abort();
 			}
 		}
 
@@ -355,6 +517,8 @@ namespace hyper {
 		{
 			must_interrupt = false;
 			running_tasks.clear();
+			if (layer.streaming_planner)
+				handler = boost::bind(&compute_task_tree::end_streams, this, handler, false, _1);
 			cond_root = cond_logic_evaluation(logic::function_call());
 			cond_root.tasks.push_back(generate_task_eval(cond_root)(s));
 			async_eval_all_preconditions(*this, handler, cond_root)(cond_root.tasks[0]);
@@ -366,10 +530,120 @@ namespace hyper {
 		{
 			must_interrupt = false;
 			running_tasks.clear();
+			if (layer.streaming_planner)
+				handler = boost::bind(&compute_task_tree::end_streams, this, handler, false, _1);
 			cond_root = cond_logic_evaluation(f);
 			async_eval_constraint(cond_root, handler);
 		}
 
+		void
+		compute_task_tree::async_eval_plan(const cond_logic_evaluation& plan,
+										   compute_task_tree::cb_type handler)
+		{
+			must_interrupt = false;
+			running_tasks.clear();
+			cond_root = clone_cond(plan);
+			expected_fingerprint = plan_fingerprint(plan);
+
+			plan_tasks.clear();
+			collect_tasks(cond_root, plan_tasks);
+			for (size_t i = 0; i < plan_tasks.size(); ++i)
+				if (std::find(failed_tasks.begin(), failed_tasks.end(), 
+							  plan_tasks[i]->name) != failed_tasks.end())
+					return handler(false);
+
+			if (plan_tasks.empty())
+				return handler(false);
+
+			layer.a_.logger(DEBUG) << ctx.ctr << " Try the cached task tree" << std::endl;
+
+			plan_fingerprints.resize(plan_tasks.size());
+			pending_plan_tasks = plan_tasks.size();
+			plan_error = false;
+			for (size_t i = 0; i < plan_tasks.size(); ++i)
+				async_evaluate_preconditions(*plan_tasks[i],
+						boost::bind(&compute_task_tree::handle_eval_plan, this,
+									i, _1, _2, handler));
+		}
+
+		void
+		compute_task_tree::handle_eval_plan(size_t i, const boost::system::error_code& e,
+											conditionV failed, 
+											compute_task_tree::cb_type handler)
+		{
+			if (e)
+				plan_error = true;
+			else
+				plan_fingerprints[i] = task_fingerprint(plan_tasks[i]->name, failed);
+
+			if (--pending_plan_tasks != 0)
+				return;
+
+			CHECK_INTERRUPT
+
+			if (plan_error)
+				return handler(false);
+
+			size_t seed = 0;
+			for (size_t j = 0; j < plan_fingerprints.size(); ++j)
+				boost::hash_combine(seed, plan_fingerprints[j]);
+
+			if (seed != expected_fingerprint) {
+				layer.a_.logger(DEBUG) << ctx.ctr << " The cached task tree is outdated" << std::endl;
+				return handler(false);
+			}
+
+			async_eval_plan_hypothesis(0, 0, handler);
+		}
+
+		/*
+		 * The hypothesis which lead to the choice of plan_tasks[i] are
+		 * not part of the fingerprint. Evaluate them again, one by one,
+		 * until one of them holds for each task.
+		 */
+		void
+		compute_task_tree::async_eval_plan_hypothesis(size_t i, size_t j,
+													  compute_task_tree::cb_type handler)
+		{
+			CHECK_INTERRUPT
+
+			while (i < plan_tasks.size() && plan_tasks[i]->hyps.empty())
+				++i;
+
+			if (i == plan_tasks.size()) {
+				layer.a_.logger(DEBUG) << ctx.ctr << " The cached task tree is valid" << std::endl;
+				return handler(true);
+			}
+
+			if (j == plan_tasks[i]->hyps.size()) {
+				layer.a_.logger(DEBUG) << ctx.ctr << " The cached task tree is outdated : ";
+				layer.a_.logger(DEBUG) << "no more hypothesis for " << plan_tasks[i]->name << std::endl;
+				return handler(false);
+			}
+
+			plan_hyp_res = boost::none;
+			plan_hyp_err.clear();
+			async_eval_expression(layer.a_.io_s, plan_tasks[i]->hyps[j],
+								  layer.a_, plan_hyp_res, plan_hyp_err,
+								  boost::bind(&compute_task_tree::handle_eval_plan_hypothesis,
+											  this, i, j, handler));
+		}
+
+		void
+		compute_task_tree::handle_eval_plan_hypothesis(size_t i, size_t j,
+													   compute_task_tree::cb_type handler)
+		{
+			if (plan_hyp_res && *plan_hyp_res)
+				async_eval_plan_hypothesis(i + 1, 0, handler);
+			else
+				async_eval_plan_hypothesis(i, j + 1, handler);
+		}
+
+		cond_logic_evaluation compute_task_tree::plan() const
+		{
+			return clone_cond(cond_root);
+		}
+
 		void compute_task_tree::handle_execute_cond(task_logic_evaluation& task,
 													compute_task_tree::cb_type handler,
 													bool inform)
@@ -377,7 +651,7 @@ namespace hyper {
 			CHECK_INTERRUPT
 
 			if (task.all_conds_executed()) {
-				if (task.all_conds_succesfully_executed()) {
+				if (task.all_conds_succesfully_executed() && !task.rejected) {
 					running_tasks.insert(task.name);
 					if (must_pause)
 						layer.tasks[task.name]->pause();
@@ -407,7 +681,7 @@ namespace hyper {
 			running_tasks.erase(task.name);
 			task.res_exec = res;
 
-			if (!res) 
+			if (!res && !task.rejected) 
 				failed_tasks.push_back(task.name);
 			
 			if (cond.all_tasks_executed()) {
@@ -488,6 +762,22 @@ namespace hyper {
 		{
 			CHECK_INTERRUPT
 
+			if (cond.exec_started) {
+				if (cond.exec_res)
+					return handler(*cond.exec_res);
+				return cond.exec_waiting.push_back(handler);
+			}
+
+			execute_cond(cond, handler, inform);
+		}
+
+		void
+		compute_task_tree::execute_cond(cond_logic_evaluation& cond,
+										compute_task_tree::cb_type handler,
+										bool inform)
+		{
+			CHECK_INTERRUPT
+
 			if (cond.all_tasks_executed()) {
 				handler(cond.is_succesfully_executed());
 			} else {
@@ -499,13 +789,17 @@ namespace hyper {
 		void
 		compute_task_tree::async_execute(compute_task_tree::cb_type handler)
 		{
-			running_tasks.clear();
+			/* the streamed executions are still running, keep track of them */
+			if (!layer.streaming_planner)
+				running_tasks.clear();
 
 			if (must_pause) {
 				resume_handler = boost::bind(&compute_task_tree::async_execute, 
 										 this, handler);
 			} else {
 				must_interrupt = false;
+				if (layer.streaming_planner)
+					handler = boost::bind(&compute_task_tree::end_streams, this, handler, true, _1);
 				bool inform = (cond_root.condition != logic::function_call());
 				async_execute_cond(cond_root, handler, inform);
 			}
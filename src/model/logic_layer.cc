@@ -1,3 +1,6 @@
+#include <cstdlib>
+#include <fstream>
+
 #include <logic/expression.hh>
 #include <logic/eval.hh>
 
@@ -56,6 +59,29 @@ namespace {
 		}
 	};
 
+	/* 
+	 * A job of logic_layer::async_logic. It keeps io_s running until its
+	 * handler has been posted.
+	 */
+	struct logic_job {
+		boost::function<void ()> job;
+		boost::function<void ()> handler;
+		boost::asio::io_service& io_s;
+		boost::shared_ptr<boost::asio::io_service::work> work;
+
+		logic_job(boost::function<void ()> job, boost::function<void ()> handler,
+				  boost::asio::io_service& io_s) :
+			job(job), handler(handler), io_s(io_s), 
+			work(new boost::asio::io_service::work(io_s))
+		{}
+
+		void operator() ()
+		{
+			job();
+			io_s.post(handler);
+		}
+	};
+
 	template <typename T>
 	void prepare_unification(const std::string& name, const T& unify, model::logic_ctx_ptr ctx) {
 		ctx->unify_list.clear();
@@ -105,8 +131,30 @@ namespace hyper {
 
 		logic_layer::logic_layer(ability &a) :
 			engine(),
+			logic_strand(a.workers_s),
+			infer_timeout(boost::posix_time::not_a_date_time),
+			infer_max_nodes(0),
+			streaming_planner(std::getenv("HYPER_STREAMING_PLANNER") != 0),
+			use_plan_cache(std::getenv("HYPER_PLAN_CACHE") != 0),
 			a_(a)
 		{
+			/* the rules of the ability are applied once it is declared, see start */
+			engine.begin_declarations();
+
+			const char* trace_dir = std::getenv("HYPER_LOGIC_TRACE");
+			if (trace_dir) {
+				std::string file = std::string(trace_dir) + "/" + a_.name + ".trace";
+				trace.reset(new std::ofstream(file.c_str()));
+				engine.set_trace(trace.get());
+			}
+
+			const char* timeout = std::getenv("HYPER_LOGIC_INFER_TIMEOUT");
+			if (timeout)
+				infer_timeout = boost::posix_time::milliseconds(std::atol(timeout));
+			const char* max_nodes = std::getenv("HYPER_LOGIC_INFER_MAX_NODES");
+			if (max_nodes)
+				infer_max_nodes = std::strtoul(max_nodes, 0, 10);
+
 			/* Add exec func */
 			add_equalable_type<int>("int");
 			add_equalable_type<double>("double");
@@ -218,10 +266,35 @@ namespace hyper {
 			else 
 				if (ctx->ctr.internal)
 					handle_failure(ctx, make_error_code(logic_layer_error::recipe_execution_error));
-				else
+				else {
+					plan_cache.erase(ctx->call_exec);
 					ctx->logic_tree.async_eval_cond(ctx->call_exec,
-							boost::bind(&logic_layer::handle_eval_task_tree, this,
+							boost::bind(&logic_layer::handle_eval_cond_tree, this,
 									   _1, ctx));
+				}
+		}
+
+		void logic_layer::handle_eval_cond_tree(bool success, logic_ctx_ptr ctx)
+		{
+			CHECK_INTERRUPT
+
+			if (success && use_plan_cache)
+				plan_cache[ctx->call_exec] = ctx->logic_tree.plan();
+
+			handle_eval_task_tree(success, ctx);
+		}
+
+		void logic_layer::handle_eval_cached_tree(bool success, logic_ctx_ptr ctx)
+		{
+			CHECK_INTERRUPT
+
+			if (success)
+				return handle_eval_task_tree(success, ctx);
+
+			plan_cache.erase(ctx->call_exec);
+			ctx->logic_tree.async_eval_cond(ctx->call_exec,
+					boost::bind(&logic_layer::handle_eval_cond_tree, this,
+							   _1, ctx));
 		}
 
 		void logic_layer::handle_eval_task_tree(bool success, logic_ctx_ptr ctx) 
@@ -285,8 +358,15 @@ namespace hyper {
 
 			ctx->s_ = logic_context::LOGIC_EXEC;
 
+			std::map<logic::function_call, cond_logic_evaluation>::const_iterator it;
+			it = plan_cache.find(ctx->call_exec);
+			if (it != plan_cache.end())
+				return ctx->logic_tree.async_eval_plan(it->second, 
+						boost::bind(&logic_layer::handle_eval_cached_tree, this,
+								   _1, ctx));
+
 			ctx->logic_tree.async_eval_cond(ctx->call_exec,
-					boost::bind(&logic_layer::handle_eval_task_tree, this,
+					boost::bind(&logic_layer::handle_eval_cond_tree, this,
 							   _1, ctx));
 		}
 
@@ -434,6 +514,29 @@ namespace hyper {
 			return ret.e;
 		}
 
+		logic::infer_budget logic_layer::infer_budget() const
+		{
+			if (infer_timeout.is_special())
+				return logic::infer_budget(boost::posix_time::ptime(), infer_max_nodes);
+			return logic::infer_budget::within(infer_timeout, infer_max_nodes);
+		}
+
+		void logic_layer::end_declarations()
+		{
+			engine.end_declarations();
+		}
+
+		void logic_layer::async_logic(boost::function<void ()> job, 
+									  boost::function<void ()> handler)
+		{
+			if (a_.nb_workers == 0) {
+				job();
+				return handler();
+			}
+
+			logic_strand.post(logic_job(job, handler, a_.io_s));
+		}
+
 		logic_layer::~logic_layer() 
 		{
 		}
@@ -187,7 +187,54 @@ namespace hyper {
 
 			a.logger(DEBUG) << *this << "Finish to evaluate recipe preconditions" << std::endl;
 
+			select_recipe();
+		}
+
+		void task::async_evaluate_all_recipe_preconditions()
+		{
+			/* 
+			 * Listed first, as the last callback may be called, and sort
+			 * recipe_states, before the loop ends
+			 */
+			std::vector<size_t> electables;
+			for (size_t i = 0; i < recipes.size(); ++i)
+				if (recipe_states[i].is_electable())
+					electables.push_back(i);
+
+			recipe_error = false;
+			pending_recipes = electables.size();
+			for (size_t j = 0; j < electables.size(); ++j) {
+				size_t i = electables[j];
+				a.logger(DEBUG) << *this << "Starting to evaluate preconditions for recipe ";
+				a.logger(DEBUG) << recipes[i]->r_name() << std::endl;
+				recipes[i]->async_evaluate_preconditions(
+						boost::bind(&task::handle_recipe_preconditions, this, _1, _2, i));
+			}
+		}
+
+		void task::handle_recipe_preconditions(const boost::system::error_code& e, conditionV failed, size_t i)
+		{
+			if (e)
+				recipe_error = true;
+			else
+				recipe_states[i].failed = failed;
+
+			// wait for all the recipes before ending, whatever happens
+			if (--pending_recipes != 0)
+				return;
 
+			CHECK_INTERRUPT
+
+			if (recipe_error)
+				return end_execute(false);
+
+			a.logger(DEBUG) << *this << "Finish to evaluate recipe preconditions" << std::endl;
+
+			select_recipe();
+		}
+
+		void task::select_recipe()
+		{
 			// time to select a recipe and execute it :)
 			std::sort(recipe_states.begin(), recipe_states.end());
 			if (! recipe_states[0].failed.empty() ||
@@ -321,6 +368,9 @@ namespace hyper {
 				return end_execute(false);
 			}
 
+			if (a.parallel_preconditions)
+				return async_evaluate_all_recipe_preconditions();
+
 			a.logger(DEBUG) << *this << "Starting to evaluate preconditions for recipe ";
 			a.logger(DEBUG) << recipes[*first_electable]->r_name() << std::endl;
 			/* compute precondition for all recipe */
@@ -0,0 +1,78 @@
+/*
+ * Output on stdout the native matchers of a few rules, as generated by
+ * hyperc --native-rules, so that test_logic_native_rule compiles them and
+ * compares them with the interpreted unification.
+ */
+#include <compiler/native_rule_output.hh>
+#include <compiler/rules_def_parser.hh>
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace hyper::compiler;
+
+namespace {
+	expression_ast call(const std::string& name, const expression_ast& a1)
+	{
+		function_call f;
+		f.fName = name;
+		f.args.push_back(a1);
+		return f;
+	}
+
+	expression_ast call(const std::string& name, const expression_ast& a1,
+						const expression_ast& a2)
+	{
+		function_call f;
+		f.fName = name;
+		f.args.push_back(a1);
+		f.args.push_back(a2);
+		return f;
+	}
+
+	void dump(const rule_decl& r)
+	{
+		if (!has_native_matcher(r)) {
+			std::cerr << "No native matcher for " << r.name << std::endl;
+			std::exit(-1);
+		}
+		dump_native_matcher(std::cout, r, r.name + "_matcher");
+	}
+}
+
+int main()
+{
+	std::string A("A"), B("B"), C("C");
+
+	std::cout << "#include <logic/native_rule.hh>\n\n";
+	std::cout << "namespace hyper {\n\tnamespace native_test {\n";
+
+	rule_decl path_base;
+	path_base.name = "path_base";
+	path_base.premises.push_back(call("edge", A, B));
+	path_base.conclusions.push_back(call("path", A, B));
+	dump(path_base);
+
+	rule_decl path_step;
+	path_step.name = "path_step";
+	path_step.premises.push_back(call("path", A, B));
+	path_step.premises.push_back(call("edge", B, C));
+	path_step.conclusions.push_back(call("path", A, C));
+	dump(path_step);
+
+	rule_decl loop;
+	loop.name = "loop";
+	loop.premises.push_back(call("path", A, A));
+	loop.conclusions.push_back(call("loop", A));
+	dump(loop);
+
+	rule_decl before_3;
+	before_3.name = "before_3";
+	before_3.premises.push_back(call("edge", A, B));
+	before_3.premises.push_back(call("edge", B, Constant<int>(3)));
+	before_3.conclusions.push_back(call("before_3", A));
+	dump(before_3);
+
+	std::cout << "\t}\n}\n";
+	return 0;
+}
@@ -1,4 +1,6 @@
 #include <compiler/output.hh>
+#include <compiler/native_rule_output.hh>
+#include <compiler/rules_def_parser.hh>
 #include <boost/test/unit_test.hpp>
 #include <boost/assign/std/vector.hpp> 
 
@@ -26,3 +28,44 @@ BOOST_AUTO_TEST_CASE ( compiler_output )
 	hyper::compiler::list_of(v1.begin(), v1.end(), dump(oss));
 	BOOST_CHECK(oss.str() == "1, 2, 3, 4, 5");
 }
+
+namespace {
+	hyper::compiler::expression_ast 
+	premise(const std::string& name, const hyper::compiler::expression_ast& a1,
+			const hyper::compiler::expression_ast& a2)
+	{
+		hyper::compiler::function_call f;
+		f.fName = name;
+		f.args.push_back(a1);
+		f.args.push_back(a2);
+		return f;
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( compiler_native_rule_output )
+{
+	using namespace hyper::compiler;
+
+	rule_decl r;
+	r.name = "less_than_3";
+	BOOST_CHECK(!has_native_matcher(r));
+
+	r.premises.push_back(premise("less_int", std::string("A"), std::string("B")));
+	r.premises.push_back(premise("less_int", std::string("B"), Constant<int>(3)));
+	r.conclusions.push_back(premise("less_int", std::string("A"), Constant<int>(3)));
+	BOOST_CHECK(has_native_matcher(r));
+
+	std::ostringstream oss;
+	dump_native_matcher(oss, r, "matcher");
+	std::string s = oss.str();
+	BOOST_CHECK(s.find("void matcher(") != std::string::npos);
+	BOOST_CHECK(s.find("case 1:") != std::string::npos);
+	BOOST_CHECK(s.find("is_constant<int>(f1->args[1], 3)") != std::string::npos);
+	BOOST_CHECK(s.find("same(f1->args[0], v1)") != std::string::npos);
+
+	// nested function calls are left to the interpreter
+	rule_decl nested(r);
+	nested.premises.push_back(premise("less_double", premise("distance", std::string("A"), std::string("B")), 
+									  Constant<double>(2.0)));
+	BOOST_CHECK(!has_native_matcher(nested));
+}
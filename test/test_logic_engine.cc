@@ -1,8 +1,10 @@
 #include <logic/engine.hh>
 #include <logic/eval.hh>
+#include <logic/native_rule.hh>
 #include <boost/test/unit_test.hpp>
 #include <boost/assign/list_of.hpp>
 #include <boost/variant/apply_visitor.hpp>
+#include <sstream>
 
 using namespace boost::logic;
 using namespace hyper::logic;
@@ -173,9 +175,12 @@ BOOST_AUTO_TEST_CASE ( logic_engine_test )
 	std::vector<function_call> hyps;
 	r = e.infer("less_double(distance(center, object), treshold)", hyps, std::string("task3"));
 	BOOST_CHECK(boost::logic::indeterminate(r));
-	BOOST_CHECK(hyps.size() == 1);
+	// by transitivity, or by congruence with the known fact
+	BOOST_CHECK(hyps.size() == 2);
 	generate_return r1 = generate("less_double(3.0, treshold)", e.funcs());
-	BOOST_CHECK(hyps[0] == r1.e);
+	BOOST_CHECK(std::find(hyps.begin(), hyps.end(), r1.e) != hyps.end());
+	r1 = generate("equal_double(3.0, treshold)", e.funcs());
+	BOOST_CHECK(std::find(hyps.begin(), hyps.end(), r1.e) != hyps.end());
 
 	BOOST_CHECK(e.add_fact("equal_int(x, 4)", "task3"));
 	r = e.infer("equal_int(4, y)", hyps, std::string("task3"));
@@ -185,3 +190,772 @@ BOOST_AUTO_TEST_CASE ( logic_engine_test )
 	BOOST_CHECK(std::find(hyps.begin(), hyps.end(), r1.e) != hyps.end());
 }
 
+
+namespace {
+	void fill_engine(engine& e)
+	{
+		e.add_type("int");
+		e.add_type("double");
+		e.add_type("point");
+
+		e.add_predicate("less_int", 2, boost::assign::list_of("int")("int"), new eval<less, 2>());
+		e.add_predicate("less_double", 2, boost::assign::list_of("double")("double"), new eval<less, 2>());
+		e.add_func("distance", 2, boost::assign::list_of("point")("point")("double"));
+
+		e.add_rule<std::string>("less_int_transitiviy", 
+						   boost::assign::list_of<std::string>("less_int(X, Y)")("less_int(Y,Z)"),
+						   boost::assign::list_of<std::string>("less_int(X, Z)"));
+		e.add_rule<std::string>("less_double_transitiviy", 
+						   boost::assign::list_of<std::string>("less_double(X, Y)")("less_double(Y,Z)"),
+						   boost::assign::list_of<std::string>("less_double(X, Z)"));
+		e.add_rule<std::string>("distance_symmetry",
+						   boost::assign::list_of<std::string>("distance(A,B)"),
+						   boost::assign::list_of<std::string>("equal_double(distance(A,B), distance(B,A))"));
+		e.add_rule<std::string>("less_int_false",
+						   boost::assign::list_of<std::string>("less_int(A, A)"),
+						   std::vector<std::string>());
+
+		e.add_fact("less_int(a, b)");
+		e.add_fact("less_int(b, c)");
+		e.add_fact("equal_int(c, d)");
+		e.add_fact("less_int(d, e)");
+		e.add_fact("less_int(e, f)");
+		e.add_fact("less_double(distance(center, object), 3.0)");
+		e.add_fact("less_double(distance(center, balloon), distance(center, object))");
+		e.add_fact("equal_point(object, other)");
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_semi_naive_test )
+{
+	engine naive, semi_naive;
+	naive.set_chaining_strategy(naive_chaining);
+	semi_naive.set_chaining_strategy(semi_naive_chaining);
+
+	fill_engine(naive);
+	fill_engine(semi_naive);
+
+	std::vector<std::string> goals = boost::assign::list_of<std::string>
+		("less_int(a, f)")("less_int(b, d)")("less_int(a, c)")("less_int(f, a)")
+		("less_double(distance(center, balloon), 3.0)")
+		("less_double(distance(other, center), 3.0)")
+		("less_double(distance(balloon, center), 3.0)");
+
+	for (size_t i = 0; i < goals.size(); ++i) {
+		tribool r1 = naive.infer(goals[i]);
+		tribool r2 = semi_naive.infer(goals[i]);
+		BOOST_CHECK(boost::logic::indeterminate(r1) == boost::logic::indeterminate(r2));
+		if (!boost::logic::indeterminate(r1))
+			BOOST_CHECK(bool(r1) == bool(r2));
+	}
+
+	BOOST_CHECK(semi_naive.infer("less_int(a, f)"));
+	BOOST_CHECK(semi_naive.infer("less_double(distance(center, balloon), 3.0)"));
+
+	// both reach the same closure
+	BOOST_CHECK(naive.known_facts() == semi_naive.known_facts());
+	BOOST_CHECK(!semi_naive.known_facts().empty());
+
+	// a new rule is applied on the facts already known
+	BOOST_CHECK(naive.add_rule<std::string>("less_int_antisymetry",
+						   boost::assign::list_of<std::string>("less_int(A, B)")("less_int(B,A)"),
+						   std::vector<std::string>()));
+	BOOST_CHECK(semi_naive.add_rule<std::string>("less_int_antisymetry",
+						   boost::assign::list_of<std::string>("less_int(A, B)")("less_int(B,A)"),
+						   std::vector<std::string>()));
+	BOOST_CHECK(!naive.add_fact("less_int(f, a)"));
+	BOOST_CHECK(!semi_naive.add_fact("less_int(f, a)"));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_rete_test )
+{
+	engine semi_naive, rete;
+	semi_naive.set_chaining_strategy(semi_naive_chaining);
+	rete.set_chaining_strategy(rete_chaining);
+
+	fill_engine(semi_naive);
+	fill_engine(rete);
+
+	std::vector<std::string> goals = boost::assign::list_of<std::string>
+		("less_int(a, f)")("less_int(b, d)")("less_int(a, c)")("less_int(f, a)")
+		("less_int(f, g)")("less_int(a, g)")
+		("less_double(distance(center, balloon), 3.0)")
+		("less_double(distance(other, center), 3.0)")
+		("less_double(distance(balloon, center), 3.0)");
+
+	for (size_t i = 0; i < goals.size(); ++i) {
+		tribool r1 = semi_naive.infer(goals[i]);
+		tribool r2 = rete.infer(goals[i]);
+		BOOST_CHECK(boost::logic::indeterminate(r1) == boost::logic::indeterminate(r2));
+		if (!boost::logic::indeterminate(r1))
+			BOOST_CHECK(bool(r1) == bool(r2));
+	}
+
+	BOOST_CHECK(rete.infer("less_int(a, f)"));
+
+	// a new rule is applied on the facts already known
+	BOOST_CHECK(rete.add_rule<std::string>("less_int_antisymetry",
+						   boost::assign::list_of<std::string>("less_int(A, B)")("less_int(B,A)"),
+						   std::vector<std::string>()));
+	BOOST_CHECK(!rete.add_fact("less_int(f, a)"));
+
+	// the partial matches of the rejected fact have been forgotten
+	BOOST_CHECK(boost::logic::indeterminate(rete.infer("less_int(f, a)")));
+	BOOST_CHECK(rete.add_fact("less_int(f, g)"));
+	BOOST_CHECK(rete.infer("less_int(a, g)"));
+	BOOST_CHECK(boost::logic::indeterminate(rete.infer("less_int(g, a)")));
+}
+
+namespace {
+	void check_retract(engine& e)
+	{
+		e.add_type("object");
+		e.add_predicate("before", 2, boost::assign::list_of("object")("object"));
+		e.add_rule<std::string>("before_transitivity",
+						   boost::assign::list_of<std::string>("before(X, Y)")("before(Y, Z)"),
+						   boost::assign::list_of<std::string>("before(X, Z)"));
+		e.add_rule<std::string>("before_antisymetry",
+						   boost::assign::list_of<std::string>("before(A, B)")("before(B, A)"),
+						   std::vector<std::string>());
+
+		BOOST_CHECK(e.add_fact("before(a, b)"));
+		BOOST_CHECK(e.add_fact("before(b, c)"));
+		BOOST_CHECK(e.add_fact("before(c, d)"));
+		BOOST_CHECK(e.add_fact("before(a, x)"));
+		BOOST_CHECK(e.add_fact("before(x, c)"));
+
+		BOOST_CHECK(!e.retract_fact("before(d, a)"));
+
+		// before(a, c) and before(a, d) are still derived through x
+		BOOST_CHECK(e.retract_fact("before(b, c)"));
+		BOOST_CHECK(e.infer("before(a, c)"));
+		BOOST_CHECK(e.infer("before(a, d)"));
+		BOOST_CHECK(boost::logic::indeterminate(e.infer("before(b, c)")));
+		BOOST_CHECK(boost::logic::indeterminate(e.infer("before(b, d)")));
+		BOOST_CHECK(!e.add_fact("before(d, a)"));
+
+		BOOST_CHECK(e.retract_fact("before(x, c)"));
+		BOOST_CHECK(boost::logic::indeterminate(e.infer("before(a, c)")));
+		BOOST_CHECK(e.add_fact("before(d, a)"));
+		BOOST_CHECK(e.infer("before(c, b)"));
+
+		// a unification can't be undone, the context is rebuilt
+		BOOST_CHECK(e.add_fact("equal_object(y, b)"));
+		BOOST_CHECK(e.infer("before(a, y)"));
+		BOOST_CHECK(e.retract_fact("equal_object(y, b)"));
+		BOOST_CHECK(boost::logic::indeterminate(e.infer("before(a, y)")));
+		BOOST_CHECK(e.infer("before(c, b)"));
+		BOOST_CHECK(e.infer("before(d, x)"));
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_retract_test )
+{
+	engine naive, semi_naive, rete, rebuild;
+	naive.set_chaining_strategy(naive_chaining);
+	rete.set_chaining_strategy(rete_chaining);
+	naive.set_truth_maintenance(true);
+	semi_naive.set_truth_maintenance(true);
+	rete.set_truth_maintenance(true);
+
+	check_retract(naive);
+	check_retract(semi_naive);
+	check_retract(rete);
+	check_retract(rebuild);
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_base_layer_test )
+{
+	engine e;
+	e.add_type("object");
+	e.add_predicate("before", 2, boost::assign::list_of("object")("object"));
+	e.add_rule<std::string>("before_transitivity",
+					   boost::assign::list_of<std::string>("before(X, Y)")("before(Y, Z)"),
+					   boost::assign::list_of<std::string>("before(X, Z)"));
+
+	BOOST_CHECK(e.add_base_fact("before(a, b)"));
+	BOOST_CHECK(e.add_base_fact("before(b, c)"));
+	BOOST_CHECK(e.add_fact("before(c, d)", "task1"));
+	BOOST_CHECK(e.add_fact("before(x, a)", "task2"));
+
+	BOOST_CHECK(e.infer("before(a, c)", "task1"));
+	BOOST_CHECK(e.infer("before(a, d)", "task1"));
+	BOOST_CHECK(e.infer("before(x, c)", "task2"));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("before(a, d)", "task2")));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("before(x, c)", "task1")));
+
+	// a base fact added later reaches the existing contexts
+	BOOST_CHECK(e.add_base_fact("before(c, e)"));
+	BOOST_CHECK(e.infer("before(a, e)", "task1"));
+	BOOST_CHECK(e.infer("before(x, e)", "task2"));
+
+	// a new context starts from the base layer
+	BOOST_CHECK(e.infer("before(b, e)", "task3"));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("before(x, e)", "task3")));
+
+	// new rules are checked against the base layer too
+	BOOST_CHECK(e.add_rule<std::string>("before_antisymetry",
+					   boost::assign::list_of<std::string>("before(A, B)")("before(B, A)"),
+					   std::vector<std::string>()));
+	BOOST_CHECK(!e.add_base_fact("before(c, a)"));
+	BOOST_CHECK(!e.add_fact("before(d, a)", "task1"));
+	BOOST_CHECK(e.add_fact("before(d, a)", "task2"));
+}
+
+namespace {
+	/* 
+	 * The expressions are stored with logic variables in place of the
+	 * symbols, and their names depend on the facts_ctx, so only compare
+	 * the number of candidates of each symbol.
+	 */
+	bool same_possible_expression(const facts_ctx& c1, const facts_ctx& c2, const rules& rs)
+	{
+		rules::const_iterator it;
+		for (it = rs.begin(); it != rs.end(); ++it) {
+			const facts_ctx::expressionM& m1 = c1.possible_expression(it->identifier);
+			const facts_ctx::expressionM& m2 = c2.possible_expression(it->identifier);
+			if (m1.size() != m2.size())
+				return false;
+			facts_ctx::expressionM::const_iterator it1, it2;
+			for (it1 = m1.begin(), it2 = m2.begin(); it1 != m1.end(); ++it1, ++it2)
+				if (it1->first != it2->first || it1->second->size() != it2->second->size())
+					return false;
+		}
+		return true;
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_possible_expression_test )
+{
+	funcDefList funcs;
+	funcs.add("less", 2);
+	funcs.add("same", 2);
+	funcs.add("distance", 2);
+
+	rules rs(funcs);
+	std::vector<std::string> cond = 
+		boost::assign::list_of<std::string>("less(X, Y)")("same(Y, Z)");
+	rs.add("less_same", cond, std::vector<std::string>(1, "less(X, Z)"));
+
+	std::vector<std::string> all_facts = boost::assign::list_of<std::string>
+		("less(a, b)")("same(c, d)")("same(b, e)")("less(distance(a, b), c)")
+		("same(distance(a, b), f)")("less(f, a)");
+
+	// the possible expressions are updated after each new fact
+	facts_ctx incremental(funcs);
+	incremental.compute_possible_expression(rs);
+	for (size_t i = 0; i < all_facts.size(); ++i) {
+		BOOST_CHECK(incremental.add(all_facts[i]));
+		incremental.compute_possible_expression(rs);
+	}
+
+	facts_ctx full(funcs);
+	for (size_t i = 0; i < all_facts.size(); ++i)
+		BOOST_CHECK(full.add(all_facts[i]));
+	full.compute_possible_expression(rs);
+
+	BOOST_CHECK(same_possible_expression(incremental, full, rs));
+	BOOST_CHECK(incremental.possible_expression("less_same").find("Y")->second->size() == 4);
+
+	// a copy keeps its own version of the possible expressions
+	facts_ctx copy(incremental);
+	BOOST_CHECK(copy.add("same(a, g)"));
+	copy.compute_possible_expression(rs);
+	BOOST_CHECK(same_possible_expression(incremental, full, rs));
+	BOOST_CHECK(copy.possible_expression("less_same").find("Y")->second->size() == 5);
+
+	// the sub-expressions of a rolled back fact are forgotten
+	incremental.begin_transaction();
+	BOOST_CHECK(incremental.add("same(a, g)"));
+	incremental.compute_possible_expression(rs);
+	incremental.rollback();
+	incremental.compute_possible_expression(rs);
+	BOOST_CHECK(same_possible_expression(incremental, full, rs));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_forward_checking_test )
+{
+	engine e;
+	e.add_type("int");
+	e.add_predicate("less_int", 2, boost::assign::list_of("int")("int"), new eval<less, 2>());
+	e.add_predicate("far", 1, boost::assign::list_of("int"));
+	e.add_predicate("small", 1, boost::assign::list_of("int"));
+
+	// three free variables when proving far(X)
+	e.add_rule<std::string>("far_chain",
+					   boost::assign::list_of<std::string>("less_int(X, Y)")("less_int(Y, Z)")
+														  ("less_int(Z, W)")("small(W)"),
+					   boost::assign::list_of<std::string>("far(X)"));
+
+	BOOST_CHECK(e.add_fact("less_int(1, 2)"));
+	BOOST_CHECK(e.add_fact("less_int(2, 3)"));
+	BOOST_CHECK(e.add_fact("less_int(3, 4)"));
+	BOOST_CHECK(e.add_fact("less_int(4, 5)"));
+	BOOST_CHECK(e.add_fact("small(5)"));
+	BOOST_CHECK(e.add_fact("less_int(0, 7)"));
+
+	// most of the partial bindings are refuted by the evaluation of less_int
+	std::vector<function_call> hyps;
+	BOOST_CHECK(e.infer("far(0)", hyps));
+	BOOST_CHECK(e.infer("far(2)", hyps));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("far(4)", hyps)));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("far(7)", hyps)));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_budget_test )
+{
+	engine e;
+	e.add_type("int");
+	e.add_predicate("less_int", 2, boost::assign::list_of("int")("int"), new eval<less, 2>());
+	e.add_predicate("far", 1, boost::assign::list_of("int"));
+	e.add_predicate("farther", 1, boost::assign::list_of("int"));
+	e.add_predicate("small", 1, boost::assign::list_of("int"));
+
+	e.add_rule<std::string>("far_chain",
+					   boost::assign::list_of<std::string>("less_int(X, Y)")("less_int(Y, Z)")
+														  ("less_int(Z, W)")("small(W)"),
+					   boost::assign::list_of<std::string>("far(X)"));
+	e.add_rule<std::string>("farther_chain",
+					   boost::assign::list_of<std::string>("far(X)"),
+					   boost::assign::list_of<std::string>("farther(X)"));
+
+	BOOST_CHECK(e.add_fact("less_int(1, 2)"));
+	BOOST_CHECK(e.add_fact("less_int(2, 3)"));
+	BOOST_CHECK(e.add_fact("less_int(3, 4)"));
+	BOOST_CHECK(e.add_fact("less_int(4, 5)"));
+	BOOST_CHECK(e.add_fact("small(5)"));
+	BOOST_CHECK(e.add_fact("less_int(0, 7)"));
+
+	// farther(1) needs a proof of far(1), which is out of the budget
+	infer_budget one_node(boost::posix_time::ptime(), 1);
+	std::vector<function_call> hyps;
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("farther(1)", one_node)));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("farther(1)", hyps, one_node)));
+	BOOST_CHECK(hyps.size() == 1);
+	std::ostringstream oss;
+	oss << hyps[0];
+	BOOST_CHECK(oss.str() == "far(1)");
+
+	infer_budget expired = infer_budget::within(boost::posix_time::seconds(-1));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("farther(1)", expired)));
+
+	BOOST_CHECK(e.infer("farther(1)", infer_budget(boost::posix_time::ptime(), 2)));
+	BOOST_CHECK(e.infer("farther(0)", infer_budget::within(boost::posix_time::seconds(60))));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_trace_test )
+{
+	std::ostringstream trace;
+	engine e;
+	e.set_trace(&trace);
+
+	e.add_type("double");
+	e.add_predicate("less_double", 2, boost::assign::list_of("double")("double"), new eval<less, 2>());
+
+	generate_return r1 = generate("less_double(X, Y)", e.funcs());
+	generate_return r2 = generate("less_double(Y, Z)", e.funcs());
+	generate_return r3 = generate("less_double(X, Z)", e.funcs());
+	BOOST_CHECK(r1.res && r2.res && r3.res);
+	std::vector<function_call> cond = boost::assign::list_of(r1.e)(r2.e);
+	e.add_rule("less_double_transitivity", cond, std::vector<function_call>(1, r3.e));
+
+	// constants are written so that they can be parsed again
+	generate_return f = generate("less_double(a, 3.0)", e.funcs());
+	BOOST_CHECK(f.res);
+	BOOST_CHECK(e.add_fact(f.e, "ctx"));
+	BOOST_CHECK(e.infer("less_double(a, 3.0)", "ctx"));
+	e.set_trace(0);
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("less_double(a, 2.0)", "ctx")));
+
+	std::string expected = 
+		"type double\n"
+		"predicate less_double 2 double double\n"
+		"rule less_double_transitivity | less_double(X, Y) ; less_double(Y, Z) | less_double(X, Z)\n"
+		"fact ctx | less_double(a, 3.000000)\n"
+		"infer ctx | less_double(a, 3.0)\n";
+	BOOST_CHECK_EQUAL(trace.str(), expected);
+
+	generate_return g = generate("less_double(a, 3.000000)", e.funcs());
+	BOOST_CHECK(g.res && g.e == f.e);
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_trace_string_test )
+{
+	std::ostringstream trace;
+	engine e;
+	e.add_type("string");
+	e.add_predicate("named", 2, boost::assign::list_of("string")("string"));
+	e.set_trace(&trace);
+
+	// parsed constants keep their quotes, the other ones are quoted and escaped
+	generate_return f = generate("named(\"x\", \"y\")", e.funcs());
+	BOOST_CHECK(f.res);
+	BOOST_CHECK(e.add_fact(f.e, "ctx"));
+
+	function_call g(f.e);
+	g.args[0] = Constant<std::string>("a \"b\"");
+	g.args[1] = Constant<std::string>("c\\d");
+	BOOST_CHECK(e.add_fact(g, "ctx"));
+	e.set_trace(0);
+
+	std::string expected = 
+		"fact ctx | named(\"x\", \"y\")\n"
+		"fact ctx | named(\"a \\\"b\\\"\", \"c\\\\d\")\n";
+	BOOST_CHECK_EQUAL(trace.str(), expected);
+
+	generate_return f2 = generate("named(\"x\", \"y\")", e.funcs());
+	BOOST_CHECK(f2.res && f2.e == f.e);
+	generate_return g2 = generate("named(\"a \\\"b\\\"\", \"c\\\\d\")", e.funcs());
+	BOOST_CHECK(g2.res);
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_equality_test )
+{
+	engine e;
+
+	e.add_type("int");
+	e.add_type("double");
+	e.add_type("point");
+	e.add_predicate("less_double", 2, boost::assign::list_of("double")("double"), new eval<less, 2>());
+	e.add_func("distance", 2, boost::assign::list_of("point")("point")("double"));
+
+	// no rule is generated to handle equality
+	std::ostringstream oss;
+	oss << e;
+	BOOST_CHECK(oss.str().find("equal_int") == std::string::npos);
+
+	// transitivity on a long chain of equalities
+	for (size_t i = 0; i < 50; ++i) {
+		std::ostringstream fact;
+		fact << "equal_int(x" << i << ", x" << i + 1 << ")";
+		BOOST_CHECK(e.add_fact(fact.str()));
+	}
+
+	BOOST_CHECK(e.infer("equal_int(x0, x50)"));
+	BOOST_CHECK(e.infer("equal_int(x50, x0)"));
+	BOOST_CHECK(e.infer("equal_int(x17, x17)"));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("equal_int(x0, y)")));
+
+	BOOST_CHECK(e.add_fact("equal_int(x25, 42)"));
+	BOOST_CHECK(e.infer("equal_int(x0, 42)"));
+	BOOST_CHECK(!e.infer("equal_int(x50, 41)"));
+
+	// congruence of functions and predicates
+	BOOST_CHECK(e.add_fact("less_double(distance(a, c), 2.0)"));
+	BOOST_CHECK(e.add_fact("equal_point(a, b)"));
+	BOOST_CHECK(e.infer("less_double(distance(b, c), 2.0)"));
+	BOOST_CHECK(e.infer("equal_double(distance(a, c), distance(b, c))"));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("less_double(distance(c, b), 2.0)")));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_congruence_hypothesis_test )
+{
+	engine e;
+
+	e.add_type("point");
+	e.add_type("double");
+	e.add_predicate("near", 2, boost::assign::list_of("point")("point"));
+	e.add_func("distance", 2, boost::assign::list_of("point")("point")("double"));
+
+	BOOST_CHECK(e.add_fact("near(a, c)"));
+	function_call expected = generate("equal_point(a, b)", e.funcs()).e;
+
+	// near(b, c) if b is a
+	std::vector<function_call> hyps;
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("near(b, c)", hyps)));
+	BOOST_CHECK(std::find(hyps.begin(), hyps.end(), expected) != hyps.end());
+
+	// distance(a, c) is distance(b, c) if b is a
+	hyps.clear();
+	BOOST_CHECK(boost::logic::indeterminate(
+				e.infer("equal_double(distance(a, c), distance(b, c))", hyps)));
+	BOOST_CHECK(std::find(hyps.begin(), hyps.end(), expected) != hyps.end());
+
+	BOOST_CHECK(e.add_fact("equal_point(a, b)"));
+	BOOST_CHECK(e.infer("near(b, c)"));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_congruence_with_rule_test )
+{
+	engine e;
+
+	e.add_type("point");
+	e.add_predicate("near", 2, boost::assign::list_of("point")("point"));
+	e.add_predicate("touch", 2, boost::assign::list_of("point")("point"));
+
+	// near_touch unifies with near(b, c), but touch(b, c) is never known
+	e.add_rule<std::string>("near_touch",
+					   boost::assign::list_of<std::string>("touch(X, Y)"),
+					   boost::assign::list_of<std::string>("near(X, Y)"));
+
+	BOOST_CHECK(e.add_fact("near(a, c)"));
+	function_call by_rule = generate("touch(b, c)", e.funcs()).e;
+	function_call by_equality = generate("equal_point(a, b)", e.funcs()).e;
+
+	// both ways to prove near(b, c) are kept as hypothesis
+	std::vector<function_call> hyps;
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("near(b, c)", hyps)));
+	BOOST_CHECK(std::find(hyps.begin(), hyps.end(), by_rule) != hyps.end());
+	BOOST_CHECK(std::find(hyps.begin(), hyps.end(), by_equality) != hyps.end());
+
+	BOOST_CHECK(e.add_fact("equal_point(a, b)"));
+	BOOST_CHECK(e.infer("near(b, c)"));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_condition_order_test )
+{
+	engine e;
+	e.add_type("object");
+	e.add_predicate("on", 2, boost::assign::list_of("object")("object"));
+	e.add_predicate("red", 1, boost::assign::list_of("object"));
+	e.add_predicate("on_red", 1, boost::assign::list_of("object"));
+
+	// the most selective condition is the last one
+	e.add_rule<std::string>("on_red_stack",
+					   boost::assign::list_of<std::string>("on(X, Y)")("on(Y, Z)")("red(Z)"),
+					   boost::assign::list_of<std::string>("on_red(X)"));
+
+	for (size_t i = 0; i < 30; ++i) {
+		std::ostringstream oss;
+		oss << "on(o" << i << ", o" << i + 1 << ")";
+		BOOST_CHECK(e.add_fact(oss.str()));
+	}
+	BOOST_CHECK(e.add_fact("red(o20)"));
+
+	BOOST_CHECK(e.infer("on_red(o18)"));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("on_red(o17)")));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("on_red(o19)")));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_consistency_test )
+{
+	engine e;
+	fill_engine(e);
+
+	// inconsistency rule, through a new fact
+	BOOST_CHECK(!e.add_fact("less_int(f, a)"));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("less_int(f, a)")));
+
+	// evaluation of an old fact, through the binding of its logic variables
+	BOOST_CHECK(e.add_fact("less_int(p, q)"));
+	BOOST_CHECK(e.add_fact("equal_int(p, 5)"));
+	BOOST_CHECK(!e.add_fact("equal_int(q, 3)"));
+	BOOST_CHECK(e.add_fact("equal_int(q, 7)"));
+	BOOST_CHECK(!e.infer("less_int(q, p)"));
+
+	// merge of logic variables
+	BOOST_CHECK(!e.add_fact("equal_int(a, f)"));
+	BOOST_CHECK(e.infer("less_int(a, f)"));
+
+	// the hypothesis are checked without modifying the facts
+	std::vector<function_call> before = e.known_facts();
+	std::vector<function_call> hyps;
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("less_int(p, z)", hyps)));
+	BOOST_CHECK(e.known_facts() == before);
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_tabling_test )
+{
+	engine e;
+	fill_engine(e);
+
+	// the same query twice gives the same answer, the second one being tabled
+	std::vector<function_call> hyps1, hyps2;
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("less_int(a, g)", hyps1)));
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("less_int(a, g)", hyps2)));
+	BOOST_CHECK(hyps1 == hyps2);
+	BOOST_CHECK(!hyps1.empty());
+
+	// a new fact invalidates the table
+	BOOST_CHECK(e.add_fact("less_int(f, g)"));
+	BOOST_CHECK(e.infer("less_int(a, g)", hyps1));
+
+	// so does a new rule
+	BOOST_CHECK(boost::logic::indeterminate(e.infer("less_int(h, i)")));
+	e.add_rule<std::string>("less_int_h",
+					   boost::assign::list_of<std::string>("less_int(a, X)"),
+					   boost::assign::list_of<std::string>("less_int(h, i)"));
+	BOOST_CHECK(e.infer("less_int(h, i)"));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_parallel_infer_test )
+{
+	engine e;
+	fill_engine(e);
+	e.set_parallelism(4);
+	e.set_parallel_threshold(0);
+
+	for (size_t i = 0; i < 20; ++i) {
+		std::ostringstream task;
+		task << "task" << i;
+		std::ostringstream fact;
+		fact << "less_int(f, " << (i % 3 ? "g" : "h") << ")";
+		BOOST_CHECK(e.add_fact(fact.str(), task.str()));
+		BOOST_CHECK(e.add_fact("less_int(g, k)", task.str()));
+	}
+
+	std::vector<std::string> res1, res2;
+	std::vector<engine::plausible_hypothesis> hyps1, hyps2;
+	std::vector<std::string> excluded = boost::assign::list_of("task4")("task5");
+
+	e.infer_all_in("less_int(f, k)", std::back_inserter(res1), std::back_inserter(hyps1),
+				   excluded.begin(), excluded.end());
+	e.parallel_infer_all_in("less_int(f, k)", std::back_inserter(res2), std::back_inserter(hyps2),
+							excluded.begin(), excluded.end());
+
+	BOOST_CHECK(res1 == res2);
+	BOOST_CHECK(std::find(res2.begin(), res2.end(), "task4") == res2.end());
+	BOOST_CHECK(hyps1.size() == hyps2.size());
+	for (size_t i = 0; i < hyps1.size() && i < hyps2.size(); ++i) {
+		BOOST_CHECK(hyps1[i].name == hyps2[i].name);
+		BOOST_CHECK(hyps1[i].hyps == hyps2[i].hyps);
+	}
+
+	// the threads of the first call are reused
+	res2.clear();
+	hyps2.clear();
+	e.parallel_infer_all_in("less_int(f, k)", std::back_inserter(res2), std::back_inserter(hyps2),
+							excluded.begin(), excluded.end());
+	BOOST_CHECK(res1 == res2);
+	BOOST_CHECK(hyps1.size() == hyps2.size());
+
+	// not enough facts to use the threads
+	res2.clear();
+	hyps2.clear();
+	e.set_parallel_threshold(1000);
+	e.parallel_infer_all_in("less_int(f, k)", std::back_inserter(res2), std::back_inserter(hyps2),
+							excluded.begin(), excluded.end());
+	BOOST_CHECK(res1 == res2);
+	BOOST_CHECK(hyps1.size() == hyps2.size());
+
+	res2.clear();
+	hyps2.clear();
+	e.set_parallelism(1);
+	e.parallel_infer_all("less_int(f, k)", std::back_inserter(res2), std::back_inserter(hyps2));
+	BOOST_CHECK(res2.size() == res1.size() + 2);
+}
+
+namespace hyper {
+	namespace {
+		/* native matcher for less_int(A, B) && less_int(B, 3), as generated by hyperc */
+		void less_than_3_matcher(const logic::rule& r, const logic::facts& fs,
+				const logic::facts::delta_type* delta, size_t delta_cond,
+				std::vector<logic::substitution>& res)
+		{
+			assert(r.symbols.size() == 2);
+			switch (delta ? delta_cond : 0) {
+				case 0: {
+					logic::native::candidates c0(fs, delta, delta_cond, 0, r.condition[0].id);
+					const logic::function_call* f0;
+					while (c0.next(f0)) {
+						const logic::expression& v0 = f0->args[0];
+						const logic::expression& v1 = f0->args[1];
+						logic::native::candidates c1(fs, delta, delta_cond, 1, r.condition[1].id, 0, v1);
+						const logic::function_call* f1;
+						while (c1.next(f1)) {
+							if (!logic::native::same(f1->args[0], v1)) continue;
+							if (!logic::native::is_constant<int>(f1->args[1], 3)) continue;
+							logic::substitution s(2);
+							s[0] = v0;
+							s[1] = v1;
+							res.push_back(s);
+						}
+					}
+					break;
+				}
+				case 1: {
+					logic::native::candidates c1(fs, delta, delta_cond, 1, r.condition[1].id, 1, r.condition[1].args[1]);
+					const logic::function_call* f1;
+					while (c1.next(f1)) {
+						const logic::expression& v1 = f1->args[0];
+						if (!logic::native::is_constant<int>(f1->args[1], 3)) continue;
+						logic::native::candidates c0(fs, delta, delta_cond, 0, r.condition[0].id, 1, v1);
+						const logic::function_call* f0;
+						while (c0.next(f0)) {
+							const logic::expression& v0 = f0->args[0];
+							if (!logic::native::same(f0->args[1], v1)) continue;
+							logic::substitution s(2);
+							s[0] = v0;
+							s[1] = v1;
+							res.push_back(s);
+						}
+					}
+					break;
+				}
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_native_rule_test )
+{
+	engine interpreted, native;
+	engine* engines[2] = { &interpreted, &native };
+
+	for (size_t i = 0; i < 2; ++i) {
+		engine& e = *engines[i];
+		e.add_type("int");
+		e.add_predicate("less_int", 2, boost::assign::list_of("int")("int"), new eval<less, 2>());
+		e.add_predicate("small", 1, boost::assign::list_of("int"));
+	}
+
+	std::vector<std::string> cond = boost::assign::list_of("less_int(A, B)")("less_int(B, 3)");
+	std::vector<std::string> action = boost::assign::list_of("small(A)");
+	interpreted.add_rule("less_than_3", cond, action);
+
+	std::vector<function_call> cond_f, action_f;
+	for (size_t i = 0; i < cond.size(); ++i)
+		cond_f.push_back(generate(cond[i], native.funcs()).e);
+	action_f.push_back(generate(action[0], native.funcs()).e);
+	BOOST_CHECK(native.add_rule("less_than_3", cond_f, action_f, &hyper::less_than_3_matcher));
+
+	const char* facts[] = { "less_int(a, b)", "less_int(b, 3)", "less_int(c, b)", 
+							"less_int(d, e)", "less_int(e, 4)", "less_int(e, 3)" };
+	for (size_t i = 0; i < 6; ++i) {
+		BOOST_CHECK(interpreted.add_fact(facts[i]));
+		BOOST_CHECK(native.add_fact(facts[i]));
+	}
+
+	const char* objects[] = { "a", "b", "c", "d", "e" };
+	for (size_t i = 0; i < 5; ++i) {
+		std::string goal = std::string("small(") + objects[i] + ")";
+		tribool r1 = interpreted.infer(goal);
+		tribool r2 = native.infer(goal);
+		BOOST_CHECK(boost::logic::indeterminate(r1) == boost::logic::indeterminate(r2));
+		BOOST_CHECK(!boost::logic::indeterminate(r1) || i == 1 || i == 4);
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( logic_engine_declarations_test )
+{
+	std::vector<std::string> cond = boost::assign::list_of("before(X, Y)")("before(Y, Z)");
+	std::vector<std::string> action = boost::assign::list_of("before(X, Z)");
+
+	engine e;
+	e.add_type("int");
+	e.add_predicate("before", 2, boost::assign::list_of("int")("int"));
+	BOOST_CHECK(e.add_fact("before(a, b)"));
+	BOOST_CHECK(e.add_fact("before(a, b)", "task"));
+	BOOST_CHECK(e.add_fact("before(b, c)", "task"));
+	size_t nb_default = e.known_facts().size();
+	size_t nb_task = e.known_facts("task").size();
+
+	// the rule is not applied to the known facts until end_declarations
+	e.begin_declarations();
+	e.add_rule("before_transitivity", cond, action);
+	BOOST_CHECK(e.known_facts().size() == nb_default);
+	BOOST_CHECK(e.known_facts("task").size() == nb_task);
+
+	e.end_declarations();
+	BOOST_CHECK(e.known_facts("task").size() > nb_task);
+	BOOST_CHECK(e.infer("before(a, c)", "task") == true);
+
+	// afterwards, a new rule is applied at once
+	std::vector<std::string> other_cond = boost::assign::list_of("before(X, Y)");
+	std::vector<std::string> other_action = boost::assign::list_of("after(Y, X)");
+	e.add_predicate("after", 2, boost::assign::list_of("int")("int"));
+	nb_default = e.known_facts().size();
+	e.add_rule("before_after", other_cond, other_action);
+	BOOST_CHECK(e.known_facts().size() > nb_default);
+	e.end_declarations();
+}
@@ -65,4 +65,15 @@ BOOST_AUTO_TEST_CASE ( logic_expression_test)
 	BOOST_CHECK(! (r1.e < r4.e));
 	BOOST_CHECK(! (r3.e < r6.e));
 
+	BOOST_CHECK(compare(r1.e, r4.e) == 0);
+	BOOST_CHECK(compare(r1.e, r2.e) < 0);
+	BOOST_CHECK(compare(r2.e, r1.e) > 0);
+	BOOST_CHECK(compare(expression(r2.e), expression(r5.e)) == 0);
+	BOOST_CHECK(compare(r2.e.args[1], r1.e.args[1]) > 0);
+
+	// equal terms have the same hash
+	BOOST_CHECK(hash_value(r1.e) == hash_value(r4.e));
+	BOOST_CHECK(hash_value(r2.e) == hash_value(r5.e));
+	BOOST_CHECK(hash_value(expression(r2.e)) == hash_value(expression(r5.e)));
+	BOOST_CHECK(hash_value(r1.e) != hash_value(r2.e));
 }
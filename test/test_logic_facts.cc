@@ -2,6 +2,8 @@
 #include <logic/eval.hh>
 #include <boost/test/unit_test.hpp>
 #include <boost/variant/apply_visitor.hpp>
+#include <algorithm>
+#include <sstream>
 
 using namespace boost::logic;
 using namespace hyper::logic;
@@ -129,3 +131,211 @@ BOOST_AUTO_TEST_CASE ( logic_facts_test )
 	BOOST_CHECK(r.res);
 	BOOST_CHECK(boost::logic::indeterminate( our_facts.matches(r.e)));
 }
+
+BOOST_AUTO_TEST_CASE ( logic_facts_index_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	facts our_facts(funcs);
+
+	funcs.add("equal", 2, new eval<equal, 2>(), true);
+	funcs.add("near", 2);
+
+	our_facts.add("near(a, b)");
+	our_facts.add("near(a, c)");
+	our_facts.add("near(b, c)");
+
+	function_call f = our_facts.generate("near(a, b)");
+	BOOST_CHECK(our_facts.find(f.id, 0, f.args[0]).size() == 2);
+	BOOST_CHECK(our_facts.find(f.id, 1, f.args[1]).size() == 1);
+	BOOST_CHECK(our_facts.find(f.id, 0, f.args[1]).size() == 1);
+	BOOST_CHECK(*our_facts.find(f.id, 1, f.args[1])[0] == f);
+
+	// the index is maintained when adding new facts
+	our_facts.add("near(c, b)");
+	BOOST_CHECK(our_facts.find(f.id, 1, f.args[1]).size() == 2);
+
+	// a copy rebuilds its own index
+	facts copy(our_facts);
+	BOOST_CHECK(copy.find(f.id, 1, f.args[1]).size() == 2);
+
+	// and it is rebuilt after a unification of logic variables
+	our_facts.add("equal(b, c)");
+	f = our_facts.generate("near(a, b)");
+	BOOST_CHECK(our_facts.size(f.id) == 2);
+	BOOST_CHECK(our_facts.find(f.id, 0, f.args[0]).size() == 1);
+	BOOST_CHECK(our_facts.find(f.id, 1, f.args[1]).size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE ( logic_facts_transaction_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	facts our_facts(funcs);
+
+	funcs.add("equal", 2, new eval<equal, 2>(), true);
+	funcs.add("less", 2, new eval<less, 2>());
+
+	our_facts.add("less(x, y)");
+	our_facts.add("equal(y, 7)");
+
+	std::ostringstream before;
+	before << our_facts;
+
+	// simple insertions and binding of a logic variable
+	our_facts.begin_transaction();
+	our_facts.add("less(y, z)");
+	our_facts.add("equal(x, 3)");
+	BOOST_CHECK(our_facts.size() == 2);
+	BOOST_CHECK(our_facts.matches(our_facts.generate("less(x, 7)")) == true);
+	our_facts.rollback();
+
+	std::ostringstream after;
+	after << our_facts;
+	BOOST_CHECK(before.str() == after.str());
+	BOOST_CHECK(our_facts.size() == 1);
+	BOOST_CHECK(boost::logic::indeterminate(our_facts.matches(our_facts.generate("less(x, 7)"))));
+
+	// merge of logic variables
+	our_facts.begin_transaction();
+	our_facts.add("less(z, w)");
+	our_facts.add("equal(x, z)");
+	BOOST_CHECK(our_facts.matches(our_facts.generate("less(z, y)")) == true);
+	our_facts.rollback();
+
+	std::ostringstream after_merge;
+	after_merge << our_facts;
+	BOOST_CHECK(before.str() == after_merge.str());
+	BOOST_CHECK(boost::logic::indeterminate(our_facts.matches(our_facts.generate("less(z, y)"))));
+
+	// and commit
+	our_facts.begin_transaction();
+	our_facts.add("equal(x, z)");
+	our_facts.commit();
+	BOOST_CHECK(our_facts.matches(our_facts.generate("less(z, y)")) == true);
+}
+
+BOOST_AUTO_TEST_CASE ( logic_facts_transaction_changes_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	facts our_facts(funcs);
+
+	funcs.add("equal", 2, new eval<equal, 2>(), true);
+	funcs.add("less", 2, new eval<less, 2>());
+	funcs.add("near", 2);
+
+	our_facts.add("less(x, y)");
+	our_facts.add("less(a, b)");
+	our_facts.add("near(x, y)");
+
+	facts::delta_type d;
+	std::vector<function_call> to_match;
+	BOOST_CHECK(!our_facts.transaction_changes(d, to_match));
+
+	our_facts.begin_transaction();
+	our_facts.add("near(y, z)");
+	our_facts.add("equal(x, 3)");
+	BOOST_CHECK(our_facts.transaction_changes(d, to_match));
+
+	function_call new_fact = our_facts.generate("near(y, z)");
+	BOOST_CHECK(d.size == 1);
+	BOOST_CHECK(d.list[new_fact.id].count(new_fact) == 1);
+
+	// near is not evaluable, so near(x, y) can't change
+	BOOST_CHECK(to_match.size() == 2);
+	BOOST_CHECK(std::count(to_match.begin(), to_match.end(), new_fact) == 1);
+	BOOST_CHECK(std::count(to_match.begin(), to_match.end(), 
+						   our_facts.generate("less(x, y)")) == 1);
+	our_facts.rollback();
+}
+
+BOOST_AUTO_TEST_CASE ( logic_facts_copy_on_write_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	facts base(funcs);
+
+	funcs.add("equal", 2, new eval<equal, 2>(), true);
+	funcs.add("near", 2);
+
+	base.add("near(a, b)");
+	base.add("near(b, c)");
+
+	facts copy(base);
+	function_call f = copy.generate("near(b, c)");
+	BOOST_CHECK(copy.find(f.id, 0, f.args[0]).size() == 1);
+
+	// the modifications of a copy are not seen by the other one
+	copy.add("near(b, d)");
+	BOOST_CHECK(copy.size(f.id) == 3);
+	BOOST_CHECK(base.size(f.id) == 2);
+	BOOST_CHECK(copy.find(f.id, 0, f.args[0]).size() == 2);
+	BOOST_CHECK(boost::logic::indeterminate(base.matches(base.generate("near(b, d)"))));
+
+	base.add("near(c, a)");
+	BOOST_CHECK(base.size(f.id) == 3);
+	BOOST_CHECK(boost::logic::indeterminate(copy.matches(copy.generate("near(c, a)"))));
+
+	// a rollback gives back the shared facts
+	facts other(base);
+	std::ostringstream before;
+	before << other;
+	other.begin_transaction();
+	other.add("near(d, a)");
+	BOOST_CHECK(other.size(f.id) == 4);
+	other.rollback();
+
+	std::ostringstream after;
+	after << other;
+	BOOST_CHECK(before.str() == after.str());
+	BOOST_CHECK(other.find(f.id, 0, f.args[0]).size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE ( logic_facts_batch_matches_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	facts our_facts(funcs);
+
+	funcs.add("equal", 2, new eval<equal, 2>(), true);
+	funcs.add("less", 2, new eval<less, 2>());
+	funcs.add("near", 2);
+
+	our_facts.add("less(1, 2)");
+	our_facts.add("less(3, 2)");
+	our_facts.add("less(x, 2)");
+	our_facts.add("near(a, b)");
+
+	std::vector<function_call> v;
+	v.push_back(our_facts.generate("less(1, 2)"));
+	v.push_back(our_facts.generate("less(3, 2)"));
+	v.push_back(our_facts.generate("less(x, 2)"));
+	v.push_back(our_facts.generate("less(y, 2)"));
+	v.push_back(our_facts.generate("near(a, b)"));
+	v.push_back(our_facts.generate("near(b, a)"));
+	v.push_back(our_facts.generate("equal(x, x)"));
+
+	// the batch gives the same results than matches
+	std::vector<tribool> res;
+	our_facts.matches(v, res);
+	BOOST_CHECK(res.size() == v.size());
+	for (size_t i = 0; i < v.size(); ++i) {
+		tribool b = our_facts.matches(v[i]);
+		BOOST_CHECK((indeterminate(b) && indeterminate(res[i])) || b == res[i]);
+	}
+
+	// and on a whole category, appending to res
+	function_call f = our_facts.generate("less(1, 2)");
+	our_facts.matches(f.id, res);
+	BOOST_CHECK(res.size() == v.size() + 3);
+	size_t nb_true = 0;
+	for (size_t i = v.size(); i < res.size(); ++i)
+		if (res[i]) nb_true++;
+	BOOST_CHECK(nb_true == 2);
+}
@@ -0,0 +1,112 @@
+#include <logic/engine.hh>
+#include <boost/test/unit_test.hpp>
+#include <boost/assign/list_of.hpp>
+
+/* generated by gen_native_matchers, as by hyperc --native-rules */
+#include <native_matchers.hh>
+
+using namespace hyper::logic;
+
+namespace {
+	struct rule_def {
+		const char* name;
+		std::vector<std::string> cond;
+		std::vector<std::string> action;
+		rule::matcher_type matcher;
+	};
+
+	std::vector<rule_def> rule_defs()
+	{
+		using namespace hyper::native_test;
+
+		std::vector<rule_def> res(4);
+		res[0].name = "path_base";
+		res[0].cond = boost::assign::list_of("edge(A, B)");
+		res[0].action = boost::assign::list_of("path(A, B)");
+		res[0].matcher = &path_base_matcher;
+
+		res[1].name = "path_step";
+		res[1].cond = boost::assign::list_of("path(A, B)")("edge(B, C)");
+		res[1].action = boost::assign::list_of("path(A, C)");
+		res[1].matcher = &path_step_matcher;
+
+		res[2].name = "loop";
+		res[2].cond = boost::assign::list_of("path(A, A)");
+		res[2].action = boost::assign::list_of("loop(A)");
+		res[2].matcher = &loop_matcher;
+
+		res[3].name = "before_3";
+		res[3].cond = boost::assign::list_of("edge(A, B)")("edge(B, 3)");
+		res[3].action = boost::assign::list_of("before_3(A)");
+		res[3].matcher = &before_3_matcher;
+		return res;
+	}
+
+	void declare(engine& e)
+	{
+		e.add_type("int");
+		e.add_predicate("edge", 2, boost::assign::list_of("int")("int"));
+		e.add_predicate("path", 2, boost::assign::list_of("int")("int"));
+		e.add_predicate("loop", 1, boost::assign::list_of("int"));
+		e.add_predicate("before_3", 1, boost::assign::list_of("int"));
+	}
+
+	std::vector<function_call> generate_all(const std::vector<std::string>& v,
+											const funcDefList& funcs)
+	{
+		std::vector<function_call> res;
+		for (size_t i = 0; i < v.size(); ++i) {
+			generate_return r = generate(v[i], funcs);
+			BOOST_REQUIRE(r.res);
+			res.push_back(r.e);
+		}
+		return res;
+	}
+}
+
+/*
+ * The generated matchers must derive the same facts than the
+ * interpreted unification of the same rules, with the full evaluation
+ * (naive) and with the delta of the semi-naive one
+ */
+BOOST_AUTO_TEST_CASE ( logic_native_rule_generated_test )
+{
+	chaining_strategy strategies[2] = { naive_chaining, semi_naive_chaining };
+	const char* facts[] = { "edge(a, b)", "edge(b, 3)", "edge(c, b)", "edge(3, d)",
+							"edge(d, 4)", "edge(e, 4)", "edge(d, a)", "edge(4, 3)" };
+	const size_t nb_facts = sizeof(facts) / sizeof(facts[0]);
+
+	std::vector<rule_def> defs = rule_defs();
+
+	for (size_t s = 0; s < 2; ++s) {
+		engine interpreted, native;
+		interpreted.set_chaining_strategy(strategies[s]);
+		native.set_chaining_strategy(strategies[s]);
+		declare(interpreted);
+		declare(native);
+
+		for (size_t i = 0; i < defs.size(); ++i) {
+			BOOST_CHECK(interpreted.add_rule(defs[i].name, defs[i].cond, defs[i].action));
+			BOOST_CHECK(native.add_rule(defs[i].name,
+										generate_all(defs[i].cond, native.funcs()),
+										generate_all(defs[i].action, native.funcs()),
+										defs[i].matcher));
+		}
+
+		// facts added one by one, so the rules are applied to each delta
+		for (size_t i = 0; i < nb_facts; ++i) {
+			BOOST_CHECK(interpreted.add_fact(facts[i]));
+			BOOST_CHECK(native.add_fact(facts[i]));
+
+			std::vector<function_call> expected = interpreted.known_facts();
+			std::vector<function_call> res = native.known_facts();
+			BOOST_CHECK(expected.size() == res.size());
+			BOOST_CHECK(expected == res);
+		}
+
+		BOOST_CHECK(native.infer("loop(a)") == true);
+		BOOST_CHECK(native.infer("before_3(c)") == true);
+		BOOST_CHECK(native.infer("before_3(e)") == true);
+		BOOST_CHECK(native.infer("path(e, b)") == true);
+	}
+}
@@ -0,0 +1,124 @@
+#include <logic/facts.hh>
+#include <logic/term.hh>
+#include <boost/test/unit_test.hpp>
+
+#include <boost/optional/optional.hpp>
+
+BOOST_AUTO_TEST_CASE ( logic_term_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	funcs.add("distance", 2);
+	funcs.add("near", 2);
+	term_table& terms = funcs.terms();
+
+	generate_return r1 = generate("near(distance(a, b), 3.0)", funcs);
+	generate_return r2 = generate("near(distance(a, b), 3.0)", funcs);
+	generate_return r3 = generate("near(distance(a, c), 3.0)", funcs);
+	BOOST_CHECK(r1.res && r2.res && r3.res);
+
+	// find doesn't add anything to the table
+	BOOST_CHECK(!terms.find(r1.e));
+	BOOST_CHECK(terms.size() == 0);
+
+	term t1 = terms.make(r1.e);
+	size_t size = terms.size();
+	BOOST_CHECK(size == 5);
+
+	// equal expressions have the same term, built only once
+	BOOST_CHECK(terms.make(r2.e) == t1);
+	BOOST_CHECK(terms.size() == size);
+	BOOST_CHECK(terms.find(r2.e) && *terms.find(r2.e) == t1);
+
+	// only the new sub-terms are added
+	term t3 = terms.make(r3.e);
+	BOOST_CHECK(t3 != t1);
+	BOOST_CHECK(terms.size() == size + 3);
+
+	BOOST_CHECK(terms.kind(t1) == term_table::function_);
+	std::vector<term> args;
+	terms.args(t1, args);
+	BOOST_CHECK(args.size() == 2);
+	BOOST_CHECK(terms.kind(args[1]) == term_table::double_);
+	BOOST_CHECK(terms.make(r1.e.args[0]) == args[0]);
+
+	// conversion back
+	BOOST_CHECK(terms.to_function_call(t1) == r1.e);
+	BOOST_CHECK(terms.to_function_call(t1).name == "near");
+	BOOST_CHECK(terms.to_expression(args[1]) == expression(Constant<double>(3.0)));
+
+	// variables and string constants are different terms
+	term var = terms.make(expression(std::string("a")));
+	term cst = terms.make(expression(Constant<std::string>("a")));
+	BOOST_CHECK(var != cst);
+	BOOST_CHECK(terms.make(expression(Constant<double>(-0.0))) ==
+				terms.make(expression(Constant<double>(0.0))));
+	BOOST_CHECK(terms.make(expression(Constant<int>(-1))) !=
+				terms.make(expression(Constant<double>(-1.0))));
+	BOOST_CHECK(terms.to_expression(terms.make(expression(Constant<int>(-1)))) ==
+				expression(Constant<int>(-1)));
+}
+
+BOOST_AUTO_TEST_CASE ( logic_term_set_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	funcs.add("near", 2);
+	term_table& terms = funcs.terms();
+
+	function_call f1 = generate("near(a, b)", funcs).e;
+	function_call f2 = generate("near(b, a)", funcs).e;
+
+	term_set<function_call> s(&terms);
+	BOOST_CHECK(s.insert(f1).second);
+	BOOST_CHECK(!s.insert(generate("near(a, b)", funcs).e).second);
+	BOOST_CHECK(s.size() == 1);
+	BOOST_CHECK(s.count(f1) == 1);
+	BOOST_CHECK(s.count(f2) == 0);
+
+	term_set<function_call>::const_iterator it = s.find(f1);
+	BOOST_CHECK(it != s.end());
+	BOOST_CHECK(*it == f1);
+	BOOST_CHECK(it.key() == *terms.find(f1));
+
+	term_set<function_call> copy(s);
+	BOOST_CHECK(copy == s);
+	copy.insert(f2);
+	BOOST_CHECK(copy != s);
+	BOOST_CHECK(copy.erase(f1) == 1);
+	BOOST_CHECK(copy.erase(f1) == 0);
+	BOOST_CHECK(copy.size() == 1 && *copy.begin() == f2);
+
+	// a set without table is empty
+	term_set<function_call> empty;
+	BOOST_CHECK(empty.find(f1) == empty.end());
+}
+
+BOOST_AUTO_TEST_CASE ( logic_term_facts_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList funcs;
+	funcs.add("near", 2);
+	facts our_facts(funcs);
+
+	our_facts.add("near(a, b)");
+	our_facts.add("near(a, c)");
+	size_t size = funcs.terms().size();
+
+	// the facts share the terms of their arguments
+	BOOST_CHECK(size == 5);
+
+	// a lookup of an unknown fact doesn't grow the table
+	function_call unknown = our_facts.generate("near(d, e)");
+	BOOST_CHECK(our_facts.find(unknown) == our_facts.end(unknown.id));
+	BOOST_CHECK(our_facts.find(unknown.id, 0, unknown.args[0]).empty());
+	BOOST_CHECK(funcs.terms().size() == size);
+
+	function_call f = our_facts.generate("near(a, b)");
+	BOOST_CHECK(our_facts.find(f) != our_facts.end(f.id));
+	BOOST_CHECK(our_facts.find(f.id, 0, f.args[0]).size() == 2);
+	BOOST_CHECK(our_facts.has_sub_expression(f.id, f.args[1]));
+}
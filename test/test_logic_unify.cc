@@ -112,3 +112,52 @@ BOOST_AUTO_TEST_CASE ( logic_unify_test )
 	
 	
 }
+
+BOOST_AUTO_TEST_CASE ( logic_unify_slots_test )
+{
+	using namespace hyper::logic;
+
+	funcDefList list;
+	list.add("equal", 2);
+	list.add("plus", 2);
+
+	// rule variables, sorted : a -> 0, b -> 1
+	std::vector<std::string> symbols;
+	symbols.push_back("a");
+	symbols.push_back("b");
+
+	generate_return cond, r1, r2, r3;
+	cond = generate("equal(a, b)", list);
+	r1 = generate("equal(x, 7)", list);
+	r2 = generate("equal(x, x)", list);
+	r3 = generate("equal(b, 7)", list);
+
+	std::vector<int> slots;
+	slots.push_back(0);
+	slots.push_back(1);
+
+	substitution s(symbols.size());
+	BOOST_CHECK(!is_bound(s[0]));
+	BOOST_CHECK(unify(cond.e, slots, r1.e, s));
+	BOOST_CHECK(s[0] == expression(std::string("x")));
+	BOOST_CHECK(s[1] == expression(Constant<int>(7)));
+
+	// a is already bound to x
+	substitution s2(symbols.size());
+	s2[0] = std::string("x");
+	BOOST_CHECK(unify(cond.e, slots, r2.e, s2));
+	BOOST_CHECK(s2[1] == expression(std::string("x")));
+
+	// constant in the condition
+	std::vector<int> slots2;
+	slots2.push_back(0);
+	slots2.push_back(-1);
+	substitution s3(symbols.size());
+	BOOST_CHECK(unify(r3.e, slots2, r1.e, s3));
+	BOOST_CHECK(!unify(r3.e, slots2, r2.e, s3));
+
+	generate_return action = generate("equal(plus(a, b), c)", list);
+	function_call res = substitute(action.e, symbols, s);
+	generate_return expected = generate("equal(plus(x, 7), c)", list);
+	BOOST_CHECK(res == expected.e);
+}
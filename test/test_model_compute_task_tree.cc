@@ -0,0 +1,401 @@
+#include <model/ability_impl.hh>
+#include <model/logic_layer_impl.hh>
+#include <model/task.hh>
+#include <model/recipe.hh>
+#include <boost/test/unit_test.hpp>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/thread.hpp>
+
+#include <network/nameserver.hh>
+
+namespace {
+	using namespace hyper::model;
+
+	struct planner_ability : public hyper::model::ability
+	{
+		std::set<std::string> done; /**< tasks executed so far */
+		std::set<std::string> broken; /**< tasks whose recipe can't be executed */
+		std::vector<std::string> executed; /**< in execution order */
+
+		boost::optional<hyper::network::request_constraint_answer::state_> res;
+
+		boost::thread::id io_thread; /**< the thread running io_s */
+		std::set<boost::thread::id> eval_threads; /**< threads evaluating preconditions */
+
+		planner_ability() : hyper::model::ability("planner") {}
+
+		void handle_exec(hyper::network::request_constraint_answer::state_ s,
+						 const hyper::network::error_context&)
+		{
+			res = s;
+			stop();
+		}
+
+		void exec(const std::string& task)
+		{
+			io_thread = boost::this_thread::get_id();
+			logic().async_exec(task, 0, "test",
+					boost::bind(&planner_ability::handle_exec, this, _1, _2));
+		}
+
+		void make(const std::string& constraint)
+		{
+			io_thread = boost::this_thread::get_id();
+			logic_constraint ctr;
+			ctr.id = 0;
+			ctr.src = "test";
+			ctr.repeat = false;
+			ctr.internal = false;
+			ctr.s = hyper::network::request_constraint_answer::INIT;
+			logic().async_exec(ctr, constraint, unify_pair_list(),
+					boost::bind(&planner_ability::handle_exec, this, _1, _2));
+		}
+	};
+
+	/*
+	 * A task whose precondition i holds once one of the tasks
+	 * providers[i] has been executed
+	 */
+	struct world_task : public hyper::model::task
+	{
+		planner_ability& a;
+		conditionV preconds;
+		std::vector<std::vector<std::string> > providers;
+
+		world_task(planner_ability& a, const std::string& name) :
+			hyper::model::task(a, name), a(a) {}
+
+		void add_precondition(const std::string& cond,
+							  const std::vector<std::string>& tasks)
+		{
+			hyper::logic::generate_return r =
+				hyper::logic::generate(cond, a.logic().engine.funcs());
+			BOOST_REQUIRE(r.res);
+			preconds.push_back(r.e);
+			providers.push_back(tasks);
+		}
+
+		void async_evaluate_preconditions(condition_execution_callback cb)
+		{
+			a.eval_threads.insert(boost::this_thread::get_id());
+
+			conditionV failed;
+			for (size_t i = 0; i < preconds.size(); ++i) {
+				bool ok = false;
+				for (size_t j = 0; j < providers[i].size(); ++j)
+					ok = ok || a.done.count(providers[i][j]);
+				if (!ok)
+					failed.push_back(preconds[i]);
+			}
+			cb(boost::system::error_code(), failed);
+		}
+
+		void async_evaluate_postconditions(condition_execution_callback cb)
+		{
+			cb(boost::system::error_code(), conditionV());
+		}
+
+		bool has_postconditions() const { return false; }
+	};
+
+	struct world_recipe : public hyper::model::recipe
+	{
+		planner_ability& a;
+		std::string task_name;
+
+		world_recipe(planner_ability& a, world_task& t, const std::string& task_name) :
+			recipe(task_name + "_recipe", a, t), a(a), task_name(task_name)
+		{
+			nb_preconditions_ = 0;
+			has_end_handler = false;
+		}
+
+		virtual void async_evaluate_preconditions(condition_execution_callback cb)
+		{
+			conditionV failed;
+			if (a.broken.count(task_name))
+				failed.push_back(hyper::logic::function_call("broken"));
+			cb(boost::system::error_code(), failed);
+		}
+
+		virtual void do_execute(abortable_computation::cb_type cb, bool)
+		{
+			a.executed.push_back(task_name);
+			a.done.insert(task_name);
+			cb(boost::system::error_code());
+		}
+
+		virtual void do_end(abortable_computation::cb_type cb)
+		{
+			cb(boost::system::error_code());
+		}
+	};
+
+	boost::shared_ptr<world_task> add_task(planner_ability& a, const std::string& name,
+										   const std::vector<std::string>& post)
+	{
+		boost::shared_ptr<world_task> t(new world_task(a, name));
+		t->add_recipe(recipe_ptr(new world_recipe(a, *t, name)));
+		a.logic().tasks[name] = t;
+		for (size_t i = 0; i < post.size(); ++i)
+			BOOST_CHECK(a.logic().engine.add_fact(post[i], name));
+		return t;
+	}
+
+	void run_request(planner_ability& a, boost::function<void (void)> start)
+	{
+		a.res = boost::none;
+		a.io_s.reset();
+		a.io_s.post(start);
+		boost::thread thr(boost::bind(&planner_ability::test_run, &a));
+		bool terminated = thr.timed_join(boost::posix_time::seconds(10));
+		BOOST_CHECK(terminated);
+		if (!terminated) {
+			a.io_s.stop();
+			thr.join();
+		}
+	}
+
+	void run(planner_ability& a, const std::string& task)
+	{
+		run_request(a, boost::bind(&planner_ability::exec, &a, task));
+	}
+
+	void make(planner_ability& a, const std::string& constraint)
+	{
+		a.executed.clear();
+		run_request(a, boost::bind(&planner_ability::make, &a, constraint));
+	}
+
+	bool has_executed(const planner_ability& a, const std::string& task)
+	{
+		return std::find(a.executed.begin(), a.executed.end(), task) != a.executed.end();
+	}
+
+	/*
+	 * root needs goal(1), provided by two alternatives, first and second.
+	 * first needs c1(1), provided by middle, and c2(1) which can't be
+	 * achieved. middle needs e1(1), provided by leaf. second needs d1(1),
+	 * d2(1) and d3(1), all provided by other.
+	 */
+	void add_alternatives(planner_ability& a)
+	{
+		logic_layer& logic = a.logic();
+		std::vector<std::string> int_type = boost::assign::list_of("int");
+		const char* preds[] = { "goal", "c1", "c2", "d1", "d2", "d3", "e1" };
+		for (size_t i = 0; i < sizeof(preds) / sizeof(preds[0]); ++i)
+			logic.engine.add_predicate(preds[i], 1, int_type);
+
+		std::vector<std::string> none;
+		std::vector<std::string> alternatives = boost::assign::list_of("first")("second");
+
+		boost::shared_ptr<world_task> root = add_task(a, "root", none);
+		root->add_precondition("goal(1)", alternatives);
+
+		boost::shared_ptr<world_task> first =
+			add_task(a, "first", boost::assign::list_of("goal(1)"));
+		first->add_precondition("c1(1)", boost::assign::list_of("middle"));
+		first->add_precondition("c2(1)", none);
+
+		// more preconditions, so it is evaluated after first
+		boost::shared_ptr<world_task> second =
+			add_task(a, "second", boost::assign::list_of("goal(1)"));
+		second->add_precondition("d1(1)", boost::assign::list_of("other"));
+		second->add_precondition("d2(1)", boost::assign::list_of("other"));
+		second->add_precondition("d3(1)", boost::assign::list_of("other"));
+
+		add_task(a, "other", boost::assign::list_of("d1(1)")("d2(1)")("d3(1)"));
+
+		boost::shared_ptr<world_task> middle =
+			add_task(a, "middle", boost::assign::list_of("c1(1)"));
+		middle->add_precondition("e1(1)", boost::assign::list_of("leaf"));
+
+		add_task(a, "leaf", boost::assign::list_of("e1(1)"));
+	}
+
+	/* 
+	 * The state of the world for enabled_a and enabled_b, and the number
+	 * of time it is evaluated
+	 */
+	bool enabled[2];
+	size_t nb_enabled_evals[2];
+
+	template <size_t i>
+	struct enabled_fun {
+		typedef bool result_type;
+		typedef boost::mpl::vector<int> args_type;
+		static bool apply(const int&)
+		{
+			nb_enabled_evals[i]++;
+			return enabled[i];
+		}
+	};
+
+	/* never reached, so that the planner is always called */
+	struct goal_fun {
+		typedef bool result_type;
+		typedef boost::mpl::vector<int> args_type;
+		static bool apply(const int&) { return false; }
+	};
+
+	/*
+	 * goal(1) is only reachable on hypothesis : via_a provides ready_a(1),
+	 * and needs enabled_a(1) to hold, via_b provides ready_b(1), and needs
+	 * enabled_b(1).
+	 */
+	void add_hypothetic_alternatives(planner_ability& a)
+	{
+		logic_layer& logic = a.logic();
+		std::vector<std::string> int_type = boost::assign::list_of("int");
+		logic.add_predicate<goal_fun>("goal", int_type);
+		logic.add_predicate<enabled_fun<0> >("enabled_a", int_type);
+		logic.add_predicate<enabled_fun<1> >("enabled_b", int_type);
+		logic.engine.add_predicate("ready_a", 1, int_type);
+		logic.engine.add_predicate("ready_b", 1, int_type);
+
+		std::vector<std::string> goal = boost::assign::list_of("goal(X)");
+		std::vector<std::string> via_a = boost::assign::list_of("ready_a(X)")("enabled_a(X)");
+		std::vector<std::string> via_b = boost::assign::list_of("ready_b(X)")("enabled_b(X)");
+		BOOST_CHECK(logic.engine.add_rule("via_a", via_a, goal));
+		BOOST_CHECK(logic.engine.add_rule("via_b", via_b, goal));
+
+		add_task(a, "via_a", boost::assign::list_of("ready_a(1)"));
+		add_task(a, "via_b", boost::assign::list_of("ready_b(1)"));
+	}
+}
+
+/*
+ * In streaming mode, leaf starts as soon as e1(1) is solved, but once
+ * first is rejected, middle must not be executed.
+ */
+BOOST_AUTO_TEST_CASE ( model_compute_task_tree_streaming_test )
+{
+	using namespace hyper::model;
+	using namespace hyper::network;
+
+	boost::asio::io_service io_nameserv_s;
+	name_server s("127.0.0.1", "4242", io_nameserv_s, false);
+	boost::thread thr( boost::bind(& boost::asio::io_service::run, &io_nameserv_s));
+
+	{
+	planner_ability a;
+	a.logic().streaming_planner = true;
+	add_alternatives(a);
+
+	run(a, "root");
+
+	BOOST_CHECK(a.res && *a.res == request_constraint_answer::SUCCESS);
+	BOOST_CHECK(has_executed(a, "second"));
+	BOOST_CHECK(has_executed(a, "root"));
+	BOOST_CHECK(!has_executed(a, "first"));
+	BOOST_CHECK(!has_executed(a, "middle"));
+	BOOST_CHECK(a.executed.back() == "root");
+	}
+
+	s.stop();
+	thr.join();
+}
+
+/*
+ * With worker threads, the inferences run out of io_s, but their
+ * handlers, and so the rest of the computation, must run in io_s, with
+ * the same result than the inline path
+ */
+BOOST_AUTO_TEST_CASE ( model_compute_task_tree_workers_test )
+{
+	using namespace hyper::model;
+	using namespace hyper::network;
+
+	boost::asio::io_service io_nameserv_s;
+	name_server s("127.0.0.1", "4242", io_nameserv_s, false);
+	boost::thread thr( boost::bind(& boost::asio::io_service::run, &io_nameserv_s));
+
+	std::vector<std::string> executed[2];
+	size_t nb_workers[2] = { 0, 2 };
+	for (size_t i = 0; i < 2; ++i) {
+		planner_ability a;
+		a.nb_workers = nb_workers[i];
+		a.logic().streaming_planner = false;
+		add_alternatives(a);
+
+		run(a, "root");
+
+		BOOST_CHECK(a.res && *a.res == request_constraint_answer::SUCCESS);
+		BOOST_CHECK(a.eval_threads.size() == 1);
+		BOOST_CHECK(a.eval_threads.count(a.io_thread) == 1);
+		executed[i] = a.executed;
+	}
+
+	BOOST_CHECK(executed[0] == executed[1]);
+	BOOST_CHECK(!executed[0].empty() && executed[0].back() == "root");
+
+	s.stop();
+	thr.join();
+}
+
+/*
+ * The plan cached for goal(1) is reused as long as the hypothesis on
+ * which its tasks have been chosen still hold, and dropped when it is
+ * not the case anymore, or when its execution fails
+ */
+BOOST_AUTO_TEST_CASE ( model_compute_task_tree_plan_cache_test )
+{
+	using namespace hyper::model;
+	using namespace hyper::network;
+
+	boost::asio::io_service io_nameserv_s;
+	name_server s("127.0.0.1", "4242", io_nameserv_s, false);
+	boost::thread thr( boost::bind(& boost::asio::io_service::run, &io_nameserv_s));
+
+	{
+	planner_ability a;
+	a.logic().use_plan_cache = true;
+	add_hypothetic_alternatives(a);
+
+	enabled[0] = true;
+	enabled[1] = false;
+	nb_enabled_evals[0] = nb_enabled_evals[1] = 0;
+
+	// no plan yet, all the hypothesis are evaluated
+	make(a, "goal(1)");
+	BOOST_CHECK(a.res && *a.res == request_constraint_answer::SUCCESS);
+	BOOST_CHECK(a.executed == std::vector<std::string>(1, "via_a"));
+	BOOST_CHECK(nb_enabled_evals[0] == 1 && nb_enabled_evals[1] == 1);
+	BOOST_CHECK(a.logic().plan_cache.size() == 1);
+
+	// hit : only the hypothesis of via_a is evaluated again
+	make(a, "goal(1)");
+	BOOST_CHECK(a.res && *a.res == request_constraint_answer::SUCCESS);
+	BOOST_CHECK(a.executed == std::vector<std::string>(1, "via_a"));
+	BOOST_CHECK(nb_enabled_evals[0] == 2 && nb_enabled_evals[1] == 1);
+
+	// miss : enabled_a(1) does not hold anymore, so the plan is computed again
+	enabled[0] = false;
+	enabled[1] = true;
+	make(a, "goal(1)");
+	BOOST_CHECK(a.res && *a.res == request_constraint_answer::SUCCESS);
+	BOOST_CHECK(a.executed == std::vector<std::string>(1, "via_b"));
+	BOOST_CHECK(nb_enabled_evals[0] == 4 && nb_enabled_evals[1] == 2);
+	BOOST_CHECK(a.logic().plan_cache.size() == 1);
+
+	// the cached plan is still valid, but its execution fails
+	a.broken.insert("via_b");
+	make(a, "goal(1)");
+	BOOST_CHECK(a.res && *a.res == request_constraint_answer::FAILURE);
+	BOOST_CHECK(a.executed.empty());
+	BOOST_CHECK(a.logic().plan_cache.empty());
+
+	// so the next request computes the whole plan
+	a.broken.clear();
+	size_t nb_evals = nb_enabled_evals[0];
+	make(a, "goal(1)");
+	BOOST_CHECK(a.res && *a.res == request_constraint_answer::SUCCESS);
+	BOOST_CHECK(a.executed == std::vector<std::string>(1, "via_b"));
+	BOOST_CHECK(nb_enabled_evals[0] == nb_evals + 1);
+	BOOST_CHECK(a.logic().plan_cache.size() == 1);
+	}
+
+	s.stop();
+	thr.join();
+}
@@ -1,4 +1,6 @@
+#include <model/ability.hh>
 #include <model/task.hh>
+#include <model/recipe.hh>
 #include <model/evaluate_conditions.hh>
 #include <boost/test/unit_test.hpp>
 
@@ -114,3 +116,164 @@ BOOST_AUTO_TEST_CASE ( model_task_test )
 	s.stop();
 	thr.join();
 }
+
+namespace {
+	struct recipe_ability : public hyper::model::ability
+	{
+		std::vector<std::string> executed;
+		boost::optional<bool> res;
+
+		recipe_ability() : hyper::model::ability("recipe_test") {}
+
+		void handle_execute(bool b)
+		{
+			res = b;
+			stop();
+		}
+	};
+
+	struct simple_task : public hyper::model::task
+	{
+		simple_task(recipe_ability& a) : hyper::model::task(a, "simple_task") {}
+
+		void async_evaluate_preconditions(hyper::model::condition_execution_callback cb)
+		{
+			cb(boost::system::error_code(), hyper::model::conditionV());
+		}
+
+		void async_evaluate_postconditions(hyper::model::condition_execution_callback cb)
+		{
+			cb(boost::system::error_code(), hyper::model::conditionV());
+		}
+
+		bool has_postconditions() const { return false; }
+	};
+
+	/* 
+	 * A recipe with nb_preconds preconditions, whose evaluation answers
+	 * after delay ms, with failed preconditions if ok is false
+	 */
+	struct delayed_recipe : public hyper::model::recipe
+	{
+		recipe_ability& a;
+		bool ok;
+		boost::asio::deadline_timer timer;
+		size_t delay;
+
+		delayed_recipe(const std::string& name, recipe_ability& a, simple_task& t,
+					   size_t nb_preconds, bool ok, size_t delay) :
+			recipe(name, a, t), a(a), ok(ok), timer(a.io_s), delay(delay)
+		{
+			nb_preconditions_ = nb_preconds;
+			has_end_handler = false;
+		}
+
+		void handle_timeout(hyper::model::condition_execution_callback cb)
+		{
+			hyper::model::conditionV failed;
+			if (!ok)
+				failed.push_back(hyper::logic::function_call("precondition"));
+			cb(boost::system::error_code(), failed);
+		}
+
+		virtual void async_evaluate_preconditions(hyper::model::condition_execution_callback cb)
+		{
+			timer.expires_from_now(boost::posix_time::milliseconds(delay));
+			timer.async_wait(boost::bind(&delayed_recipe::handle_timeout, this, cb));
+		}
+
+		virtual void do_execute(hyper::model::abortable_computation::cb_type cb, bool)
+		{
+			a.executed.push_back(r_name());
+			cb(boost::system::error_code());
+		}
+
+		virtual void do_end(hyper::model::abortable_computation::cb_type cb)
+		{
+			cb(boost::system::error_code());
+		}
+	};
+
+	struct recipe_def {
+		const char* name;
+		size_t nb_preconds;
+		bool ok;
+	};
+
+	/* 
+	 * Execute a task made of the recipes defs, and return the executed
+	 * recipe, if any. The last recipes answer first.
+	 */
+	boost::optional<std::string> 
+	execute_task(const std::vector<recipe_def>& defs, bool parallel)
+	{
+		recipe_ability a;
+		a.parallel_preconditions = parallel;
+
+		simple_task t(a);
+		for (size_t i = 0; i < defs.size(); ++i)
+			t.add_recipe(hyper::model::recipe_ptr(new delayed_recipe(defs[i].name, a, t, 
+								defs[i].nb_preconds, defs[i].ok, 5 * (defs.size() - i))));
+
+		hyper::model::logic_constraint ctr;
+		ctr.id = 0;
+		ctr.src = "test";
+		ctr.repeat = false;
+		ctr.internal = true;
+		ctr.s = hyper::network::request_constraint_answer::INIT;
+		a.io_s.post(boost::bind(&hyper::model::task::execute, &t, ctr,
+					hyper::model::task_execution_callback(
+						boost::bind(&recipe_ability::handle_execute, &a, _1))));
+
+		boost::thread thr(boost::bind(&recipe_ability::test_run, &a));
+		bool terminated = thr.timed_join(boost::posix_time::seconds(10));
+		BOOST_CHECK(terminated);
+		if (!terminated) {
+			a.io_s.stop();
+			thr.join();
+		}
+
+		BOOST_CHECK(a.res);
+		BOOST_CHECK(a.executed.size() <= 1);
+		if (!a.res || !*a.res || a.executed.empty())
+			return boost::none;
+		return a.executed[0];
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( model_task_parallel_preconditions_test )
+{
+	using namespace hyper::network;
+
+	boost::asio::io_service io_s;
+	name_server s("127.0.0.1", "4242", io_s, false);
+	boost::thread thr( boost::bind(& boost::asio::io_service::run, &io_s));
+
+	recipe_def d1[] = { { "fail_1", 1, false }, { "ok_2", 2, true }, 
+						{ "ok_1", 1, true }, { "fail_3", 3, false } };
+	recipe_def d2[] = { { "fail_1", 1, false }, { "fail_2", 2, false }, 
+						{ "ok_1", 1, true } };
+	recipe_def d3[] = { { "fail_1", 1, false }, { "fail_2", 2, false } };
+
+	std::vector<recipe_def> defs[3] = {
+		std::vector<recipe_def>(d1, d1 + 4),
+		std::vector<recipe_def>(d2, d2 + 3),
+		std::vector<recipe_def>(d3, d3 + 2)
+	};
+
+	const char* expected[3] = { "ok_2", "ok_1", 0 };
+
+	for (size_t i = 0; i < 3; ++i) {
+		boost::optional<std::string> sequential = execute_task(defs[i], false);
+		boost::optional<std::string> parallel = execute_task(defs[i], true);
+
+		BOOST_CHECK(sequential == parallel);
+		if (expected[i])
+			BOOST_CHECK(sequential && *sequential == expected[i]);
+		else
+			BOOST_CHECK(!sequential);
+	}
+
+	s.stop();
+	thr.join();
+}